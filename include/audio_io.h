@@ -3,6 +3,33 @@
 #ifndef AUDIO_IO_H
 #define AUDIO_IO_H
 
+#include <stdint.h>
+
+/**
+ * Load a whole file as mono float samples at SAMPLE_RATE, peak-normalized to
+ * [-1, 1]. Fails for files longer than INT_MAX output samples (about 13.5 h);
+ * read those with an AudioReader instead. Caller frees *out_buffer.
+ *
+ * @return 0 on success, -1 on failure
+ */
 int load_audio(const char* filepath, float** out_buffer, int* out_samples, int* out_samplerate);
 
+// Scale samples so the largest magnitude is 1 (no-op for silence).
+void audio_normalize(float* samples, int num_samples);
+
+/**
+ * Sequential reader producing the same mono SAMPLE_RATE samples as load_audio
+ * (before normalization) in chunks, with memory independent of file length.
+ */
+typedef struct AudioReader AudioReader;
+
+AudioReader* audio_reader_open(const char* filepath);
+void audio_reader_close(AudioReader* reader);
+
+// Output samples the whole file yields.
+int64_t audio_reader_total_samples(const AudioReader* reader);
+
+// Read up to max_samples. Returns the number read (0 at end of file), or -1.
+int audio_reader_read(AudioReader* reader, float* out, int max_samples);
+
 #endif
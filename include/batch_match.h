@@ -0,0 +1,41 @@
+// File: include/batch_match.h
+
+#ifndef BATCH_MATCH_H
+#define BATCH_MATCH_H
+
+#include "types.h"
+#include "db.h"
+#include "mmap_index.h"
+#include "matcher.h"
+
+/**
+ * Bulk identification for many clips at once (e.g. broadcast monitoring).
+ *
+ * The hashes of all queries are gathered and sorted once, then merge-joined
+ * against a hash-sorted catalog in one forward pass: the mapped hash array of
+ * an MmapIndex (galloping over gaps) or an ordered SQLite range scan. Each
+ * matching posting is routed back to the query that produced the hash and
+ * every query is scored like matcher_match_hashes().
+ *
+ * This pays off when the batch covers a sizeable share of the catalog's hash
+ * space; for a handful of clips, per-query lookups are cheaper. The SQLite
+ * path samples the catalog's density first and looks each distinct hash up
+ * instead when that reads fewer rows (see BATCH_SEEK_ROWS).
+ */
+typedef struct {
+    const FingerprintHash64* hashes;   // time_offset = query frame
+    int count;
+} BatchQuery;
+
+/**
+ * Results of query i go to out[i * k .. i * k + found[i]), ordered by score.
+ *
+ * @return 0 on success, -1 on error
+ */
+int batch_match_mmap(const MmapIndex* index, const BatchQuery* queries, int num_queries,
+                     MatchResult* out, int k, int* found);
+
+int batch_match_db(db_ctx* ctx, const BatchQuery* queries, int num_queries,
+                   MatchResult* out, int k, int* found);
+
+#endif // BATCH_MATCH_H
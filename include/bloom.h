@@ -0,0 +1,68 @@
+// File: include/bloom.h
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "db.h"
+
+/**
+ * Blocked Bloom filter over fingerprint hashes.
+ *
+ * Each key maps to one 512-bit block (a single cache line) and sets one bit in
+ * each of its eight 64-bit words, so a membership test costs one memory access.
+ * With BLOOM_BITS_PER_KEY = 10 the false-positive rate is about 1%. Absent
+ * hashes are answered without touching the index; present ones always pass.
+ */
+typedef struct BloomFilter BloomFilter;
+
+// Empty filter sized for `num_keys` distinct hashes.
+BloomFilter* bloom_create(uint64_t num_keys);
+
+// Read-only view over blocks owned elsewhere (e.g. a mapped index file).
+BloomFilter* bloom_wrap(const void* blocks, uint64_t num_blocks);
+
+void bloom_free(BloomFilter* filter);
+
+void bloom_add(BloomFilter* filter, uint64_t hash);
+
+// Returns 0 if `hash` is definitely absent, 1 if it may be present.
+int bloom_may_contain(const BloomFilter* filter, uint64_t hash);
+
+// Start loading the block for `hash` ahead of a bloom_may_contain() call.
+void bloom_prefetch(const BloomFilter* filter, uint64_t hash);
+
+// Catalog generation the filter was built at, -1 if unknown.
+int64_t bloom_generation(const BloomFilter* filter);
+
+uint64_t bloom_num_blocks(const BloomFilter* filter);
+const void* bloom_blocks(const BloomFilter* filter);
+size_t bloom_size_bytes(const BloomFilter* filter);
+
+// Number of blocks bloom_create() allocates for `num_keys`.
+uint64_t bloom_blocks_for_keys(uint64_t num_keys);
+
+int bloom_save(const BloomFilter* filter, const char* path);
+BloomFilter* bloom_load(const char* path);  // NULL if missing or invalid
+
+// Read only the generation stamped in a filter file. Returns 0, or -1 if the
+// file is missing or not a filter (nothing is printed).
+int bloom_file_generation(const char* path, int64_t* generation);
+
+/**
+ * Build a filter over every hash in the Fingerprints table. The filter only
+ * answers for the rows present now: rebuild it after ingesting more songs.
+ * It is stamped with the catalog generation (db_get_generation) it covers.
+ * Reads the table once; while scanning it holds a filter sized for the whole
+ * catalog file (about a tenth of its size) and ends under twice the minimum.
+ */
+BloomFilter* bloom_build_from_db(db_ctx* ctx);
+
+/**
+ * bloom_load(), but also NULL if the catalog behind `ctx` has changed since
+ * the filter was built: a stale filter would hide the new rows from queries.
+ */
+BloomFilter* bloom_load_current(const char* path, db_ctx* ctx);
+
+#endif // BLOOM_H
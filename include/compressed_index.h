@@ -0,0 +1,38 @@
+// File: include/compressed_index.h
+
+#ifndef COMPRESSED_INDEX_H
+#define COMPRESSED_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "db.h"
+
+/**
+ * RAM-resident fingerprint index with compressed posting lists (see posting_codec.h).
+ * Unique hashes are delta-coded in blocks of 32 behind a 16-bit prefix
+ * directory, each with the varint size of its encoded list in a single byte
+ * blob. compressed_index_memory_usage() counts every resident structure.
+ */
+typedef struct CompressedIndex CompressedIndex;
+
+CompressedIndex* compressed_index_load_from_db(db_ctx* ctx);
+void compressed_index_free(CompressedIndex* index);
+
+/**
+ * Decode the postings of `hash` into `out`, which must hold at least
+ * compressed_index_max_list_len() entries.
+ *
+ * @return  Number of postings, 0 if the hash is absent
+ */
+size_t compressed_index_lookup(const CompressedIndex* index, uint64_t hash, Posting* out);
+
+// Number of postings stored for `hash` without decoding them.
+size_t compressed_index_count(const CompressedIndex* index, uint64_t hash);
+
+size_t compressed_index_max_list_len(const CompressedIndex* index);
+uint64_t compressed_index_num_hashes(const CompressedIndex* index);
+uint64_t compressed_index_num_postings(const CompressedIndex* index);
+size_t compressed_index_memory_usage(const CompressedIndex* index);
+
+#endif // COMPRESSED_INDEX_H
@@ -21,6 +21,26 @@
 #define SONGS_FOLDER         "songs/"
 #define DB_PATH              "data/audio_fingerprint.db" // Audio fingerprints
 
+#define DB_BUSY_TIMEOUT_MS   5000        // Wait this long on a locked DB before failing
+#define DB_READ_MMAP_SIZE    (1LL << 30) // mmap window for read-only query connections
+#define DB_READ_POOL_SIZE    4           // Read-only connections for lookup threads
+
+#define DB_BULK_PAGE_SIZE    65536       // Page size for freshly bulk-loaded catalogs
+#define DB_BULK_CACHE_KB     1048576     // 1 GiB page cache during bulk load
+#define DB_BULK_MMAP_SIZE    (1LL << 34) // Map up to 16 GiB of the DB file during bulk load
+
+#define DB_WRITER_QUEUE_DEPTH 8          // Pending song batches before producers block
+#define DB_WRITER_TXN_ROWS    500000     // Fingerprints per writer transaction
+#define DB_WRITER_TXN_MS      2000       // Commit a smaller transaction once it is this old
+
+#define LSM_MEMTABLE_RECORDS 2000000     // Buffered records before a segment flush
+#define LSM_TIER_FANOUT      4           // Merge this many segments of one size tier
+
+#define BLOOM_BITS_PER_KEY   10          // Filter bits per distinct hash (~1% false positives)
+#define BLOOM_FILE_SUFFIX    ".bloom"    // Filter file stored next to the DB
+
+#define PEAK_BLOCK_FRAMES    256         // Stored song peaks per SongPeaks row (~6 s)
+
 // ===========================
 // Hashing Configuration
 // ===========================
@@ -28,7 +48,89 @@
 #define FAN_VALUE            5           // Number of nearby points used for each hash
 #define MAX_FREQ_BIN     1023     // 10 bits
 #define MAX_TIME_DELTA   4095     // 12 bits
-#define MAX_TIME         1048575  // 20 bits
 #define MAX_DELTA_FREQ   31       // for signed 6-bit range [-32, +31]
+#define HASH_LAYOUT_VERSION 2     // Bump when hash bits change; catalogs must be re-ingested
+
+// ===========================
+// Matching Configuration
+// ===========================
+
+#define MATCH_TOP_K               5        // Candidates reported per query
+#define MATCH_MIN_SCORE           5        // Aligned votes needed to report a song
+#define MATCH_MAX_LIST_LEN        20000    // Skip hashes with longer posting lists (too common to help)
+#define MATCH_EARLY_MARGIN        2        // Extra lead (votes) required before progressive matching stops
+#define MATCH_PARALLEL_MIN_HASHES 256      // Shorter queries are scored serially even with a thread pool
+#define MATCH_BUDGET_POSTINGS     50000    // Bounded mode default: postings voted per query at most
+#define MATCH_BUDGET_HASHES       512      // Bounded mode default: query hashes looked at, at most
+#define BATCH_DENSITY_SAMPLE      256      // Catalog rows read to estimate a batch scan's length
+#define BATCH_SEEK_ROWS           40       // One point lookup costs about this many scanned rows
+
+// Second stage: re-check the leading candidates against the songs' stored peaks
+#define VERIFY_CANDIDATES         10       // Stage-1 candidates passed to verification
+#define VERIFY_FAN_VALUE          3        // Query fan-out while verifying (cheaper stage 1)
+#define VERIFY_TIME_TOLERANCE     1        // Frames a confirming song peak may be off by
+#define VERIFY_FREQ_TOLERANCE     1        // Bins a confirming song peak may be off by
+#define VERIFY_MIN_PEAKS          10       // Confirmed query peaks needed to accept a candidate
+#define VERIFY_MIN_RATIO          0.15f    // ...and this fraction of the query peaks in the window
+
+// ===========================
+// Stream Recognition
+// ===========================
+
+#define STREAM_HALF_LIFE_SEC      4.0f     // Votes lose half their weight after this long
+#define STREAM_MATCH_SCORE        8.0f     // Decayed aligned votes needed to report a song
+#define STREAM_LOST_SCORE         3.0f     // Reported song ends when its votes decay below this
+#define STREAM_VOTE_SLOTS         16384    // Fixed vote table size per stream (power of two)
+#define STREAM_VOTE_PROBES        8        // Slots searched per vote; the weakest is evicted when full
+
+// ===========================
+// Long-Recording Segmentation
+// ===========================
+
+#define SEGMENT_WINDOW_SEC        10       // Length of each matched window
+#define SEGMENT_HOP_SEC           5        // Window start spacing (overlap = window - hop)
+#define SEGMENT_ALIGN_SEC         1.0f     // Max alignment drift for windows to join one entry
+
+// ===========================
+// Duplicate Detection
+// ===========================
+
+#define DEDUP_MAX_LIST_LEN        64       // Longer posting lists cast no pair votes (too common)
+#define DEDUP_MIN_SCORE           50       // Aligned shared hashes needed to report a pair
+#define DEDUP_MIN_SIMILARITY      0.1f     // ...and this fraction of the shorter song's hashes
+#define DEDUP_PARTITIONS          64       // Spill files, counted one per thread
+#define DEDUP_SORT_RECORDS        4194304  // Votes sorted in memory per thread (48 MiB); larger partitions are merged from sorted runs
+#define DEDUP_MERGE_RECORDS       4096     // Votes read ahead per sorted run while merging
+#define DEDUP_SPILL_RECORDS       1024     // Votes buffered per partition before a write
+#define DEDUP_SCAN_RANGES         256      // Hash ranges scanned as separate tasks
+
+// ===========================
+// Match Server
+// ===========================
+
+#define SERVER_SOCKET_PATH        "data/match.sock"  // Default Unix socket
+#define SERVER_MAX_K              64       // Largest top-K a request may ask for
+#define SERVER_MAX_PENDING        32       // Queued requests per connection before its reader blocks
+#define SERVER_MAX_PAYLOAD_BYTES  (64 << 20) // Larger requests close the connection
+#define SERVER_LISTEN_BACKLOG     64
+#define SERVER_BATCH_MAX_REQUESTS 256      // Requests per micro-batch
+
+// ===========================
+// Query Result Cache
+// ===========================
+
+#define MINHASH_BINS              32       // One-permutation MinHash bins per sketch (power of two)
+#define MINHASH_BAND_ROWS         4        // Bins per LSH band
+#define RESULT_CACHE_ENTRIES      4096     // Suggested capacity
+#define RESULT_CACHE_MIN_SIMILARITY 0.8f   // Estimated Jaccard needed to reuse a cached answer
+#define RESULT_CACHE_MIN_HASHES   64       // Shorter queries are never cached
+
+// ===========================
+// Ingest Near-Duplicate Check
+// ===========================
+
+#define SONG_SKETCH_BINS          128      // MinHash bins per song sketch (power of two)
+#define SONG_SKETCH_BAND_ROWS     2        // Bins per LSH band
+#define SONG_SKETCH_MIN_SIMILARITY 0.15f   // Estimated Jaccard that marks a near-duplicate
 
 #endif // CONFIG_H
@@ -31,12 +31,135 @@ int db_insert_fingerprint(sqlite3* db, const char* hash, int time_offset, int so
 #ifndef DB_H
 #define DB_H
 
-int db_open(const char* path);        // Open or create DB and ensure tables exist
-void db_close();                      // Close DB
+#include <stdint.h>
+#include "types.h"
+#include "minhash.h"
 
-int db_create_tables();               // Create tables if not exist
-int db_find_song(const char* name, const char* artist, int* song_id);
-int db_insert_song(const char* name, const char* artist, int* song_id);
-int db_insert_fingerprint(const char* hash, int time_offset, int song_id);
+// A db_ctx is one connection plus its prepared statement cache. Contexts are
+// independent, but each must be used by only one thread at a time.
+typedef struct db_ctx db_ctx;
+
+// Pool of read-only contexts shared by query threads
+typedef struct db_pool db_pool;
+
+#define DB_CTX_READONLY  0x1   // Open read-only; tables must already exist
+
+db_ctx* db_open_ctx(const char* path, int flags);  // Open or create DB and ensure tables exist
+void db_close_ctx(db_ctx* ctx);                     // Close DB and its cached statements
+
+int db_create_tables(db_ctx* ctx);                  // Create tables if not exist
+int db_find_song(db_ctx* ctx, const char* name, const char* artist, int* song_id);
+
+// Copy the name and artist of `song_id`. Returns 1 if found, 0 if not, -1 on error.
+int db_get_song(db_ctx* ctx, int song_id, char* name, size_t name_size, char* artist, size_t artist_size);
+int db_insert_song(db_ctx* ctx, const char* name, const char* artist, int* song_id);
+
+// Register a song under an id chosen by the caller (see db_max_song_id). Returns 0 or -1;
+// unlike db_insert_song, an existing name/artist is an error.
+int db_insert_song_with_id(db_ctx* ctx, int song_id, const char* name, const char* artist);
+int db_max_song_id(db_ctx* ctx, int* song_id);     // 0 for an empty catalog. Returns 0 or -1.
+int db_insert_fingerprint(db_ctx* ctx, uint64_t hash, int time_offset, int song_id);
+
+/**
+ * Store a song's spectrogram peaks (sorted in place by time) in blocks of
+ * PEAK_BLOCK_FRAMES frames. Magnitudes are not kept. Returns 0 or -1.
+ */
+int db_insert_song_peaks(db_ctx* ctx, int song_id, Peak* peaks, int count);
+
+/**
+ * Load the stored peaks of `song_id` with time_index in [first_frame, last_frame],
+ * in time order; only the blocks covering the window are read. Caller frees *out.
+ *
+ * @return 1 if the song has stored peaks (*count may still be 0 for a window
+ *         past its end), 0 if none were stored for it, -1 on error
+ */
+int db_load_song_peaks(db_ctx* ctx, int song_id, int first_frame, int last_frame, Peak** out, int* count);
+
+// Store the song's SongSketch in Songs.sketch. Returns 0 or -1.
+int db_set_song_sketch(db_ctx* ctx, int song_id, const SongSketch* sketch);
+
+// Visit every stored song sketch in song_id order. The callback returns non-zero
+// to stop early. Returns 0 when complete, 1 if stopped by the callback, -1 on error.
+typedef int (*db_sketch_cb)(int song_id, const SongSketch* sketch, void* user);
+int db_scan_song_sketches(db_ctx* ctx, db_sketch_cb cb, void* user);
+
+// Catalog metadata. db_get_meta returns 1 if found, 0 if absent, -1 on error.
+int db_get_meta(db_ctx* ctx, const char* key, int64_t* value);
+int db_set_meta(db_ctx* ctx, const char* key, int64_t value);
+
+/**
+ * Catalog generation (Meta 'index_generation'), bumped in the same transaction
+ * as every fingerprint insert that adds rows and by db_finalize_bulk_load.
+ * Caches and filters derived from the catalog compare it to detect staleness.
+ * A catalog that never stored a fingerprint is at generation 0.
+ */
+int db_get_generation(db_ctx* ctx, int64_t* generation);   // Returns 0 or -1
+int db_bump_generation(db_ctx* ctx);
+
+// Fetch the postings stored under `hash`. Fills at most max_out entries and
+// returns the total number found (may exceed max_out), or -1 on error.
+int db_lookup_hash(db_ctx* ctx, uint64_t hash, Posting* out, int max_out);
+
+// Count the postings under `hash`, reading at most cap + 1 of them: returns the
+// count, cap + 1 if there are more than `cap`, or -1 on error.
+int db_count_hash(db_ctx* ctx, uint64_t hash, int cap);
+
+// Consult `filter` (see bloom.h) before each db_lookup_hash() and skip the query
+// for hashes it rules out. The filter is not owned and must cover every row;
+// pass NULL to detach.
+struct BloomFilter;
+void db_set_filter(db_ctx* ctx, const struct BloomFilter* filter);
+
+// Size of the catalog's pages in bytes (all tables), an upper bound on what
+// the Fingerprints rows occupy. Costs no table reads. Returns 0 or -1.
+int db_size_bytes(db_ctx* ctx, int64_t* bytes);
+
+// Visit every fingerprint ordered by (hash as uint64_t, song_id, time_offset).
+// The callback returns non-zero to stop early. Returns 0 when complete, 1 if
+// stopped by the callback, -1 on error.
+typedef int (*db_fingerprint_cb)(uint64_t hash, int song_id, int time_offset, void* user);
+int db_scan_fingerprints(db_ctx* ctx, db_fingerprint_cb cb, void* user);
+
+// Same, restricted to hashes in [lo, hi] (inclusive, compared as uint64_t).
+int db_scan_fingerprint_range(db_ctx* ctx, uint64_t lo, uint64_t hi, db_fingerprint_cb cb, void* user);
+
+// Explicit transactions for grouping several songs into one commit
+int db_begin_transaction(db_ctx* ctx);
+int db_commit_transaction(db_ctx* ctx);
+void db_rollback_transaction(db_ctx* ctx);
+
+// Named savepoints, to undo part of a transaction. Rolling back also releases it.
+int db_savepoint(db_ctx* ctx, const char* name);
+int db_release_savepoint(db_ctx* ctx, const char* name);
+void db_rollback_to_savepoint(db_ctx* ctx, const char* name);
+
+// Insert a batch in one transaction (a savepoint when already inside one).
+// Sorts `hashes` in place by (hash, song_id, time_offset).
+// Sets *inserted to the number of rows written (duplicates are ignored). Returns 0 or -1.
+int db_insert_fingerprints(db_ctx* ctx, FingerprintHash64* hashes, int count, int* inserted);
+
+// Bulk-load mode for building a catalog from scratch: fast, non-durable pragmas and an
+// unindexed staging table. Nothing is visible in Fingerprints until the finalize step,
+// which builds the clustered table in one sorted pass and restores durable settings.
+int db_begin_bulk_load(db_ctx* ctx);
+int db_finalize_bulk_load(db_ctx* ctx);
+
+// Read-only connection pool. Acquire blocks until a context is free.
+db_pool* db_pool_open(const char* path, int size);
+db_ctx* db_pool_acquire(db_pool* pool);
+void db_pool_release(db_pool* pool, db_ctx* ctx);
+void db_pool_close(db_pool* pool);
+void db_pool_set_filter(db_pool* pool, const struct BloomFilter* filter);  // Attach to every context
+
+/**
+ * Attach the filter file at `path` (see bloom.h), owned by the pool. A filter
+ * only covers the catalog generation it was built at, so db_pool_sync_filter()
+ * must be called with the current generation before each query or batch: it
+ * detaches a stale filter and reloads the file once it has been rebuilt.
+ *
+ * @return  0 if a current filter is attached, -1 if none is (yet)
+ */
+int db_pool_load_filter(db_pool* pool, const char* path);
+void db_pool_sync_filter(db_pool* pool, int64_t generation);
 
 #endif
@@ -0,0 +1,54 @@
+// File: include/db_writer.h
+
+#ifndef DB_WRITER_H
+#define DB_WRITER_H
+
+#include "types.h"
+#include "db.h"
+#include "shard_set.h"
+#include "lsm_index.h"
+
+/**
+ * Background database writer. After db_writer_start() the writer thread owns the
+ * given context: producers must not use it until db_writer_stop() returns. They
+ * may read through contexts of their own.
+ *
+ * Producers hand over one batch per song through a bounded queue; the writer
+ * registers the song, stamps its id on the records, stores the song's SongSketch
+ * and groups batches into large transactions. db_writer_submit() blocks while the queue is full (back-pressure).
+ */
+typedef struct DbWriter DbWriter;
+
+/**
+ * @param db            Writable context handed over to the writer thread
+ * @param shards        Optional shard set that receives the fingerprints (Songs stay
+ *                      in `db`); also owned by the writer until stop. May be NULL.
+ * @param lsm           Optional segmented index that receives the fingerprints instead;
+ *                      records become durable when it flushes. May be NULL.
+ * @param queue_depth   Maximum number of pending batches before producers block
+ * @param txn_rows      Commit once a transaction holds at least this many records;
+ *                      smaller ones commit after DB_WRITER_TXN_MS and on stop
+ * @return DbWriter*    Running writer, or NULL on failure
+ */
+DbWriter* db_writer_start(db_ctx* db, ShardSet* shards, LsmIndex* lsm,
+                          int queue_depth, int txn_rows);
+
+/**
+ * Queue a song's fingerprints and, if `peaks` is not NULL, its spectrogram
+ * peaks for verification (stored in the main DB). Ownership of `hashes` and
+ * `peaks` passes to the writer, which frees them (also on failure). Safe to
+ * call from several producer threads.
+ *
+ * @return 0 if queued, -1 if the writer is shutting down or out of memory
+ */
+int db_writer_submit(DbWriter* writer, const char* name, const char* artist,
+                     FingerprintHash64* hashes, int count, Peak* peaks, int num_peaks);
+
+/**
+ * Drain the queue, commit, join the thread and free the writer.
+ *
+ * @return 0 if every batch was written, -1 if any batch failed
+ */
+int db_writer_stop(DbWriter* writer);
+
+#endif // DB_WRITER_H
@@ -0,0 +1,54 @@
+// File: include/dedup.h
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "db.h"
+#include "mmap_index.h"
+#include "thread_pool.h"
+
+/**
+ * Catalog-wide duplicate detection (re-uploads, alternate masters, edits).
+ *
+ * Instead of comparing songs pairwise, the index is read once in hash order.
+ * Every posting list of 2..DEDUP_MAX_LIST_LEN entries casts one vote per
+ * pair of songs in it, keyed by (song_a, song_b, time_b - time_a); two
+ * recordings of the same audio pile their votes onto one time difference,
+ * exactly like a query does against the catalog.
+ *
+ * Votes are spilled to DEDUP_PARTITIONS files partitioned by song pair. A
+ * partition is counted in memory when it fits DEDUP_SORT_RECORDS, and by an
+ * external merge sort otherwise, so memory per thread stays bounded however
+ * large the catalog. The hash ranges are scanned and the partitions counted
+ * on `workers`.
+ */
+typedef struct {
+    int song_a, song_b;     // song_a < song_b
+    int score;              // Shared hashes at the best alignment (± 1 frame)
+    int offset;             // Frame of song_b aligned with frame 0 of song_a
+    float similarity;       // score / hashes of the shorter song
+} DuplicatePair;
+
+typedef struct {
+    long long postings;         // Postings read
+    long long lists_skipped;    // Lists longer than DEDUP_MAX_LIST_LEN
+    long long votes;            // Pair votes spilled
+    long long spill_bytes;
+} DedupStats;
+
+/**
+ * Find song pairs with at least `min_score` shared time-aligned hashes and
+ * `min_similarity`. *out is ordered by descending score; caller frees it.
+ * Spill files go to `spill_dir` and are removed before returning.
+ *
+ * @param pool     One read-only context per scanning thread
+ * @param stats    May be NULL
+ * @return         0 on success, -1 on error
+ */
+int dedup_find_db(db_pool* pool, ThreadPool* workers, const char* spill_dir, int min_score,
+                  float min_similarity, DuplicatePair** out, int* count, DedupStats* stats);
+
+int dedup_find_mmap(const MmapIndex* index, ThreadPool* workers, const char* spill_dir, int min_score,
+                    float min_similarity, DuplicatePair** out, int* count, DedupStats* stats);
+
+#endif // DEDUP_H
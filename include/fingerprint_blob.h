@@ -0,0 +1,64 @@
+// File: include/fingerprint_blob.h
+
+#ifndef FINGERPRINT_BLOB_H
+#define FINGERPRINT_BLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/**
+ * Compact binary form of a query's fingerprint, so a client can do the DSP
+ * itself and ship only hashes to the matcher.
+ *
+ * Hashes are sorted by (hash, time_offset) and delta-encoded: the hash as a
+ * gap from the previous entry (without the layout's always-zero low bits),
+ * the time offset as a gap when the hash is unchanged and verbatim otherwise.
+ * All integers are varints.
+ *
+ *   u32 magic "AFPB" (little-endian), u8 schema (HASH_LAYOUT_VERSION)
+ *   varint sample_rate, varint hop_size, varint count
+ *   count x (varint hash gap, varint time value)
+ *
+ * A few seconds of audio cost about 5-6 bytes per hash instead of 12 in the
+ * raw MATCH_REQ_HASHES form, and a tiny fraction of the PCM they came from;
+ * longer clips pack tighter as the hash gaps shrink.
+ */
+
+#define FINGERPRINT_BLOB_MAGIC 0x42504641u   // "AFPB"
+
+// Upper bound on the encoded size of n hashes.
+size_t fingerprint_blob_max_size(size_t n);
+
+/**
+ * Encode query hashes (time_offset = query frame, non-negative). The input is
+ * not modified; song_id is not stored.
+ *
+ * @param out        Receives a malloc'd blob; caller frees
+ * @param out_bytes  Receives its size
+ * @return           0 on success, -1 on error
+ */
+int fingerprint_blob_encode(const FingerprintHash64* hashes, int count,
+                            uint8_t** out, size_t* out_bytes);
+
+/**
+ * Decode and validate a blob. Fails (without printing) if it is truncated,
+ * has trailing bytes, or was made with a different hash layout, sample rate
+ * or hop size than this build. *out is NULL when the blob holds no hashes.
+ *
+ * @return  0 on success, -1 if the blob is malformed or incompatible,
+ *          -2 on allocation failure
+ */
+int fingerprint_blob_decode(const uint8_t* blob, size_t bytes,
+                            FingerprintHash64** out, int* count);
+
+/**
+ * Client-side entry point: fingerprint a mono clip at SAMPLE_RATE (normalized
+ * as load_audio does) and encode it.
+ *
+ * @return  0 on success, -1 on error
+ */
+int fingerprint_blob_from_samples(const float* samples, int num_samples, int sample_rate,
+                                  uint8_t** out, size_t* out_bytes);
+
+#endif // FINGERPRINT_BLOB_H
@@ -0,0 +1,65 @@
+// File: include/fingerprint_index.h
+
+#ifndef FINGERPRINT_INDEX_H
+#define FINGERPRINT_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "db.h"
+#include "mmap_index.h"
+#include "hash_index.h"
+#include "compressed_index.h"
+#include "shard_set.h"
+#include "lsm_index.h"
+
+/**
+ * Uniform read interface over the catalog backends, so the matcher works the
+ * same against SQLite, mapped files, in-memory tables, shards or LSM segments.
+ * The wrapped backend is borrowed and must outlive the FingerprintIndex.
+ */
+typedef struct {
+    void* impl;
+
+    /**
+     * Return the total number of postings for `hash` and point *out at them.
+     * Backends that copy or decode write into `scratch`; if the list is longer
+     * than scratch_cap they leave *out NULL. Borrowing backends ignore scratch.
+     */
+    size_t (*lookup)(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out);
+
+    /**
+     * Posting count only (no postings touched where the backend allows it).
+     * Backends that have to walk the list stop after cap + 1 postings, so any
+     * value above `cap` just means "longer than cap".
+     */
+    size_t (*count)(void* impl, uint64_t hash, size_t cap);
+
+    /**
+     * Optional (may be NULL): answer a whole query at once. out[i] answers
+     * hashes[i] and stays valid until the next call. Returns 0 or -1.
+     */
+    int (*lookup_batch)(void* impl, const uint64_t* hashes, size_t n, PostingList* out);
+
+    // Nonzero when lookup and count may be called from several threads at once.
+    int concurrent;
+
+    /**
+     * Optional (may be NULL for backends that cannot change under the reader):
+     * a value that changes whenever postings are added, see db_get_generation.
+     * Matchers read it once per query or batch; the pool backend also drops or
+     * reloads its Bloom filter there when the catalog has moved on.
+     * Returns 0 or -1.
+     */
+    int (*generation)(void* impl, int64_t* out);
+} FingerprintIndex;
+
+FingerprintIndex fingerprint_index_from_db(db_ctx* ctx);
+FingerprintIndex fingerprint_index_from_pool(db_pool* pool);  // Concurrent: one context per call
+FingerprintIndex fingerprint_index_from_mmap(MmapIndex* index);
+FingerprintIndex fingerprint_index_from_hash(HashIndex* index);
+FingerprintIndex fingerprint_index_from_compressed(CompressedIndex* index);
+FingerprintIndex fingerprint_index_from_shards(ShardSet* set);
+FingerprintIndex fingerprint_index_from_lsm(LsmSnapshot* snapshot);
+
+#endif // FINGERPRINT_INDEX_H
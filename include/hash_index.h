@@ -0,0 +1,37 @@
+// File: include/hash_index.h
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "db.h"
+
+/**
+ * In-memory fingerprint index for query serving.
+ *
+ * Open addressing over 64-byte buckets of four slots, keyed by the 64-bit hash,
+ * so a lookup usually touches a single cache line. All postings live in one
+ * contiguous arena grouped by hash and sorted by (song_id, time_offset).
+ */
+typedef struct HashIndex HashIndex;
+
+// Load every fingerprint from the database. Returns NULL on failure.
+HashIndex* hash_index_load_from_db(db_ctx* ctx);
+void hash_index_free(HashIndex* index);
+
+/**
+ * @param out   Receives a pointer into the arena; NULL when the hash is absent
+ * @return      Number of postings for `hash`
+ */
+size_t hash_index_lookup(const HashIndex* index, uint64_t hash, const Posting** out);
+
+// Look up a whole query at once (out[i] answers hashes[i]); overlaps the cache misses.
+void hash_index_lookup_batch(const HashIndex* index, const uint64_t* hashes, size_t n, PostingList* out);
+
+uint64_t hash_index_num_hashes(const HashIndex* index);
+uint64_t hash_index_num_postings(const HashIndex* index);
+size_t hash_index_memory_usage(const HashIndex* index);  // Bytes held by table + arena
+
+#endif // HASH_INDEX_H
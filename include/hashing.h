@@ -1,9 +1,36 @@
 #ifndef HASHING_H
 #define HASHING_H
 
+#include <stdint.h>
 #include "types.h"
 
+// Scramble a fingerprint hash (MurmurHash3 finalizer). Fingerprint bits are
+// highly structured, so tables and filters keyed on them must mix first.
+static inline uint64_t mix_hash64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Hash one anchor/target landmark pair. Returns 1 and sets *out when the pair
+ * is hashable (target after the anchor within MAX_TIME_DELTA frames, both bins
+ * within MAX_FREQ_BIN, frequency step within the signed 6-bit range), else 0.
+ * generate_fingerprint_hashes applies this to each peak and its FAN_VALUE
+ * successors; streaming callers apply it as peaks arrive.
+ */
+int hash_peak_pair(const Peak* anchor, const Peak* target, uint64_t* out);
+
 //FingerprintHash* generate_fingerprints(const Peak* peaks, int num_peaks, int song_id, int* num_hashes_out);
 FingerprintHash64* generate_fingerprint_hashes(const Peak* peaks, int num_peaks, int song_id, int* out_count);
+
+// Same with each peak paired to its next `fan_value` peaks instead of FAN_VALUE.
+// A smaller fan-out yields a subset of the catalog's hashes: cheaper queries
+// that still match, at some cost in votes.
+FingerprintHash64* generate_fingerprint_hashes_fan(const Peak* peaks, int num_peaks, int song_id,
+                                                  int fan_value, int* out_count);
 #endif // HASHING_H
  
\ No newline at end of file
@@ -0,0 +1,55 @@
+// File: include/lsm_index.h
+
+#ifndef LSM_INDEX_H
+#define LSM_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/**
+ * Append-friendly fingerprint index made of immutable sorted segments.
+ *
+ * New records collect in an in-memory buffer that is sorted and written as a
+ * segment (mmap_index format) when it fills or on lsm_index_flush(). A background
+ * thread merges segments of the same size tier, so ingest cost stays flat as the
+ * catalog grows. The segment list lives in <dir>/MANIFEST, replaced atomically.
+ *
+ * Readers pin a snapshot of the segment list and then look up without any lock;
+ * segments replaced by compaction are deleted once the last snapshot is released.
+ * Records are visible to readers after the flush that writes them.
+ *
+ * lsm_index_add/flush must be called from one thread; snapshots may be used
+ * from any number of threads.
+ */
+typedef struct LsmIndex LsmIndex;
+typedef struct LsmSnapshot LsmSnapshot;
+
+#define LSM_OPEN_READONLY  0x1   // Query only: no compaction, no manifest writes
+
+// Open or create an index in directory `dir` (must exist) and start compaction.
+// Only one writable opener per directory; read-only openers may coexist with it.
+LsmIndex* lsm_index_open(const char* dir, int flags);
+
+// Flush buffered records, stop the compaction thread and free the index.
+int lsm_index_close(LsmIndex* index);
+
+// Buffer records; flushes a segment when LSM_MEMTABLE_RECORDS is reached.
+int lsm_index_add(LsmIndex* index, const FingerprintHash64* hashes, int count);
+
+// Write buffered records as a new segment now. Returns 0 on success.
+int lsm_index_flush(LsmIndex* index);
+
+LsmSnapshot* lsm_index_acquire(LsmIndex* index);
+void lsm_index_release(LsmIndex* index, LsmSnapshot* snapshot);
+
+/**
+ * Collect the postings of `hash` from every segment in the snapshot.
+ * Fills at most max_out entries and returns the total found (may exceed max_out).
+ */
+size_t lsm_snapshot_lookup(const LsmSnapshot* snapshot, uint64_t hash, Posting* out, size_t max_out);
+
+int lsm_snapshot_num_segments(const LsmSnapshot* snapshot);
+uint64_t lsm_snapshot_num_postings(const LsmSnapshot* snapshot);
+
+#endif // LSM_INDEX_H
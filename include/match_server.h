@@ -0,0 +1,107 @@
+// File: include/match_server.h
+
+#ifndef MATCH_SERVER_H
+#define MATCH_SERVER_H
+
+#include <stdint.h>
+#include "fingerprint_index.h"
+#include "matcher.h"
+
+/**
+ * Long-lived match daemon. The index is opened once by the caller and served
+ * over a Unix domain socket and/or localhost TCP.
+ *
+ * Wire protocol: every message is a fixed header followed by a payload; all
+ * integers and floats are little-endian.
+ *
+ *   Request  (16 bytes)  u32 magic, u32 request_id, u16 type, u16 k, u32 payload_bytes
+ *   Response (20 bytes)  u32 magic, u32 request_id, u16 status, u16 count,
+ *                        u32 queue_us, u32 match_us
+ *            then count  x (i32 song_id, i32 score, f32 offset_seconds)
+ *
+ * A client may pipeline any number of requests on one connection. Each
+ * connection has a reader thread that hands requests to the shared worker
+ * pool, so responses can arrive out of order; match them by request_id.
+ * queue_us is the time a request waited for a worker, match_us the time
+ * spent matching it.
+ */
+#define MATCH_PROTO_MAGIC        0x51504641u    // "AFPQ"
+#define MATCH_PROTO_REQUEST_SIZE 16
+#define MATCH_PROTO_RESPONSE_SIZE 20
+#define MATCH_PROTO_RESULT_SIZE  12
+#define MATCH_PROTO_HASH_SIZE    12             // u64 hash, i32 time_offset (query frame)
+
+typedef enum {
+    MATCH_REQ_PING   = 0,   // Empty payload; answered with zero results
+    MATCH_REQ_PCM    = 1,   // f32 mono samples at SAMPLE_RATE
+    MATCH_REQ_HASHES = 2,   // Precomputed query hashes, MATCH_PROTO_HASH_SIZE bytes each
+    MATCH_REQ_BLOB   = 3,   // Client-computed fingerprint (see fingerprint_blob.h)
+} MatchRequestType;
+
+typedef enum {
+    MATCH_STATUS_OK          = 0,
+    MATCH_STATUS_BAD_REQUEST = 1,   // Unknown type, bad k, malformed payload or blob
+                                    // from an incompatible hash layout
+    MATCH_STATUS_ERROR       = 2,   // Matching failed on the server
+} MatchStatus;
+
+typedef struct MatchServer MatchServer;
+
+typedef struct {
+    long long requests;         // Requests answered
+    long long errors;           // Answered with a non-OK status
+    long long connections;      // Accepted so far
+    double mean_ms;             // Queue + match time per request
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+    long long batches;          // Micro-batches run
+    long long hashes_requested; // Query hashes in those batches
+    long long hashes_looked_up; // Distinct hashes actually looked up
+} MatchServerStats;
+
+/**
+ * @param index         Catalog to serve (borrowed); must be concurrent
+ * @param num_workers   Matching threads, each with its own Matcher
+ */
+MatchServer* match_server_create(FingerprintIndex index, int num_workers);
+
+// Listen on a Unix socket (an existing file at `path` is replaced). Returns 0 or -1.
+int match_server_listen_unix(MatchServer* server, const char* path);
+
+// Listen on 127.0.0.1:port. Returns 0 or -1.
+int match_server_listen_tcp(MatchServer* server, int port);
+
+/**
+ * Answer repeated near-identical queries from `cache` (borrowed) on both the
+ * direct and the micro-batched path. Call before match_server_run.
+ */
+void match_server_set_result_cache(MatchServer* server, ResultCache* cache);
+
+/**
+ * Enable micro-batching: requests arriving within `window_ms` of the first
+ * queued one (at most SERVER_BATCH_MAX_REQUESTS) are decoded in parallel, the
+ * union of their distinct hashes is looked up in one pass in hash order, and
+ * each request is then scored from the shared posting lists. Trades up to
+ * window_ms of latency for fewer index probes under load. 0 (default) matches
+ * every request on its own. Call before match_server_run.
+ */
+void match_server_set_batch_window(MatchServer* server, double window_ms);
+
+/**
+ * Accept and serve connections until match_server_stop() is called, then
+ * close all connections after their pending requests are answered.
+ *
+ * @return 0 on clean shutdown, -1 on error
+ */
+int match_server_run(MatchServer* server);
+
+// Ask match_server_run to return. Async-signal-safe.
+void match_server_stop(MatchServer* server);
+
+void match_server_get_stats(MatchServer* server, MatchServerStats* out);
+
+// Call after match_server_run has returned.
+void match_server_free(MatchServer* server);
+
+#endif // MATCH_SERVER_H
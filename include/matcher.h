@@ -0,0 +1,149 @@
+// File: include/matcher.h
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include "types.h"
+#include "fingerprint_index.h"
+#include "thread_pool.h"
+
+/**
+ * Query engine: fingerprints a clip, looks up every hash and votes on
+ * (song_id, db_time_offset - query_time_offset). A true match piles its votes
+ * onto a single offset difference; chance hits scatter across many.
+ *
+ * A Matcher owns scratch buffers that grow to the largest query seen and are
+ * reused afterwards, so steady-state matching does no per-hash allocation.
+ * One Matcher serves one thread at a time; create one per query thread.
+ */
+typedef struct Matcher Matcher;
+typedef struct ResultCache ResultCache;     // result_cache.h
+typedef struct Verifier Verifier;           // verifier.h
+
+typedef struct {
+    int song_id;
+    int score;              // Votes at the best offset difference
+    int offset;             // Song frame aligned with query frame 0
+    float offset_seconds;
+} MatchResult;
+
+typedef struct {
+    int query_hashes;       // Hashes generated for the clip
+    int hashes_skipped;     // Lists longer than MATCH_MAX_LIST_LEN
+    long long postings;     // Votes cast
+    int terminated_early;   // Progressive mode stopped before the last list
+    long long postings_left; // Postings not scanned because of early termination
+    int cache_hit;          // Answered from the result cache
+    int candidates_rejected; // Dropped by peak verification
+    int budget_hit;         // Bounded mode left hashes or postings out
+} MatchStats;
+
+typedef enum {
+    MATCH_EXHAUSTIVE,       // Vote every posting, then score (default)
+    /**
+     * Visit hashes from the shortest posting list up, keeping running per-song
+     * best scores, and stop once the leader is ahead of the runner-up by more
+     * than all unscanned postings plus MATCH_EARLY_MARGIN. The top song is the
+     * same as in exhaustive mode; lower-ranked entries may be incomplete.
+     */
+    MATCH_PROGRESSIVE,
+    /**
+     * Hard cost cap (see matcher_set_budget): look at a deterministic sample
+     * of at most max_hashes query hashes and vote at most max_postings
+     * postings, whatever the clip length or content. Lists that would overrun
+     * the budget are left out and MatchStats.budget_hit is set. Lists are
+     * chosen from counts capped at the budget (FingerprintIndex.count), and
+     * only the chosen ones are fetched.
+     */
+    MATCH_BOUNDED,
+} MatchMode;
+
+typedef enum {
+    MATCH_SELECT_RAREST,    // Shortest posting lists first; counts every sampled hash
+    MATCH_SELECT_SAMPLE,    // Sampled hashes in query order; stops counting once the budget is spent
+} MatchSelect;
+
+Matcher* matcher_create(FingerprintIndex index);
+void matcher_free(Matcher* matcher);
+void matcher_set_mode(Matcher* matcher, MatchMode mode);
+
+/**
+ * Budget of MATCH_BOUNDED queries; defaults are MATCH_BUDGET_POSTINGS,
+ * MATCH_BUDGET_HASHES and MATCH_SELECT_RAREST. Longer queries are thinned by
+ * hash value rather than position, so the same content keeps the same hashes
+ * wherever it falls in the clip. Bounded queries always run serially.
+ */
+void matcher_set_budget(Matcher* matcher, long long max_postings, int max_hashes, MatchSelect select);
+
+/**
+ * Split exhaustive queries of at least MATCH_PARALLEL_MIN_HASHES hashes across
+ * the pool's workers. Each worker looks up a slice of the hashes and builds a
+ * sorted partial (song_id, delta) histogram; the partials are then merged,
+ * skipping songs with fewer than MATCH_MIN_SCORE votes overall. Results are
+ * identical to serial scoring. The pool is borrowed and may be shared; the
+ * index must be concurrent. NULL restores serial scoring. Progressive and
+ * bounded modes always run serially.
+ *
+ * @return 0 on success, -1 if the index is not concurrent or on allocation failure
+ */
+int matcher_set_thread_pool(Matcher* matcher, ThreadPool* pool);
+
+/**
+ * Answer near-identical queries from `cache` (borrowed; may be shared between
+ * Matchers) and remember new answers in it. Applies to matcher_match_hashes
+ * and everything built on it; matcher_match_lists is never cached. NULL turns
+ * caching off.
+ */
+void matcher_set_result_cache(Matcher* matcher, ResultCache* cache);
+
+/**
+ * Verify clip matches in a second stage (borrowed; NULL turns it off). The
+ * clip is then hashed with the smaller VERIFY_FAN_VALUE fan-out, the top
+ * VERIFY_CANDIDATES (or k, if larger) songs are taken from the vote and the
+ * verifier drops those whose stored peaks do not line up with the query's.
+ * Applies to matcher_match_samples and matcher_match_file; queries given as
+ * hashes carry no peaks and stay single-stage.
+ */
+void matcher_set_verifier(Matcher* matcher, Verifier* verifier);
+
+/**
+ * Score a query given as fingerprint hashes (time_offset = query frame).
+ * Fills up to `k` results ordered by descending score; only songs with at
+ * least MATCH_MIN_SCORE aligned votes are reported.
+ *
+ * @return Number of results written, or -1 on error
+ */
+int matcher_match_hashes(Matcher* matcher, const FingerprintHash64* hashes, int count,
+                         MatchResult* out, int k);
+
+/**
+ * Score a query whose posting lists the caller already fetched (lists[i]
+ * answers hashes[i]), so several queries can share one index pass. Lists
+ * longer than MATCH_MAX_LIST_LEN are skipped as usual; always exhaustive.
+ *
+ * @return Number of results written, or -1 on error
+ */
+int matcher_match_lists(Matcher* matcher, const FingerprintHash64* hashes, const PostingList* lists, int count,
+                        MatchResult* out, int k);
+
+// Mono samples at SAMPLE_RATE, run through spectrogram / peaks / hashing first.
+int matcher_match_samples(Matcher* matcher, const float* samples, int num_samples, int sample_rate,
+                          MatchResult* out, int k);
+
+// Decode an audio file (any rate or channel count load_audio accepts) and match it.
+int matcher_match_file(Matcher* matcher, const char* path, MatchResult* out, int k);
+
+/**
+ * Fingerprint a query clip (time_offset = query frame) without matching it.
+ * *out is NULL with *count 0 when the clip yields no hashes; caller frees *out.
+ *
+ * @return 0 on success, -1 on error
+ */
+int query_fingerprint_samples(const float* samples, int num_samples, int sample_rate,
+                              FingerprintHash64** out, int* count);
+int query_fingerprint_file(const char* path, FingerprintHash64** out, int* count);
+
+// Counters from the most recent query.
+const MatchStats* matcher_last_stats(const Matcher* matcher);
+
+#endif // MATCHER_H
@@ -0,0 +1,63 @@
+// File: include/minhash.h
+
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include <stdint.h>
+#include "config.h"
+#include "types.h"
+
+/**
+ * One-permutation MinHash over a set of fingerprint hashes.
+ *
+ * Each hash is scrambled once with mix_hash64; the top bits pick one of
+ * MINHASH_BINS bins and each bin keeps its smallest value. The fraction of
+ * bins two sketches agree on estimates the Jaccard similarity of the hash
+ * sets. Bins are grouped into bands of MINHASH_BAND_ROWS for locality-
+ * sensitive lookup: near-identical sets almost surely share a whole band.
+ *
+ * Time offsets are ignored for the similarity, but the sketch remembers the
+ * earliest time of each bin's minimum so that a match can report how far one
+ * query is shifted against the other.
+ */
+
+#define MINHASH_EMPTY  UINT64_MAX   // Bin no hash fell into
+#define MINHASH_BANDS  (MINHASH_BINS / MINHASH_BAND_ROWS)
+
+typedef struct {
+    uint64_t mins[MINHASH_BINS];
+    int32_t times[MINHASH_BINS];    // time_offset of each minimum
+} MinHashSketch;
+
+void minhash_compute(const FingerprintHash64* hashes, int count, MinHashSketch* out);
+
+// Agreeing bins over bins filled in either sketch; 0 when both are empty.
+float minhash_similarity(const MinHashSketch* a, const MinHashSketch* b);
+
+// Key of one band's bins, for bucketing sketches by band.
+uint64_t minhash_band_key(const MinHashSketch* sketch, int band);
+
+/**
+ * Most common time difference (b - a) over the agreeing bins, i.e. how many
+ * frames later the shared content appears in b. 0 if no bins agree.
+ */
+int minhash_time_shift(const MinHashSketch* a, const MinHashSketch* b);
+
+/**
+ * Whole-song sketch for spotting re-encodes and edits at ingest. Same scheme
+ * with more bins and shorter bands (songs that share only part of their
+ * hashes should still collide in a band), no times, and 32-bit minimums so
+ * it stays small enough to keep in the Songs table.
+ */
+#define SONG_SKETCH_EMPTY  UINT32_MAX
+#define SONG_SKETCH_BANDS  (SONG_SKETCH_BINS / SONG_SKETCH_BAND_ROWS)
+
+typedef struct {
+    uint32_t mins[SONG_SKETCH_BINS];
+} SongSketch;
+
+void song_sketch_compute(const FingerprintHash64* hashes, int count, SongSketch* out);
+float song_sketch_similarity(const SongSketch* a, const SongSketch* b);
+uint64_t song_sketch_band_key(const SongSketch* sketch, int band);
+
+#endif // MINHASH_H
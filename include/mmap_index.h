@@ -0,0 +1,60 @@
+// File: include/mmap_index.h
+
+#ifndef MMAP_INDEX_H
+#define MMAP_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "db.h"
+
+/**
+ * Read-only inverted index file mapped into memory.
+ *
+ * Layout (native endianness, sections 64-byte aligned):
+ *   header
+ *   Posting   postings[num_postings]      grouped by hash, sorted by (song_id, time_offset)
+ *   uint64_t  hashes[num_hashes]          unique hashes, ascending
+ *   uint64_t  starts[num_hashes + 1]      postings of hashes[i] are [starts[i], starts[i+1])
+ *   uint64_t  directory[65537]            first hash index for each 16-bit hash prefix
+ *   uint64_t  filter[filter_blocks * 8]   blocked Bloom filter over hashes (version 2+)
+ *
+ * Lookups of hashes the filter rules out return without touching the tables.
+ * Opening is O(1): nothing is parsed beyond the header, and pages are shared
+ * between processes mapping the same file.
+ */
+typedef struct MmapIndex MmapIndex;
+
+MmapIndex* mmap_index_open(const char* path);
+void mmap_index_close(MmapIndex* index);
+
+/**
+ * Look up the postings of one hash.
+ *
+ * @param out     Receives a pointer into the mapping (valid until close); NULL if absent
+ * @return        Number of postings, 0 if the hash is not in the index
+ */
+size_t mmap_index_lookup(const MmapIndex* index, uint64_t hash, const Posting** out);
+
+uint64_t mmap_index_num_hashes(const MmapIndex* index);
+uint64_t mmap_index_num_postings(const MmapIndex* index);
+
+// Access by position, for sequential passes over the whole index
+uint64_t mmap_index_hash_at(const MmapIndex* index, uint64_t i);
+size_t mmap_index_postings_at(const MmapIndex* index, uint64_t i, const Posting** out);
+
+/**
+ * Streaming builder. Records must be added in ascending (hash, song_id, time_offset)
+ * order with the hash compared as uint64_t; exact duplicates are dropped.
+ */
+typedef struct MmapIndexWriter MmapIndexWriter;
+
+MmapIndexWriter* mmap_index_writer_open(const char* path);
+int mmap_index_writer_add(MmapIndexWriter* writer, uint64_t hash, int song_id, int time_offset);
+int mmap_index_writer_finish(MmapIndexWriter* writer);  // Writes tables, fsyncs, renames into place, frees
+void mmap_index_writer_abort(MmapIndexWriter* writer);  // Frees the writer, removes the partial file
+
+// Convert the Fingerprints table into an index file. Returns 0 on success.
+int mmap_index_build_from_db(db_ctx* ctx, const char* path);
+
+#endif // MMAP_INDEX_H
@@ -20,6 +20,20 @@ extern "C" {
  */
 Peak* detect_peaks(float** spectrogram, int num_frames, int num_bins, int* num_peaks_out);
 
+/**
+ * @brief Detects the peaks of a single frame, for callers that hold only a
+ *        sliding window of frames (streaming). Same rules as detect_peaks().
+ *
+ * @param spectrogram     Window of frames [num_frames][num_bins] around `frame`
+ * @param num_frames      Number of frames in the window
+ * @param num_bins        Number of frequency bins per frame
+ * @param frame           Index of the frame to scan, within the window
+ * @param time_index      Value stored in Peak.time_index for this frame
+ * @param out             Receives the peaks in bin order (room for num_bins)
+ * @return int            Number of peaks written
+ */
+int detect_frame_peaks(float** spectrogram, int num_frames, int num_bins, int frame, int time_index, Peak* out);
+
 #ifdef __cplusplus
 }
 #endif
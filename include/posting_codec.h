@@ -0,0 +1,43 @@
+// File: include/posting_codec.h
+
+#ifndef POSTING_CODEC_H
+#define POSTING_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/**
+ * Compressed posting lists.
+ *
+ * A list sorted by (song_id, time_offset) is delta-encoded: the song id as a gap
+ * from the previous entry, the time offset as a gap when the song is unchanged
+ * and verbatim otherwise. Full blocks of 128 entries are bit-packed at the
+ * smallest width that fits (frame-of-reference) in a 4-lane interleaved layout
+ * that SSE2 unpacks four values at a time; the remainder is varint-encoded.
+ *
+ *   varint count
+ *   per full block: u8 song_bits, u8 time_bits, song gaps, time values
+ *   tail: varint song gap, varint time value per entry
+ */
+
+#define POSTING_BLOCK_SIZE 128
+
+// Upper bound on the encoded size of a list of n postings.
+size_t posting_codec_max_encoded_size(size_t n);
+
+// Encode a sorted list. Returns bytes written to `out`.
+size_t posting_codec_encode(const Posting* in, size_t n, uint8_t* out);
+
+// Number of postings stored in an encoded list, without decoding it.
+size_t posting_codec_count(const uint8_t* in);
+
+/**
+ * Decode a list into `out` (room for posting_codec_count(in) entries).
+ *
+ * @param consumed  If not NULL, receives the number of bytes read
+ * @return          Number of postings decoded
+ */
+size_t posting_codec_decode(const uint8_t* in, Posting* out, size_t* consumed);
+
+#endif // POSTING_CODEC_H
@@ -0,0 +1,60 @@
+// File: include/result_cache.h
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stdint.h>
+#include "minhash.h"
+#include "matcher.h"
+
+/**
+ * LRU cache of match results keyed by the query's MinHash sketch, so content
+ * that is queried again and again (ads, jingles, hits) costs a probe instead
+ * of a full lookup.
+ *
+ * A probe checks the entries sharing at least one LSH band with the query and
+ * takes the most similar one if it reaches RESULT_CACHE_MIN_SIMILARITY. The
+ * cached offsets are moved by the time shift between the two queries, so a
+ * jingle caught earlier or later in the clip still reports the right offset.
+ * Queries with fewer than RESULT_CACHE_MIN_HASHES hashes are not cached.
+ * Results, misses included, are dropped as soon as the index generation moves.
+ *
+ * Thread-safe; one cache can sit in front of several Matchers.
+ */
+typedef struct ResultCache ResultCache;
+
+typedef struct {
+    long long hits;
+    long long misses;
+    long long evictions;
+    int entries;
+} ResultCacheStats;
+
+ResultCache* result_cache_create(int capacity);
+void result_cache_free(ResultCache* cache);
+
+/**
+ * Look a query up. On a hit, writes up to `k` results and returns their
+ * count; returns -1 on a miss. *generation receives the token to pass to
+ * result_cache_store for this query.
+ */
+int result_cache_lookup(ResultCache* cache, const MinHashSketch* sketch, int num_hashes,
+                        MatchResult* out, int k, uint64_t* generation);
+
+/**
+ * Remember the `found` results of a query matched with top-`k`. Dropped if
+ * the cache was invalidated since the lookup that produced `generation`.
+ */
+void result_cache_store(ResultCache* cache, const MinHashSketch* sketch, int num_hashes,
+                        uint64_t generation, const MatchResult* results, int found, int k);
+
+// Drop every entry; call whenever the index behind the cached results changes.
+void result_cache_invalidate(ResultCache* cache);
+
+// Invalidate if `index_generation` differs from the value of the previous call
+// (see FingerprintIndex.generation). Matchers call this before every probe.
+void result_cache_sync(ResultCache* cache, int64_t index_generation);
+
+void result_cache_get_stats(ResultCache* cache, ResultCacheStats* out);
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,33 @@
+// File: include/segmenter.h
+
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <stdint.h>
+#include "matcher.h"
+
+/**
+ * Timeline of a long recording (hours of broadcast capture). The input is
+ * read sequentially in SEGMENT_WINDOW_SEC windows spaced SEGMENT_HOP_SEC
+ * apart; each window is normalized, fingerprinted with times relative to its
+ * own start and matched on its own, so memory does not depend on recording
+ * length. Consecutive windows that agree on the song and its alignment are
+ * stitched into one entry; boundaries are accurate to within one window.
+ */
+typedef struct {
+    double start_seconds;       // Recording time the song was first heard
+    double end_seconds;         // Recording time it was last heard
+    int song_id;
+    int score;                  // Best single-window score
+    float song_start_seconds;   // Song position at start_seconds
+} TimelineEntry;
+
+/**
+ * Segment an audio file (any format and rate load_audio accepts).
+ * *out is NULL with *count 0 when nothing matched; caller frees *out.
+ *
+ * @return 0 on success, -1 on error
+ */
+int segment_file(Matcher* matcher, const char* path, TimelineEntry** out, int* count);
+
+#endif // SEGMENTER_H
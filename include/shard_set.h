@@ -0,0 +1,54 @@
+// File: include/shard_set.h
+
+#ifndef SHARD_SET_H
+#define SHARD_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+#include "db.h"
+
+/**
+ * Fingerprint store partitioned into N SQLite files ("<base>.shardNN") by hash
+ * prefix. Songs stay in the main catalog database; shards hold Fingerprints only.
+ *
+ * Routing uses the top bits of mix_hash64(hash): the raw hash prefix is the anchor
+ * frequency, which is far too skewed to balance shards. The shard count is
+ * recorded in every shard and checked on open.
+ *
+ * Each shard has its own connection and worker thread, so batch inserts and
+ * batch lookups run on all shards in parallel (and shards may sit on different
+ * disks via symlinks). A ShardSet serves one call at a time.
+ */
+typedef struct ShardSet ShardSet;
+
+// flags: 0 for ingest, DB_CTX_READONLY for query serving.
+ShardSet* shard_set_open(const char* base_path, int num_shards, int flags);
+void shard_set_close(ShardSet* set);
+
+int shard_set_num_shards(const ShardSet* set);
+int shard_set_shard_of(const ShardSet* set, uint64_t hash);
+
+// Sum of the shards' catalog generations (see db_get_generation). Returns 0 or -1.
+int shard_set_generation(ShardSet* set, int64_t* generation);
+
+/**
+ * Route a batch to its shards and insert on all of them in parallel. Each shard
+ * commits independently. `hashes` is reordered.
+ *
+ * @return 0 if every shard succeeded, -1 otherwise
+ */
+int shard_set_insert_fingerprints(ShardSet* set, FingerprintHash64* hashes, int count, int* inserted);
+
+/**
+ * Look up many hashes, fanned out to the shards in parallel. out[i] answers
+ * hashes[i] and points into buffers owned by the set, valid until the next call.
+ *
+ * @return 0 on success, -1 on error
+ */
+int shard_set_lookup_batch(ShardSet* set, const uint64_t* hashes, size_t n, PostingList* out);
+
+// Posting count of one hash, read on the calling thread (see db_count_hash).
+int shard_set_count(ShardSet* set, uint64_t hash, int cap);
+
+#endif // SHARD_SET_H
@@ -0,0 +1,39 @@
+// File: include/sketch_index.h
+
+#ifndef SKETCH_INDEX_H
+#define SKETCH_INDEX_H
+
+#include "db.h"
+#include "minhash.h"
+
+/**
+ * In-memory LSH index over whole-song sketches, used at ingest to catch
+ * re-encoded or edited copies of songs already in the catalog before their
+ * fingerprints are written. A probe hashes the SONG_SKETCH_BANDS bands of the
+ * new song and compares only the songs that share a band bucket with it, so
+ * its cost does not grow with the catalog.
+ *
+ * Not thread-safe.
+ */
+typedef struct SketchIndex SketchIndex;
+
+SketchIndex* sketch_index_create(void);
+void sketch_index_free(SketchIndex* index);
+
+// Returns 0 or -1. `song_id` is reported back by sketch_index_find as is.
+int sketch_index_add(SketchIndex* index, int song_id, const SongSketch* sketch);
+
+/**
+ * Find the most similar indexed song with at least `min_similarity`.
+ *
+ * @return 1 with *song_id and *similarity set, or 0 if there is none
+ */
+int sketch_index_find(SketchIndex* index, const SongSketch* sketch, float min_similarity,
+                      int* song_id, float* similarity);
+
+// Add every sketch stored in the catalog (see db_scan_song_sketches). Returns the count or -1.
+int sketch_index_load_from_db(SketchIndex* index, db_ctx* ctx);
+
+int sketch_index_size(const SketchIndex* index);
+
+#endif // SKETCH_INDEX_H
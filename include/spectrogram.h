@@ -38,4 +38,14 @@ int build_spectrogram_from_samples(const float* samples,
                                    int* out_num_frames,
                                    int* out_num_bins);
 
+/**
+ * Magnitude spectrum of a single frame: Hann window, FFT, magnitude. This is
+ * the per-row step of build_spectrogram_from_samples, exposed for streaming.
+ *
+ * @param frame        FRAME_SIZE samples (not modified)
+ * @param work         Scratch buffer of FRAME_SIZE entries
+ * @param magnitude    Receives FRAME_SIZE / 2 bins
+ */
+void spectrogram_frame(const float* frame, Complex* work, float* magnitude);
+
 #endif // SPECTROGRAM_H
\ No newline at end of file
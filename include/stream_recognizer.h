@@ -0,0 +1,60 @@
+// File: include/stream_recognizer.h
+
+#ifndef STREAM_RECOGNIZER_H
+#define STREAM_RECOGNIZER_H
+
+#include "types.h"
+#include "fingerprint_index.h"
+
+/**
+ * Continuous recognition of a live feed. PCM is pushed in chunks of any size;
+ * every HOP_SIZE samples one STFT frame is computed, peaks are found once the
+ * frame's neighbourhood is complete, and each new peak is hashed against the
+ * FAN_VALUE peaks before it. Hashes are looked up immediately and vote into a
+ * fixed-size table of (song_id, offset) cells whose weight halves every
+ * STREAM_HALF_LIFE_SEC, so old material fades out and a song change shows up
+ * as the reported cell decaying while a new one grows.
+ *
+ * All state is allocated at creation: memory and work per pushed sample are
+ * constant however long the stream runs. A recognizer serves one thread at a
+ * time; the index follows the same rules as for a Matcher.
+ */
+typedef struct StreamRecognizer StreamRecognizer;
+
+typedef enum {
+    STREAM_EVENT_MATCH,     // A song was recognized
+    STREAM_EVENT_END,       // The reported song stopped matching
+} StreamEventType;
+
+typedef struct {
+    StreamEventType type;
+    int song_id;
+    float score;            // Decayed aligned votes
+    double stream_seconds;  // Stream time of the event
+    float song_seconds;     // Song position playing at stream_seconds
+} StreamEvent;
+
+typedef void (*stream_event_cb)(const StreamEvent* event, void* user);
+
+/**
+ * @param index     Catalog to look hashes up in (borrowed)
+ * @param on_event  Called from stream_recognizer_push on every match / end (may be NULL)
+ * @param user      Passed through to on_event
+ */
+StreamRecognizer* stream_recognizer_create(FingerprintIndex index, stream_event_cb on_event, void* user);
+void stream_recognizer_free(StreamRecognizer* rec);
+
+// Forget all audio and votes, e.g. before reusing the recognizer for another feed.
+void stream_recognizer_reset(StreamRecognizer* rec);
+
+/**
+ * Feed mono samples at SAMPLE_RATE.
+ *
+ * @return 0 on success, -1 on invalid input
+ */
+int stream_recognizer_push(StreamRecognizer* rec, const float* samples, int num_samples);
+
+// Fill *out with the song currently reported (type STREAM_EVENT_MATCH). Returns 1, or 0 if none.
+int stream_recognizer_current(const StreamRecognizer* rec, StreamEvent* out);
+
+#endif // STREAM_RECOGNIZER_H
@@ -0,0 +1,36 @@
+// File: include/thread_pool.h
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+/**
+ * Fixed-size worker pool. Tasks receive the index of the worker running them
+ * (0..size-1) so callers can keep per-worker scratch buffers without locking.
+ * Completion is tracked per TaskGroup, so independent callers can share a pool.
+ */
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*task_fn)(void* arg, int worker_id);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int pending;
+} TaskGroup;
+
+ThreadPool* thread_pool_create(int num_threads);
+void thread_pool_destroy(ThreadPool* pool);     // Runs queued tasks, then joins
+int thread_pool_size(const ThreadPool* pool);
+
+void task_group_init(TaskGroup* group);
+void task_group_destroy(TaskGroup* group);
+
+// Queue fn(arg) as part of `group` (may be NULL). Returns 0 or -1.
+int thread_pool_submit(ThreadPool* pool, TaskGroup* group, task_fn fn, void* arg);
+
+// Block until every task submitted with `group` has finished.
+void task_group_wait(TaskGroup* group);
+
+#endif // THREAD_POOL_H
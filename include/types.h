@@ -3,6 +3,9 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 // ===========================
 // Complex Number (for FFT)
 // ===========================
@@ -26,10 +29,24 @@ typedef struct {
 // ===========================
 
 typedef struct {
-    unsigned int hash;   // Hash value
+    uint64_t hash;       // Hash value (full 64-bit layout, see hashing.c)
     int time_offset;     // Time of anchor peak (used for alignment)*/
     int anchor_time;
     int song_id;         // Reference to song in database
 } FingerprintHash64;
 
+// ===========================
+// Posting (index entry for one hash)
+// ===========================
+
+typedef struct {
+    int song_id;         // Song containing the hash
+    int time_offset;     // Anchor frame within that song
+} Posting;
+
+typedef struct {
+    const Posting* postings;  // Borrowed from the index; NULL when count is 0
+    size_t count;
+} PostingList;
+
 #endif // TYPES_H
@@ -0,0 +1,41 @@
+// File: include/verifier.h
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "types.h"
+#include "db.h"
+#include "matcher.h"
+
+/**
+ * Second matching stage. Hash votes find candidates cheaply but can be fooled
+ * by chance collisions; the verifier lines the query's peaks up against each
+ * candidate song's stored peaks (see db_load_song_peaks) at the voted offset
+ * and keeps the candidate only if enough of them land on a song peak, within
+ * VERIFY_TIME_TOLERANCE frames and VERIFY_FREQ_TOLERANCE bins. Only the
+ * blocks around the matched window are read.
+ *
+ * Songs ingested before peaks were stored cannot be checked and pass through.
+ */
+typedef struct Verifier Verifier;
+
+// Verify through `db` (borrowed); use from one thread at a time.
+Verifier* verifier_create(db_ctx* db);
+
+// Verify through pooled contexts (borrowed); safe to share between threads.
+Verifier* verifier_create_pool(db_pool* pool);
+
+void verifier_free(Verifier* verifier);
+
+/**
+ * Check candidates in place: rejected ones are removed and the rest keep
+ * their order.
+ *
+ * @param query      Query peaks in time order, as detect_peaks returns them
+ * @param rejected   If not NULL, receives the number of candidates removed
+ * @return           Candidates kept, or -1 on error
+ */
+int verifier_check(Verifier* verifier, const Peak* query, int num_query,
+                   MatchResult* candidates, int count, int* rejected);
+
+#endif // VERIFIER_H
@@ -0,0 +1,81 @@
+// File: include/vote_scoring.h
+
+#ifndef VOTE_SCORING_H
+#define VOTE_SCORING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matcher.h"
+
+/**
+ * Histogram scoring for offset-difference votes without a hash map.
+ *
+ * Votes are packed (song_id, delta) keys. The scorer re-packs them into the
+ * fewest bits the query's actual song and delta ranges need, then either
+ * counts them in a dense array (small ranges) or LSD radix-sorts them with
+ * 11-bit digits and counts runs. All buffers are reused across calls.
+ */
+typedef struct VoteScorer VoteScorer;
+
+// Sorting order matches (song_id, delta) with delta treated as signed.
+static inline uint64_t vote_pack(int song_id, int delta) {
+    return ((uint64_t)(uint32_t)song_id << 32) | ((uint32_t)delta ^ 0x80000000u);
+}
+
+static inline int vote_song(uint64_t key) {
+    return (int)(uint32_t)(key >> 32);
+}
+
+static inline int vote_delta(uint64_t key) {
+    return (int)((uint32_t)key ^ 0x80000000u);
+}
+
+typedef enum {
+    VOTE_SCORE_AUTO,        // Dense when the key range is small, radix otherwise
+    VOTE_SCORE_DENSE,       // Falls back to radix if the range is too large
+    VOTE_SCORE_RADIX,
+} VoteScoreMethod;
+
+VoteScorer* vote_scorer_create(void);
+void vote_scorer_free(VoteScorer* scorer);
+
+/**
+ * Find each song's best delta and keep the top `k` songs scoring at least
+ * `min_score`, ordered by descending score. `votes` is left unchanged.
+ *
+ * @return Number of results written, or -1 on allocation failure
+ */
+int vote_scorer_score(VoteScorer* scorer, const uint64_t* votes, size_t n, VoteScoreMethod method,
+                      int min_score, MatchResult* out, int k);
+
+/**
+ * Partial histogram: distinct vote_pack() keys in ascending order with their
+ * vote counts. `next` and `song_end` are cursors used by vote_runs_merge().
+ */
+typedef struct {
+    const uint64_t* keys;
+    const uint32_t* counts;
+    size_t count;
+    size_t next;
+    size_t song_end;
+} VoteRuns;
+
+/**
+ * Collapse votes into a partial histogram (always via radix sort). The arrays
+ * belong to the scorer and stay valid until its next call.
+ *
+ * @return 0 on success, -1 on allocation failure
+ */
+int vote_scorer_runs(VoteScorer* scorer, const uint64_t* votes, size_t n, VoteRuns* out);
+
+/**
+ * Sum several partial histograms built over disjoint subsets of one query's
+ * votes and report the best offset of each song, exactly as vote_scorer_score()
+ * would for the combined votes. Songs whose total votes across all inputs are
+ * below min_score are skipped without merging their cells.
+ *
+ * @return Number of results written
+ */
+int vote_runs_merge(VoteRuns* runs, int num_runs, int min_score, MatchResult* out, int k);
+
+#endif // VOTE_SCORING_H
@@ -4,103 +4,191 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "sndfile.h"
 #include <math.h>
 #include "config.h"
 #include "audio_io.h"
 
-// Loads an audio file, converts to mono, resamples if needed, and normalizes.
-// Returns 0 on success, -1 on failure.
-// Caller must free *out_buffer.
-int load_audio(const char* filepath, float** out_buffer, int* out_samples, int* out_samplerate) {
+#define READ_BLOCK_FRAMES 65536   // Input frames decoded per refill
+
+struct AudioReader {
+    SNDFILE* file;
+    int channels;
+    int sample_rate;            // Input rate
+    sf_count_t input_frames;
+    int eof;
+
+    float* block;               // Interleaved frames from the last read
+    float* mono;                // Mono input window: mono[0] is input frame mono_start
+    sf_count_t mono_start;
+    int mono_len;
+
+    int64_t produced;           // Output samples returned so far
+    int64_t total;              // Output samples the file yields at SAMPLE_RATE
+};
+
+AudioReader* audio_reader_open(const char* filepath) {
     SF_INFO sfinfo;
     memset(&sfinfo, 0, sizeof(SF_INFO));
 
     SNDFILE* file = sf_open(filepath, SFM_READ, &sfinfo);
     if (!file) {
         fprintf(stderr, "Error opening audio file: %s\n", filepath);
-        return -1;
+        return NULL;
+    }
+    if (sfinfo.channels <= 0 || sfinfo.samplerate <= 0) {
+        fprintf(stderr, "Unsupported audio format: %s\n", filepath);
+        sf_close(file);
+        return NULL;
     }
 
-    int total_samples = sfinfo.frames;
-    int channels = sfinfo.channels;
-    int sample_rate = sfinfo.samplerate;
-
-    float* buffer = (float*)malloc(total_samples * channels * sizeof(float));
-    if (!buffer) {
+    AudioReader* reader = (AudioReader*)calloc(1, sizeof(AudioReader));
+    if (reader) {
+        reader->block = (float*)malloc((size_t)(READ_BLOCK_FRAMES + 1) * sfinfo.channels * sizeof(float));
+        reader->mono = (float*)malloc((READ_BLOCK_FRAMES + 1) * sizeof(float));
+    }
+    if (!reader || !reader->block || !reader->mono) {
         fprintf(stderr, "Memory allocation failed.\n");
+        if (reader) {
+            free(reader->block);
+            free(reader->mono);
+        }
+        free(reader);
         sf_close(file);
-        return -1;
+        return NULL;
     }
 
-    int readcount = sf_readf_float(file, buffer, total_samples);
-    sf_close(file);
+    reader->file = file;
+    reader->channels = sfinfo.channels;
+    reader->sample_rate = sfinfo.samplerate;
+    reader->input_frames = sfinfo.frames;
+    reader->total = sfinfo.samplerate == SAMPLE_RATE
+                  ? (int64_t)sfinfo.frames
+                  : (int64_t)((double)sfinfo.frames * SAMPLE_RATE / sfinfo.samplerate);
+    return reader;
+}
 
-    // Convert to mono if stereo
-    float* mono = (float*)calloc(total_samples, sizeof(float));
-    if (!mono) {
-        fprintf(stderr, "Memory allocation failed (mono).\n");
-        free(buffer);
-        return -1;
-    }
+void audio_reader_close(AudioReader* reader) {
+    if (!reader) return;
+    sf_close(reader->file);
+    free(reader->block);
+    free(reader->mono);
+    free(reader);
+}
+
+int64_t audio_reader_total_samples(const AudioReader* reader) {
+    return reader->total;
+}
 
-    if (channels == 1) {
-        memcpy(mono, buffer, total_samples * sizeof(float));
+// Slide the mono window to start at input frame `from` (or at the next unread
+// frame if `from` lies beyond the window), then decode more.
+static void refill(AudioReader* r, sf_count_t from) {
+    sf_count_t end = r->mono_start + r->mono_len;
+    int keep = 0;
+    if (from < end) {
+        keep = (int)(end - from);
+        memmove(r->mono, r->mono + (from - r->mono_start), keep * sizeof(float));
+        r->mono_start = from;
     } else {
-        for (int i = 0; i < total_samples; ++i) {
-            float sum = 0.0f;
-            for (int ch = 0; ch < channels; ++ch) {
-                sum += buffer[i * channels + ch];
-            }
-            mono[i] = sum / channels;
-        }
+        r->mono_start = end;
+    }
+    r->mono_len = keep;
+
+    sf_count_t got = sf_readf_float(r->file, r->block, READ_BLOCK_FRAMES + 1 - keep);
+    if (got <= 0) {
+        r->eof = 1;
+        return;
     }
-    free(buffer);
-
-    // Resample if sample rate != 44100
-    if (sample_rate != SAMPLE_RATE) {
-        int new_length = (int)((double)total_samples * SAMPLE_RATE / sample_rate);
-        float* resampled = (float*)malloc(new_length * sizeof(float));
-        if (!resampled) {
-            fprintf(stderr, "Memory allocation failed (resample).\n");
-            free(mono);
-            return -1;
+
+    // Convert to mono
+    for (sf_count_t i = 0; i < got; ++i) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < r->channels; ++ch) {
+            sum += r->block[i * r->channels + ch];
         }
+        r->mono[keep + i] = sum / r->channels;
+    }
+    r->mono_len = keep + (int)got;
+}
 
-        for (int i = 0; i < new_length; ++i) {
-            double src_index = (double)i * sample_rate / SAMPLE_RATE;
-            int idx = (int)src_index;
-            double frac = src_index - idx;
+int audio_reader_read(AudioReader* r, float* out, int max_samples) {
+    if (!r || !out || max_samples < 0) {
+        fprintf(stderr, "Invalid input to audio_reader_read.\n");
+        return -1;
+    }
 
-            // Linear interpolation
-            float a = (idx < total_samples) ? mono[idx] : 0.0f;
-            float b = (idx + 1 < total_samples) ? mono[idx + 1] : 0.0f;
-            resampled[i] = a + frac * (b - a);
+    int n = 0;
+    while (n < max_samples && r->produced < r->total) {
+        // Linear interpolation between input frames idx and idx + 1
+        double src_index = (double)r->produced * r->sample_rate / SAMPLE_RATE;
+        sf_count_t idx = (sf_count_t)src_index;
+        double frac = src_index - idx;
+
+        sf_count_t needed = idx + 1 < r->input_frames ? idx + 1 : idx;
+        if (needed >= r->mono_start + r->mono_len && !r->eof) {
+            refill(r, idx);
+            continue;
         }
 
+        float a = (idx - r->mono_start < r->mono_len) ? r->mono[idx - r->mono_start] : 0.0f;
+        float b = (idx + 1 - r->mono_start < r->mono_len) ? r->mono[idx + 1 - r->mono_start] : 0.0f;
+        out[n++] = a + frac * (b - a);
+        r->produced++;
+    }
+    return n;
+}
+
+// Loads an audio file, converts to mono, resamples if needed, and normalizes.
+// Returns 0 on success, -1 on failure.
+// Caller must free *out_buffer.
+int load_audio(const char* filepath, float** out_buffer, int* out_samples, int* out_samplerate) {
+    AudioReader* reader = audio_reader_open(filepath);
+    if (!reader) return -1;
+
+    int64_t total = audio_reader_total_samples(reader);
+    if (total > INT_MAX) {
+        fprintf(stderr, "Audio file too long to load at once (%.0f s): %s\n",
+                (double)total / SAMPLE_RATE, filepath);
+        audio_reader_close(reader);
+        return -1;
+    }
+
+    float* mono = (float*)calloc(total > 0 ? (size_t)total : 1, sizeof(float));
+    if (!mono) {
+        fprintf(stderr, "Memory allocation failed (mono).\n");
+        audio_reader_close(reader);
+        return -1;
+    }
+
+    int total_samples = audio_reader_read(reader, mono, (int)total);
+    audio_reader_close(reader);
+    if (total_samples < 0) {
         free(mono);
-        mono = resampled;
-        total_samples = new_length;
-        sample_rate = SAMPLE_RATE;
+        return -1;
     }
 
+    audio_normalize(mono, total_samples);
+
+    *out_buffer = mono;
+    *out_samples = total_samples;
+    *out_samplerate = SAMPLE_RATE;
+
+    return 0;
+}
+
+void audio_normalize(float* samples, int num_samples) {
     // Normalize to [-1.0, 1.0]
     float max_amp = 0.0f;
-    for (int i = 0; i < total_samples; ++i) {
-        if (fabsf(mono[i]) > max_amp) {
-            max_amp = fabsf(mono[i]);
+    for (int i = 0; i < num_samples; ++i) {
+        if (fabsf(samples[i]) > max_amp) {
+            max_amp = fabsf(samples[i]);
         }
     }
 
     if (max_amp > 0.0f) {
-        for (int i = 0; i < total_samples; ++i) {
-            mono[i] /= max_amp;
+        for (int i = 0; i < num_samples; ++i) {
+            samples[i] /= max_amp;
         }
     }
-
-    *out_buffer = mono;
-    *out_samples = total_samples;
-    *out_samplerate = sample_rate;
-
-    return 0;
 }
@@ -0,0 +1,323 @@
+// File: src/batch_match.c
+// Multi-query matching by one merge-join of sorted query hashes against the index.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "vote_scoring.h"
+#include "batch_match.h"
+
+// One query hash, tagged with where its votes go.
+typedef struct {
+    uint64_t hash;
+    int query;
+    int time_offset;
+} BatchEntry;
+
+typedef struct {
+    uint64_t* votes;
+    size_t count;
+    size_t capacity;
+} VoteList;
+
+typedef struct {
+    BatchEntry* entries;        // Sorted by hash
+    size_t num_entries;
+    VoteList* votes;            // One per query
+    int num_queries;
+    int failed;
+} BatchJoin;
+
+static int compare_entry(const void* a, const void* b) {
+    const BatchEntry* x = (const BatchEntry*)a;
+    const BatchEntry* y = (const BatchEntry*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return x->query - y->query;
+}
+
+static int join_init(BatchJoin* j, const BatchQuery* queries, int num_queries) {
+    memset(j, 0, sizeof(*j));
+    size_t total = 0;
+    for (int q = 0; q < num_queries; q++)
+        total += (size_t)queries[q].count;
+
+    j->entries = (BatchEntry*)malloc((total ? total : 1) * sizeof(BatchEntry));
+    j->votes = (VoteList*)calloc(num_queries > 0 ? (size_t)num_queries : 1, sizeof(VoteList));
+    if (!j->entries || !j->votes) {
+        free(j->entries);
+        free(j->votes);
+        return -1;
+    }
+
+    for (int q = 0; q < num_queries; q++) {
+        for (int i = 0; i < queries[q].count; i++) {
+            BatchEntry* e = &j->entries[j->num_entries++];
+            e->hash = queries[q].hashes[i].hash;
+            e->query = q;
+            e->time_offset = queries[q].hashes[i].time_offset;
+        }
+    }
+    j->num_queries = num_queries;
+
+    // The only sort of the whole batch
+    qsort(j->entries, j->num_entries, sizeof(BatchEntry), compare_entry);
+    return 0;
+}
+
+static void join_free(BatchJoin* j) {
+    for (int q = 0; q < j->num_queries; q++)
+        free(j->votes[q].votes);
+    free(j->votes);
+    free(j->entries);
+}
+
+// Route one hash's postings to every query entry [first, last) carrying that hash.
+static void route_postings(BatchJoin* j, size_t first, size_t last, const Posting* p, size_t count) {
+    if (count == 0 || count > MATCH_MAX_LIST_LEN) return;
+
+    for (size_t e = first; e < last; e++) {
+        VoteList* v = &j->votes[j->entries[e].query];
+        if (v->count + count > v->capacity) {
+            size_t capacity = v->capacity ? v->capacity : 1024;
+            while (capacity < v->count + count) capacity *= 2;
+            uint64_t* votes = realloc(v->votes, capacity * sizeof(uint64_t));
+            if (!votes) {
+                j->failed = 1;
+                return;
+            }
+            v->votes = votes;
+            v->capacity = capacity;
+        }
+
+        int query_time = j->entries[e].time_offset;
+        for (size_t i = 0; i < count; i++)
+            v->votes[v->count++] = vote_pack(p[i].song_id, p[i].time_offset - query_time);
+    }
+}
+
+static int join_score(BatchJoin* j, MatchResult* out, int k, int* found) {
+    VoteScorer* scorer = vote_scorer_create();
+    if (!scorer) return -1;
+
+    int rc = 0;
+    for (int q = 0; q < j->num_queries && rc == 0; q++) {
+        found[q] = vote_scorer_score(scorer, j->votes[q].votes, j->votes[q].count, VOTE_SCORE_AUTO,
+                                     MATCH_MIN_SCORE, out + (size_t)q * k, k);
+        if (found[q] < 0) rc = -1;
+    }
+
+    vote_scorer_free(scorer);
+    return rc;
+}
+
+static int check_input(const BatchQuery* queries, int num_queries, MatchResult* out, int k, int* found) {
+    if ((!queries && num_queries > 0) || num_queries < 0 || !out || !found || k <= 0) {
+        fprintf(stderr, "Invalid input to batch match.\n");
+        return -1;
+    }
+    return 0;
+}
+
+// ===========================
+// Memory-mapped index
+// ===========================
+
+int batch_match_mmap(const MmapIndex* index, const BatchQuery* queries, int num_queries,
+                     MatchResult* out, int k, int* found) {
+    if (check_input(queries, num_queries, out, k, found) != 0) return -1;
+
+    BatchJoin j;
+    if (join_init(&j, queries, num_queries) != 0) {
+        fprintf(stderr, "Memory allocation failed for batch match.\n");
+        return -1;
+    }
+
+    uint64_t num_hashes = mmap_index_num_hashes(index);
+    uint64_t cursor = 0;
+    size_t e = 0;
+    while (e < j.num_entries && cursor < num_hashes && !j.failed) {
+        uint64_t target = j.entries[e].hash;
+
+        // Gallop forward, then binary-search the last step; the cursor never moves back
+        if (mmap_index_hash_at(index, cursor) < target) {
+            uint64_t step = 1, lo = cursor;
+            while (cursor + step < num_hashes && mmap_index_hash_at(index, cursor + step) < target) {
+                lo = cursor + step;
+                step *= 2;
+            }
+            uint64_t hi = cursor + step < num_hashes ? cursor + step : num_hashes;
+            lo++;
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                if (mmap_index_hash_at(index, mid) < target) lo = mid + 1;
+                else hi = mid;
+            }
+            cursor = lo;
+            if (cursor == num_hashes) break;
+        }
+
+        size_t last = e + 1;
+        while (last < j.num_entries && j.entries[last].hash == target) last++;
+
+        if (mmap_index_hash_at(index, cursor) == target) {
+            const Posting* p;
+            size_t count = mmap_index_postings_at(index, cursor, &p);
+            route_postings(&j, e, last, p, count);
+        }
+        e = last;
+    }
+
+    int rc = j.failed ? -1 : join_score(&j, out, k, found);
+    if (rc != 0) fprintf(stderr, "Batch match failed.\n");
+    join_free(&j);
+    return rc;
+}
+
+// ===========================
+// SQLite range scan
+// ===========================
+
+typedef struct {
+    BatchJoin* join;
+    size_t next;                // First entry not yet passed by the scan
+    uint64_t group_hash;        // Postings of the current hash are buffered
+    Posting* group;
+    size_t group_count;
+    size_t group_capacity;
+    int has_group;
+} ScanState;
+
+// Hand the buffered hash group to its entries.
+static void flush_group(ScanState* st) {
+    if (!st->has_group) return;
+    BatchJoin* j = st->join;
+
+    while (st->next < j->num_entries && j->entries[st->next].hash < st->group_hash) st->next++;
+    size_t last = st->next;
+    while (last < j->num_entries && j->entries[last].hash == st->group_hash) last++;
+
+    route_postings(j, st->next, last, st->group, st->group_count);
+    st->next = last;
+    st->group_count = 0;
+    st->has_group = 0;
+}
+
+static int scan_row(uint64_t hash, int song_id, int time_offset, void* user) {
+    ScanState* st = (ScanState*)user;
+    BatchJoin* j = st->join;
+
+    if (st->has_group && hash != st->group_hash) flush_group(st);
+    if (j->failed) return -1;
+
+    if (!st->has_group) {
+        while (st->next < j->num_entries && j->entries[st->next].hash < hash) st->next++;
+        if (st->next == j->num_entries) return 1;           // Every query hash passed
+        if (j->entries[st->next].hash != hash) return 0;    // No query wants this hash
+        st->group_hash = hash;
+        st->has_group = 1;
+    }
+
+    // Lists over the limit are dropped at flush; stop buffering them early
+    if (st->group_count > MATCH_MAX_LIST_LEN) return 0;
+    if (st->group_count == st->group_capacity) {
+        size_t capacity = st->group_capacity ? st->group_capacity * 2 : 1024;
+        Posting* group = realloc(st->group, capacity * sizeof(Posting));
+        if (!group) {
+            j->failed = 1;
+            return -1;
+        }
+        st->group = group;
+        st->group_capacity = capacity;
+    }
+    st->group[st->group_count++] = (Posting){ song_id, time_offset };
+    return 0;
+}
+
+// Stops after BATCH_DENSITY_SAMPLE rows, remembering the last hash seen.
+typedef struct {
+    size_t rows;
+    uint64_t last;
+} DensitySample;
+
+static int sample_row(uint64_t hash, int song_id, int time_offset, void* user) {
+    (void)song_id;
+    (void)time_offset;
+    DensitySample* d = (DensitySample*)user;
+    d->last = hash;
+    return ++d->rows >= BATCH_DENSITY_SAMPLE;
+}
+
+// Estimated rows a scan of [lo, hi] would read, from the density of the
+// first rows at lo (hashes are spread uniformly). 0 when the range is smaller
+// than the sample, -1 on error.
+static double estimate_scan_rows(db_ctx* ctx, uint64_t lo, uint64_t hi) {
+    DensitySample d = { 0, lo };
+    int rc = db_scan_fingerprint_range(ctx, lo, hi, sample_row, &d);
+    if (rc < 0) return -1;
+    if (rc == 0) return 0;
+    return (double)d.rows * ((double)(hi - lo) + 1.0) / ((double)(d.last - lo) + 1.0);
+}
+
+// One db_lookup_hash() per distinct batch hash.
+static int lookup_each(db_ctx* ctx, BatchJoin* j) {
+    Posting* buf = (Posting*)malloc(MATCH_MAX_LIST_LEN * sizeof(Posting));
+    if (!buf) return -1;
+
+    int rc = 0;
+    for (size_t e = 0; e < j->num_entries && rc == 0 && !j->failed;) {
+        size_t last = e + 1;
+        while (last < j->num_entries && j->entries[last].hash == j->entries[e].hash) last++;
+
+        // Lists over the limit come back with a count but are dropped by route_postings
+        int n = db_lookup_hash(ctx, j->entries[e].hash, buf, MATCH_MAX_LIST_LEN);
+        if (n < 0) rc = -1;
+        else route_postings(j, e, last, buf, (size_t)n);
+        e = last;
+    }
+    free(buf);
+    return rc;
+}
+
+int batch_match_db(db_ctx* ctx, const BatchQuery* queries, int num_queries,
+                   MatchResult* out, int k, int* found) {
+    if (check_input(queries, num_queries, out, k, found) != 0) return -1;
+
+    BatchJoin j;
+    if (join_init(&j, queries, num_queries) != 0) {
+        fprintf(stderr, "Memory allocation failed for batch match.\n");
+        return -1;
+    }
+
+    int rc = 0;
+    if (j.num_entries > 0) {
+        uint64_t lo = j.entries[0].hash, hi = j.entries[j.num_entries - 1].hash;
+        size_t distinct = 1;
+        for (size_t e = 1; e < j.num_entries; e++)
+            distinct += j.entries[e].hash != j.entries[e - 1].hash;
+
+        // A small batch spread over a large catalog seeks instead of scanning
+        double scan_rows = estimate_scan_rows(ctx, lo, hi);
+        if (scan_rows < 0) {
+            rc = -1;
+        } else if ((double)distinct * BATCH_SEEK_ROWS < scan_rows) {
+            rc = lookup_each(ctx, &j);
+        } else {
+            ScanState st;
+            memset(&st, 0, sizeof(st));
+            st.join = &j;
+
+            // One ordered pass over the span of hashes the batch touches
+            if (db_scan_fingerprint_range(ctx, lo, hi, scan_row, &st) < 0 && !j.failed) rc = -1;
+            flush_group(&st);
+            free(st.group);
+        }
+    }
+
+    if (rc == 0 && !j.failed) rc = join_score(&j, out, k, found);
+    else rc = -1;
+    if (rc != 0) fprintf(stderr, "Batch match failed.\n");
+    join_free(&j);
+    return rc;
+}
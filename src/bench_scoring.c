@@ -0,0 +1,246 @@
+// File: src/bench_scoring.c
+// Benchmark: vote scoring with a general-purpose hash map vs qsort vs radix/dense.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "config.h"
+#include "vote_scoring.h"
+
+#define MAP_INITIAL   1024         // Slots; doubled past half full
+#define REPEATS       5
+#define TOP_K         5
+#define PLANTED_VOTES 300
+
+typedef struct {
+    const char* name;
+    int songs;              // Distinct songs hit by the query
+    int max_delta;          // Deltas spread over [-max_delta, max_delta] frames
+    size_t votes;
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { "small catalog, short clip",     40,    1000,     20000 },
+    { "1k songs, 10 s clip",           1000,  200,     100000 },
+    { "10k songs, 5 s clip",           10000, 12000,   200000 },
+    { "100k songs, 10 s clip",         100000, 15000, 1000000 },
+    { "100k songs, noisy 30 s clip",   100000, 15000, 2000000 },
+};
+
+// ===========================
+// Hash map: open addressing, grown as entries arrive
+// ===========================
+
+typedef struct {
+    uint64_t* keys;             // 0 marks an empty slot (song ids start at 1)
+    int* counts;
+    size_t mask;
+    size_t used;
+} VoteMap;
+
+static size_t map_slot(const VoteMap* m, uint64_t key) {
+    size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & m->mask;
+    while (m->keys[i] && m->keys[i] != key) i = (i + 1) & m->mask;
+    return i;
+}
+
+static int map_init(VoteMap* m, size_t slots) {
+    m->keys = (uint64_t*)calloc(slots, sizeof(uint64_t));
+    m->counts = (int*)calloc(slots, sizeof(int));
+    m->mask = slots - 1;
+    m->used = 0;
+    return m->keys && m->counts ? 0 : -1;
+}
+
+static int map_grow(VoteMap* m) {
+    VoteMap grown;
+    if (map_init(&grown, (m->mask + 1) * 2) != 0) {
+        free(grown.keys);
+        free(grown.counts);
+        return -1;
+    }
+    for (size_t i = 0; i <= m->mask; i++) {
+        if (!m->keys[i]) continue;
+        size_t j = map_slot(&grown, m->keys[i]);
+        grown.keys[j] = m->keys[i];
+        grown.counts[j] = m->counts[i];
+    }
+    grown.used = m->used;
+    free(m->keys);
+    free(m->counts);
+    *m = grown;
+    return 0;
+}
+
+static int score_hash_map(const uint64_t* votes, size_t n, MatchResult* out, int k) {
+    VoteMap m;
+    if (map_init(&m, MAP_INITIAL) != 0) {
+        free(m.keys);
+        free(m.counts);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        size_t slot = map_slot(&m, votes[i]);
+        if (!m.keys[slot]) {
+            if ((m.used + 1) * 2 > m.mask + 1) {
+                if (map_grow(&m) != 0) {
+                    free(m.keys);
+                    free(m.counts);
+                    return -1;
+                }
+                slot = map_slot(&m, votes[i]);
+            }
+            m.keys[slot] = votes[i];
+            m.used++;
+        }
+        m.counts[slot]++;
+    }
+
+    // Single best (song, delta) cells; enough to compare the winners
+    int found = 0;
+    for (size_t i = 0; i <= m.mask; i++) {
+        int count = m.counts[i];
+        if (!m.keys[i] || count < MATCH_MIN_SCORE || (found == k && count <= out[k - 1].score))
+            continue;
+        int j = found < k ? found++ : k - 1;
+        while (j > 0 && out[j - 1].score < count) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j].song_id = vote_song(m.keys[i]);
+        out[j].score = count;
+        out[j].offset = vote_delta(m.keys[i]);
+    }
+    free(m.keys);
+    free(m.counts);
+    return found;
+}
+
+// ===========================
+// qsort + run counting (the matcher's original approach)
+// ===========================
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int score_qsort(uint64_t* work, const uint64_t* votes, size_t n, MatchResult* out, int k) {
+    memcpy(work, votes, n * sizeof(uint64_t));
+    qsort(work, n, sizeof(uint64_t), compare_u64);
+
+    int found = 0;
+    for (size_t i = 0; i < n;) {
+        size_t run = i + 1;
+        while (run < n && work[run] == work[i]) run++;
+        int count = (int)(run - i);
+        if (count >= MATCH_MIN_SCORE && (found < k || count > out[found - 1].score)) {
+            int j = found < k ? found++ : k - 1;
+            while (j > 0 && out[j - 1].score < count) {
+                out[j] = out[j - 1];
+                j--;
+            }
+            out[j].song_id = vote_song(work[i]);
+            out[j].score = count;
+            out[j].offset = vote_delta(work[i]);
+        }
+        i = run;
+    }
+    return found;
+}
+
+// ===========================
+// Driver
+// ===========================
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static uint64_t rng_state = 0x2545F4914F6CDD1DULL;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 16);
+}
+
+// Random chance hits plus one planted true match.
+static void fill_votes(const Scenario* sc, uint64_t* votes, int* planted_song, int* planted_delta) {
+    *planted_song = 1 + (int)(rng_next() % sc->songs);
+    *planted_delta = (int)(rng_next() % (2 * sc->max_delta + 1)) - sc->max_delta;
+
+    for (size_t i = 0; i < sc->votes; i++) {
+        if (i % (sc->votes / PLANTED_VOTES) == 0) {
+            votes[i] = vote_pack(*planted_song, *planted_delta);
+        } else {
+            int song = 1 + (int)(rng_next() % sc->songs);
+            int delta = (int)(rng_next() % (2 * sc->max_delta + 1)) - sc->max_delta;
+            votes[i] = vote_pack(song, delta);
+        }
+    }
+}
+
+typedef enum { METHOD_MAP, METHOD_QSORT, METHOD_RADIX, METHOD_AUTO } Method;
+#define NUM_METHODS (METHOD_AUTO + 1)
+static const char* method_names[] = { "hash map", "qsort", "radix", "auto (dense/radix)" };
+
+int main(void) {
+    VoteScorer* scorer = vote_scorer_create();
+    if (!scorer) return 1;
+
+    printf("%-30s %-20s %10s %12s  %s\n", "scenario", "method", "ms/query", "Mvotes/s", "top result");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const Scenario* sc = &scenarios[s];
+        uint64_t* votes = (uint64_t*)malloc(sc->votes * sizeof(uint64_t));
+        uint64_t* work = (uint64_t*)malloc(sc->votes * sizeof(uint64_t));
+        if (!votes || !work) {
+            fprintf(stderr, "Out of memory for scenario '%s'.\n", sc->name);
+            return 1;
+        }
+
+        int planted_song, planted_delta;
+        fill_votes(sc, votes, &planted_song, &planted_delta);
+
+        // Methods take turns within each repeat so drift hits them all alike
+        double best[NUM_METHODS];
+        int correct[NUM_METHODS];
+        for (int method = 0; method < NUM_METHODS; method++) best[method] = 1e30;
+        for (int r = 0; r < REPEATS; r++) {
+            for (int method = 0; method < NUM_METHODS; method++) {
+                MatchResult results[TOP_K];
+                int found = 0;
+                double start = now_ms();
+                switch ((Method)method) {
+                case METHOD_MAP:   found = score_hash_map(votes, sc->votes, results, TOP_K); break;
+                case METHOD_QSORT: found = score_qsort(work, votes, sc->votes, results, TOP_K); break;
+                case METHOD_RADIX: found = vote_scorer_score(scorer, votes, sc->votes, VOTE_SCORE_RADIX,
+                                                             MATCH_MIN_SCORE, results, TOP_K); break;
+                case METHOD_AUTO:  found = vote_scorer_score(scorer, votes, sc->votes, VOTE_SCORE_AUTO,
+                                                             MATCH_MIN_SCORE, results, TOP_K); break;
+                }
+                double elapsed = now_ms() - start;
+                if (elapsed < best[method]) best[method] = elapsed;
+                correct[method] = found > 0 && results[0].song_id == planted_song &&
+                                  results[0].offset == planted_delta;
+            }
+        }
+
+        for (int method = 0; method < NUM_METHODS; method++)
+            printf("%-30s %-20s %10.2f %12.1f  %s\n", sc->name, method_names[method], best[method],
+                   sc->votes / (best[method] * 1000.0), correct[method] ? "ok" : "WRONG");
+
+        free(votes);
+        free(work);
+    }
+
+    vote_scorer_free(scorer);
+    return 0;
+}
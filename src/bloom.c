@@ -0,0 +1,359 @@
+// File: src/bloom.c
+// Cache-line blocked Bloom filter for skipping lookups of absent hashes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "hashing.h"
+#include "bloom.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define BLOOM_MAGIC         "AFPBLM02"
+#define BLOCK_WORDS         8           // 8 x 64 bits = one cache line
+#define BLOCK_BYTES         (BLOCK_WORDS * sizeof(uint64_t))
+#define MAX_BLOCKS          (1ULL << 32)
+#define MAX_PATH_LEN        1024
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+// Odd multipliers that pick one bit per word from the low 32 hash bits
+static const uint32_t block_salt[BLOCK_WORDS] = {
+    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+    0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u,
+};
+
+struct BloomFilter {
+    const uint64_t* blocks;     // num_blocks * BLOCK_WORDS words
+    uint64_t* owned;            // Same as blocks when allocated here, else NULL
+    void* owned_mem;            // Unaligned allocation behind `owned`
+    uint64_t num_blocks;
+    int64_t generation;         // Catalog generation it was built at, -1 if unknown
+};
+
+typedef struct {
+    char magic[8];
+    uint64_t num_blocks;
+    int64_t generation;
+} BloomFileHeader;
+
+static inline uint64_t block_of(const BloomFilter* filter, uint64_t mixed) {
+    return ((mixed >> 32) * filter->num_blocks) >> 32;
+}
+
+uint64_t bloom_blocks_for_keys(uint64_t num_keys) {
+    uint64_t bits = num_keys * BLOOM_BITS_PER_KEY;
+    uint64_t blocks = (bits + BLOCK_BYTES * 8 - 1) / (BLOCK_BYTES * 8);
+    if (blocks == 0) blocks = 1;
+    if (blocks > MAX_BLOCKS) blocks = MAX_BLOCKS;
+    return blocks;
+}
+
+static BloomFilter* alloc_filter(uint64_t num_blocks) {
+    BloomFilter* filter = (BloomFilter*)calloc(1, sizeof(BloomFilter));
+    if (!filter) return NULL;
+
+    filter->owned_mem = calloc(num_blocks * BLOCK_BYTES + BLOCK_BYTES, 1);
+    if (!filter->owned_mem) {
+        free(filter);
+        return NULL;
+    }
+    uintptr_t p = ((uintptr_t)filter->owned_mem + BLOCK_BYTES - 1) & ~(uintptr_t)(BLOCK_BYTES - 1);
+    filter->owned = (uint64_t*)p;
+    filter->blocks = filter->owned;
+    filter->num_blocks = num_blocks;
+    filter->generation = -1;
+    return filter;
+}
+
+BloomFilter* bloom_create(uint64_t num_keys) {
+    return alloc_filter(bloom_blocks_for_keys(num_keys));
+}
+
+BloomFilter* bloom_wrap(const void* blocks, uint64_t num_blocks) {
+    if (!blocks || num_blocks == 0 || num_blocks > MAX_BLOCKS) return NULL;
+
+    BloomFilter* filter = (BloomFilter*)calloc(1, sizeof(BloomFilter));
+    if (!filter) return NULL;
+    filter->blocks = (const uint64_t*)blocks;
+    filter->num_blocks = num_blocks;
+    filter->generation = -1;
+    return filter;
+}
+
+void bloom_free(BloomFilter* filter) {
+    if (!filter) return;
+    free(filter->owned_mem);
+    free(filter);
+}
+
+void bloom_add(BloomFilter* filter, uint64_t hash) {
+    if (!filter->owned) return;  // Wrapped filters are read-only
+
+    uint64_t mixed = mix_hash64(hash);
+    uint64_t* block = filter->owned + block_of(filter, mixed) * BLOCK_WORDS;
+    uint32_t key = (uint32_t)mixed;
+    for (int i = 0; i < BLOCK_WORDS; i++)
+        block[i] |= 1ULL << ((key * block_salt[i]) >> 26);
+}
+
+int bloom_may_contain(const BloomFilter* filter, uint64_t hash) {
+    uint64_t mixed = mix_hash64(hash);
+    const uint64_t* block = filter->blocks + block_of(filter, mixed) * BLOCK_WORDS;
+    uint32_t key = (uint32_t)mixed;
+
+    uint64_t missing = 0;
+    for (int i = 0; i < BLOCK_WORDS; i++)
+        missing |= ~block[i] & (1ULL << ((key * block_salt[i]) >> 26));
+    return missing == 0;
+}
+
+void bloom_prefetch(const BloomFilter* filter, uint64_t hash) {
+    PREFETCH(filter->blocks + block_of(filter, mix_hash64(hash)) * BLOCK_WORDS);
+}
+
+int64_t bloom_generation(const BloomFilter* filter) {
+    return filter->generation;
+}
+
+uint64_t bloom_num_blocks(const BloomFilter* filter) {
+    return filter->num_blocks;
+}
+
+const void* bloom_blocks(const BloomFilter* filter) {
+    return filter->blocks;
+}
+
+size_t bloom_size_bytes(const BloomFilter* filter) {
+    return (size_t)(filter->num_blocks * BLOCK_BYTES);
+}
+
+// ===========================
+// Persistence
+// ===========================
+
+// Push the file's contents to stable storage.
+static int sync_file(FILE* f) {
+    if (fflush(f) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0 ? 0 : -1;
+#else
+    return fsync(fileno(f)) == 0 ? 0 : -1;
+#endif
+}
+
+// Make a rename into the directory holding `path` durable. No-op on Windows.
+static int sync_parent_dir(const char* path) {
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) return -1;
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd < 0) return -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+// Written to <path>.tmp and renamed over `path`, so a crash or write error
+// never leaves a torn filter (which would hide present hashes) in its place.
+int bloom_save(const BloomFilter* filter, const char* path) {
+    char tmp_path[MAX_PATH_LEN];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        fprintf(stderr, "Filter path too long: %s\n", path);
+        return -1;
+    }
+
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error creating filter file: %s\n", tmp_path);
+        return -1;
+    }
+
+    BloomFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BLOOM_MAGIC, sizeof(header.magic));
+    header.num_blocks = filter->num_blocks;
+    header.generation = filter->generation;
+
+    int rc = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(filter->blocks, BLOCK_BYTES, filter->num_blocks, f) == filter->num_blocks ? 0 : -1;
+    if (rc == 0) rc = sync_file(f);
+    if (fclose(f) != 0) rc = -1;
+    if (rc != 0) {
+        fprintf(stderr, "Error writing filter file: %s\n", tmp_path);
+        remove(tmp_path);
+        return -1;
+    }
+
+#ifdef _WIN32
+    remove(path);  // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp_path, path) != 0 || sync_parent_dir(path) != 0) {
+        fprintf(stderr, "Error installing filter file: %s\n", path);
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int bloom_file_generation(const char* path, int64_t* generation) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    BloomFileHeader header;
+    int ok = fread(&header, sizeof(header), 1, f) == 1 &&
+             memcmp(header.magic, BLOOM_MAGIC, sizeof(header.magic)) == 0;
+    fclose(f);
+    if (!ok) return -1;
+    *generation = header.generation;
+    return 0;
+}
+
+BloomFilter* bloom_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    BloomFileHeader header;
+    BloomFilter* filter = NULL;
+    if (fread(&header, sizeof(header), 1, f) == 1 &&
+        memcmp(header.magic, BLOOM_MAGIC, sizeof(header.magic)) == 0 &&
+        header.num_blocks > 0 && header.num_blocks <= MAX_BLOCKS) {
+        filter = alloc_filter(header.num_blocks);
+        if (filter && fread(filter->owned, BLOCK_BYTES, header.num_blocks, f) != header.num_blocks) {
+            bloom_free(filter);
+            filter = NULL;
+        }
+        if (filter) filter->generation = header.generation;
+    }
+    fclose(f);
+
+    if (!filter) fprintf(stderr, "Invalid or truncated filter file: %s\n", path);
+    return filter;
+}
+
+// ===========================
+// Building from the database
+// ===========================
+
+// Smallest Fingerprints row on a page: record header, an 8-byte hash, two
+// one-byte ints and the cell pointer. Catalog bytes / this bounds the rows.
+#define MIN_ROW_BYTES       12
+#define FOLD_UNIT           1024        // Blocks; the oversized filter is a multiple of this
+
+typedef struct {
+    BloomFilter* filter;
+    uint64_t distinct;
+    int has_last;
+    uint64_t last;
+} BuildState;
+
+// The scan is hash-ordered, so distinct hashes are counted by comparing neighbours.
+static int add_scanned(uint64_t hash, int song_id, int time_offset, void* user) {
+    BuildState* st = (BuildState*)user;
+    (void)song_id;
+    (void)time_offset;
+    if (st->has_last && hash == st->last) return 0;
+    st->distinct++;
+    st->has_last = 1;
+    st->last = hash;
+    bloom_add(st->filter, hash);
+    return 0;
+}
+
+// A key's block is floor(x * num_blocks / 2^32) and its bits within the block do
+// not depend on num_blocks, so OR-ing each run of `factor` adjacent blocks gives
+// exactly the filter that num_blocks / factor blocks would have been built as.
+static BloomFilter* fold_filter(BloomFilter* big, uint64_t factor) {
+    BloomFilter* filter = alloc_filter(big->num_blocks / factor);
+    if (!filter) return NULL;
+    for (uint64_t b = 0; b < filter->num_blocks; b++) {
+        uint64_t* dst = filter->owned + b * BLOCK_WORDS;
+        const uint64_t* src = big->blocks + b * factor * BLOCK_WORDS;
+        for (uint64_t w = 0; w < factor * BLOCK_WORDS; w++)
+            dst[w % BLOCK_WORDS] |= src[w];
+    }
+    return filter;
+}
+
+BloomFilter* bloom_build_from_db(db_ctx* ctx) {
+    BuildState st;
+    memset(&st, 0, sizeof(st));
+
+    // Read first: rows committed during the scan only make the stamp older, never newer
+    int64_t generation;
+    if (db_get_generation(ctx, &generation) != 0) {
+        fprintf(stderr, "Failed to read catalog generation for filter.\n");
+        return NULL;
+    }
+
+    // One pass: size for the most rows the catalog file could hold, fill while
+    // counting distinct hashes, then fold down to the size they need
+    int64_t bytes;
+    if (db_size_bytes(ctx, &bytes) != 0) return NULL;
+    uint64_t blocks = bloom_blocks_for_keys((uint64_t)bytes / MIN_ROW_BYTES);
+    blocks = (blocks + FOLD_UNIT - 1) / FOLD_UNIT * FOLD_UNIT;
+    if (blocks > MAX_BLOCKS) blocks = MAX_BLOCKS;
+
+    st.filter = alloc_filter(blocks);
+    if (!st.filter) {
+        fprintf(stderr, "Memory allocation failed for filter.\n");
+        return NULL;
+    }
+
+    if (db_scan_fingerprints(ctx, add_scanned, &st) != 0) {
+        fprintf(stderr, "Failed to scan fingerprints for filter.\n");
+        bloom_free(st.filter);
+        return NULL;
+    }
+
+    // Largest exact divisor that leaves enough blocks. `blocks` is a multiple of
+    // FOLD_UNIT, so a power of two always qualifies: the result is under 2x needed.
+    uint64_t needed = bloom_blocks_for_keys(st.distinct);
+    uint64_t factor = blocks / needed;
+    while (factor > 1 && blocks % factor != 0)
+        factor--;
+    if (factor > 1) {
+        BloomFilter* folded = fold_filter(st.filter, factor);
+        bloom_free(st.filter);
+        if (!folded) {
+            fprintf(stderr, "Memory allocation failed for filter.\n");
+            return NULL;
+        }
+        st.filter = folded;
+    }
+
+    st.filter->generation = generation;
+    printf("Built filter: %llu hashes, %.1f MiB.\n", (unsigned long long)st.distinct,
+           bloom_size_bytes(st.filter) / (1024.0 * 1024.0));
+    return st.filter;
+}
+
+BloomFilter* bloom_load_current(const char* path, db_ctx* ctx) {
+    BloomFilter* filter = bloom_load(path);
+    if (!filter) return NULL;
+
+    int64_t generation;
+    if (db_get_generation(ctx, &generation) != 0 || generation != filter->generation) {
+        fprintf(stderr, "Ignoring stale filter %s (catalog changed since it was built); "
+                        "rebuild it with song_entry --filter.\n", path);
+        bloom_free(filter);
+        return NULL;
+    }
+    return filter;
+}
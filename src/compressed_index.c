@@ -0,0 +1,319 @@
+// File: src/compressed_index.c
+// In-memory fingerprint index over delta/bit-packed posting lists.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "posting_codec.h"
+#include "compressed_index.h"
+#include "bloom.h"
+
+#define DIRECTORY_BITS 16
+#define DIRECTORY_SIZE ((1u << DIRECTORY_BITS) + 1)
+#define KEY_BLOCK_SIZE 32       // Hashes per restart point in the key stream
+
+// The unique hashes are a key stream cut into blocks of KEY_BLOCK_SIZE. Each
+// entry is a varint gap from the previous hash (omitted for a block's first
+// hash, which is stored in block_hashes) and the varint size of its encoded
+// list, so a hash costs a few bytes instead of a 16-byte hash/offset pair.
+struct CompressedIndex {
+    uint8_t* keys;
+    uint64_t keys_size;
+    uint64_t* block_hashes;     // First hash of each block, ascending
+    uint64_t* block_keys;       // Start of each block in keys
+    uint64_t* block_blobs;      // Start of each block's first list in blob
+    uint64_t num_blocks;
+    uint32_t* directory;        // First block that may hold each 16-bit prefix
+    uint8_t* blob;
+    uint64_t blob_size;
+    uint64_t num_hashes;
+    uint64_t num_postings;
+    size_t max_list_len;
+    BloomFilter* filter;        // Skips the directory search for absent hashes
+};
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t get_varint(const uint8_t* in, uint64_t* v) {
+    uint64_t result = 0;
+    size_t n = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = in[n++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    *v = result;
+    return n;
+}
+
+// Walks the key stream in hash order.
+typedef struct {
+    const CompressedIndex* index;
+    uint64_t block;
+    uint64_t pos;               // Read position in keys
+    uint64_t left;              // Entries left in the current block
+    uint64_t hash;
+    uint64_t blob_offset;       // Current entry's list
+    uint64_t next_blob;         // Entry after it
+} KeyCursor;
+
+static void cursor_seek(KeyCursor* c, const CompressedIndex* index, uint64_t block) {
+    c->index = index;
+    c->block = block;
+    c->pos = index->block_keys[block];
+    c->left = block + 1 < index->num_blocks ? KEY_BLOCK_SIZE
+                                            : index->num_hashes - block * KEY_BLOCK_SIZE;
+    c->next_blob = index->block_blobs[block];
+}
+
+// Advance to the next entry of the current block. Returns 0 past its end.
+static int cursor_next(KeyCursor* c) {
+    if (c->left == 0) return 0;
+    const CompressedIndex* index = c->index;
+    uint64_t gap, size;
+    if (c->pos == index->block_keys[c->block]) {
+        c->hash = index->block_hashes[c->block];
+    } else {
+        c->pos += get_varint(index->keys + c->pos, &gap);
+        c->hash += gap;
+    }
+    c->pos += get_varint(index->keys + c->pos, &size);
+    c->blob_offset = c->next_blob;
+    c->next_blob += size;
+    c->left--;
+    return 1;
+}
+
+// Buffers the current hash's postings and appends them encoded to the blob.
+typedef struct {
+    CompressedIndex* index;
+    uint64_t block_capacity;
+    uint64_t keys_capacity;
+    uint64_t blob_capacity;
+    uint64_t prev_hash;
+    Posting* pending;
+    size_t num_pending;
+    size_t pending_capacity;
+    uint64_t pending_hash;
+} LoadState;
+
+static int flush_pending(LoadState* st) {
+    if (st->num_pending == 0) return 0;
+    CompressedIndex* index = st->index;
+    int new_block = index->num_hashes % KEY_BLOCK_SIZE == 0;
+
+    if (new_block && index->num_blocks == st->block_capacity) {
+        uint64_t capacity = st->block_capacity ? st->block_capacity * 2 : 1 << 10;
+        uint64_t* hashes = realloc(index->block_hashes, capacity * sizeof(uint64_t));
+        if (!hashes) return -1;
+        index->block_hashes = hashes;
+        uint64_t* keys = realloc(index->block_keys, capacity * sizeof(uint64_t));
+        if (!keys) return -1;
+        index->block_keys = keys;
+        uint64_t* blobs = realloc(index->block_blobs, capacity * sizeof(uint64_t));
+        if (!blobs) return -1;
+        index->block_blobs = blobs;
+        st->block_capacity = capacity;
+    }
+
+    // Two 10-byte varints at most
+    if (index->keys_size + 20 > st->keys_capacity) {
+        uint64_t capacity = st->keys_capacity ? st->keys_capacity * 2 : 1 << 16;
+        uint8_t* keys = realloc(index->keys, capacity);
+        if (!keys) return -1;
+        index->keys = keys;
+        st->keys_capacity = capacity;
+    }
+
+    size_t needed = posting_codec_max_encoded_size(st->num_pending);
+    if (index->blob_size + needed > st->blob_capacity) {
+        uint64_t capacity = st->blob_capacity ? st->blob_capacity : 1 << 20;
+        while (index->blob_size + needed > capacity) capacity *= 2;
+        uint8_t* blob = realloc(index->blob, capacity);
+        if (!blob) return -1;
+        index->blob = blob;
+        st->blob_capacity = capacity;
+    }
+
+    if (new_block) {
+        index->block_hashes[index->num_blocks] = st->pending_hash;
+        index->block_keys[index->num_blocks] = index->keys_size;
+        index->block_blobs[index->num_blocks] = index->blob_size;
+        index->num_blocks++;
+    } else {
+        index->keys_size += put_varint(index->keys + index->keys_size, st->pending_hash - st->prev_hash);
+    }
+    size_t size = posting_codec_encode(st->pending, st->num_pending, index->blob + index->blob_size);
+    index->keys_size += put_varint(index->keys + index->keys_size, size);
+    index->blob_size += size;
+    index->num_hashes++;
+    index->num_postings += st->num_pending;
+    if (st->num_pending > index->max_list_len) index->max_list_len = st->num_pending;
+
+    st->prev_hash = st->pending_hash;
+    st->num_pending = 0;
+    return 0;
+}
+
+static int load_record(uint64_t hash, int song_id, int time_offset, void* user) {
+    LoadState* st = (LoadState*)user;
+
+    if (st->num_pending > 0 && hash != st->pending_hash && flush_pending(st) != 0)
+        return -1;
+
+    if (st->num_pending == st->pending_capacity) {
+        size_t capacity = st->pending_capacity ? st->pending_capacity * 2 : 1024;
+        Posting* pending = realloc(st->pending, capacity * sizeof(Posting));
+        if (!pending) return -1;
+        st->pending = pending;
+        st->pending_capacity = capacity;
+    }
+
+    st->pending_hash = hash;
+    st->pending[st->num_pending++] = (Posting){ song_id, time_offset };
+    return 0;
+}
+
+// Shrink a growth buffer to `size` bytes; keeps the original on failure.
+static void* trim(void* p, size_t size) {
+    if (!p || size == 0) return p;
+    void* q = realloc(p, size);
+    return q ? q : p;
+}
+
+CompressedIndex* compressed_index_load_from_db(db_ctx* ctx) {
+    CompressedIndex* index = (CompressedIndex*)calloc(1, sizeof(CompressedIndex));
+    if (!index) return NULL;
+
+    LoadState st;
+    memset(&st, 0, sizeof(st));
+    st.index = index;
+
+    if (db_scan_fingerprints(ctx, load_record, &st) != 0 || flush_pending(&st) != 0) {
+        fprintf(stderr, "Failed to load fingerprints into compressed index.\n");
+        free(st.pending);
+        compressed_index_free(index);
+        return NULL;
+    }
+    free(st.pending);
+
+    // Release the growth slack
+    index->keys = trim(index->keys, index->keys_size);
+    index->blob = trim(index->blob, index->blob_size);
+    index->block_hashes = trim(index->block_hashes, index->num_blocks * sizeof(uint64_t));
+    index->block_keys = trim(index->block_keys, index->num_blocks * sizeof(uint64_t));
+    index->block_blobs = trim(index->block_blobs, index->num_blocks * sizeof(uint64_t));
+
+    index->directory = (uint32_t*)malloc(DIRECTORY_SIZE * sizeof(uint32_t));
+    index->filter = bloom_create(index->num_hashes);
+    if (!index->directory || !index->filter) {
+        fprintf(stderr, "Memory allocation failed for compressed index.\n");
+        compressed_index_free(index);
+        return NULL;
+    }
+
+    // Block holding the first hash of each prefix; a prefix's hashes lie in
+    // blocks directory[p] .. directory[p + 1]
+    uint64_t p = 0;
+    for (uint64_t b = 0; b < index->num_blocks; b++) {
+        KeyCursor c;
+        cursor_seek(&c, index, b);
+        while (cursor_next(&c)) {
+            bloom_add(index->filter, c.hash);
+            for (uint64_t prefix = c.hash >> (64 - DIRECTORY_BITS); p <= prefix; p++)
+                index->directory[p] = (uint32_t)b;
+        }
+    }
+    for (; p < DIRECTORY_SIZE; p++)
+        index->directory[p] = (uint32_t)(index->num_blocks ? index->num_blocks - 1 : 0);
+
+    size_t total = compressed_index_memory_usage(index);
+    printf("Compressed index loaded: %llu hashes, %llu postings, %.1f MiB resident "
+           "(%.2f bytes/posting lists, %.2f bytes/hash keys and directory).\n",
+           (unsigned long long)index->num_hashes, (unsigned long long)index->num_postings,
+           total / (1024.0 * 1024.0),
+           index->num_postings ? (double)index->blob_size / index->num_postings : 0.0,
+           index->num_hashes ? (double)(total - index->blob_size) / index->num_hashes : 0.0);
+    return index;
+}
+
+void compressed_index_free(CompressedIndex* index) {
+    if (!index) return;
+    free(index->keys);
+    free(index->block_hashes);
+    free(index->block_keys);
+    free(index->block_blobs);
+    free(index->directory);
+    free(index->blob);
+    bloom_free(index->filter);
+    free(index);
+}
+
+// Start of the encoded list of `hash` in the blob, or -1.
+static int64_t find_hash(const CompressedIndex* index, uint64_t hash) {
+    if (index->num_blocks == 0 || !bloom_may_contain(index->filter, hash))
+        return -1;
+
+    // Last block starting at or before `hash`
+    uint64_t prefix = hash >> (64 - DIRECTORY_BITS);
+    uint64_t lo = index->directory[prefix];
+    uint64_t hi = (uint64_t)index->directory[prefix + 1] + 1;
+    if (index->block_hashes[lo] > hash) return -1;
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (index->block_hashes[mid] <= hash) lo = mid;
+        else hi = mid;
+    }
+
+    KeyCursor c;
+    cursor_seek(&c, index, lo);
+    while (cursor_next(&c)) {
+        if (c.hash == hash) return (int64_t)c.blob_offset;
+        if (c.hash > hash) break;
+    }
+    return -1;
+}
+
+size_t compressed_index_lookup(const CompressedIndex* index, uint64_t hash, Posting* out) {
+    int64_t offset = find_hash(index, hash);
+    if (offset < 0) return 0;
+    return posting_codec_decode(index->blob + offset, out, NULL);
+}
+
+size_t compressed_index_count(const CompressedIndex* index, uint64_t hash) {
+    int64_t offset = find_hash(index, hash);
+    if (offset < 0) return 0;
+    return posting_codec_count(index->blob + offset);
+}
+
+size_t compressed_index_max_list_len(const CompressedIndex* index) {
+    return index->max_list_len;
+}
+
+uint64_t compressed_index_num_hashes(const CompressedIndex* index) {
+    return index->num_hashes;
+}
+
+uint64_t compressed_index_num_postings(const CompressedIndex* index) {
+    return index->num_postings;
+}
+
+size_t compressed_index_memory_usage(const CompressedIndex* index) {
+    return sizeof(CompressedIndex) +
+           (size_t)index->keys_size +
+           (size_t)index->num_blocks * sizeof(uint64_t) * 3 +
+           DIRECTORY_SIZE * sizeof(uint32_t) +
+           (size_t)index->blob_size +
+           bloom_size_bytes(index->filter);
+}
@@ -2,76 +2,306 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #include "sqlite3.h"
+#include "config.h"
 #include "db.h"
+#include "bloom.h"
 
-static sqlite3* db = NULL;  // Global database connection
+// Prepared statements cached per context, compiled on first use
+typedef enum {
+    STMT_FIND_SONG,
+    STMT_INSERT_SONG,
+    STMT_INSERT_FINGERPRINT,
+    STMT_INSERT_STAGING,
+    STMT_LOOKUP_HASH,
+    STMT_GET_META,
+    STMT_SET_META,
+    STMT_GET_SONG,
+    STMT_INSERT_PEAKS,
+    STMT_LOAD_PEAKS,
+    STMT_HAS_PEAKS,
+    STMT_SET_SKETCH,
+    STMT_MAX_SONG_ID,
+    STMT_BUMP_GENERATION,
+    STMT_COUNT_HASH,
+    STMT_COUNT
+} DbStmtId;
+
+static const char* stmt_sql[STMT_COUNT] = {
+    "SELECT id FROM Songs WHERE name = ? AND artist = ?;",
+    "INSERT INTO Songs (id, name, artist) VALUES (?, ?, ?);",
+    "INSERT OR IGNORE INTO Fingerprints (hash, song_id, time_offset) VALUES (?, ?, ?);",
+    "INSERT INTO Fingerprints_staging (hash, song_id, time_offset) VALUES (?, ?, ?);",
+    "SELECT song_id, time_offset FROM Fingerprints WHERE hash = ?;",
+    "SELECT value FROM Meta WHERE key = ?;",
+    "INSERT OR REPLACE INTO Meta (key, value) VALUES (?, ?);",
+    "SELECT name, artist FROM Songs WHERE id = ?;",
+    "INSERT OR REPLACE INTO SongPeaks (song_id, block, peaks) VALUES (?, ?, ?);",
+    "SELECT block, peaks FROM SongPeaks WHERE song_id = ? AND block BETWEEN ? AND ? ORDER BY block;",
+    "SELECT 1 FROM SongPeaks WHERE song_id = ? LIMIT 1;",
+    "UPDATE Songs SET sketch = ? WHERE id = ?;",
+    "SELECT COALESCE(MAX(id), 0) FROM Songs;",
+    "INSERT INTO Meta (key, value) VALUES ('index_generation', 1) "
+    "ON CONFLICT(key) DO UPDATE SET value = value + 1;",
+    "SELECT COUNT(*) FROM (SELECT 1 FROM Fingerprints WHERE hash = ? LIMIT ?);",
+};
+
+struct db_ctx {
+    sqlite3* conn;
+    int flags;
+    int bulk_mode;                      // Non-zero between begin/finalize bulk load
+    int64_t saved_cache_size;           // Pragmas in effect before bulk load, restored after
+    int64_t saved_mmap_size;
+    int64_t saved_temp_store;
+    sqlite3_stmt* stmts[STMT_COUNT];
+    const BloomFilter* filter;          // Optional; rules out absent hashes before querying
+    struct PoolFilter* pool_filter;     // Reference taken on pool acquire
+};
+
+// A filter shared by the pool's contexts. It is freed with the last
+// reference, so a reload never pulls it from under a running lookup.
+typedef struct PoolFilter {
+    const BloomFilter* filter;
+    BloomFilter* owned;                 // Loaded by the pool; NULL if the caller owns it
+    int refs;                           // Pool + acquired contexts (guarded by db_pool.lock)
+} PoolFilter;
+
+struct db_pool {
+    db_ctx** conns;
+    int size;
+    int free_count;                     // conns[0..free_count) are idle
+    PoolFilter* filter;                 // Attached to each context on acquire
+    char* filter_path;                  // Reloaded from here when the catalog moves on
+    int filter_loading;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+};
 
 static int db_file_exists(const char* path) {
     struct stat buffer;
     return (stat(path, &buffer) == 0);
 }
 
-int db_open(const char* path) {
-    if (db_file_exists(path)) {
-        printf("Opening existing database: %s\n", path);
-    } else {
-        printf("Creating new database: %s\n", path);
+// Returns the cached statement, reset and unbound, or NULL on prepare failure.
+static sqlite3_stmt* db_stmt(db_ctx* ctx, DbStmtId id) {
+    sqlite3_stmt* stmt = ctx->stmts[id];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return stmt;
     }
 
-    int rc = sqlite3_open(path, &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to open DB: %s\n", sqlite3_errmsg(db));
+    if (sqlite3_prepare_v3(ctx->conn, stmt_sql[id], -1, SQLITE_PREPARE_PERSISTENT,
+                           &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(ctx->conn));
+        return NULL;
+    }
+    ctx->stmts[id] = stmt;
+    return stmt;
+}
+
+// Drop cached statements, e.g. before the schema they reference changes.
+static void db_clear_stmts(db_ctx* ctx) {
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (ctx->stmts[i]) {
+            sqlite3_finalize(ctx->stmts[i]);
+            ctx->stmts[i] = NULL;
+        }
+    }
+}
+
+// Returns 1 if Fingerprints still uses the legacy TEXT hash schema, 0 if not, -1 on error.
+static int db_has_legacy_fingerprints(db_ctx* ctx) {
+    sqlite3_stmt* stmt;
+    const char* sql = "PRAGMA table_info(Fingerprints);";
+
+    if (sqlite3_prepare_v2(ctx->conn, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    int legacy = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        const char* type = (const char*)sqlite3_column_text(stmt, 2);
+        if (name && type && strcmp(name, "hash") == 0 && strcmp(type, "TEXT") == 0) {
+            legacy = 1;
+            break;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return legacy;
+}
+
+// Catalogs from before INTEGER hashes were fingerprinted with another hash layout;
+// their hashes cannot be converted, only recomputed from the audio.
+static int db_refuse_legacy(db_ctx* ctx) {
+    int legacy = db_has_legacy_fingerprints(ctx);
+    if (legacy < 0) {
+        fprintf(stderr, "Error inspecting Fingerprints table: %s\n", sqlite3_errmsg(ctx->conn));
         return -1;
     }
+    if (legacy == 1) {
+        fprintf(stderr, "This catalog stores fingerprints in the old TEXT hash format, which this version\n"
+                        "cannot match against. Move the database aside and re-ingest the songs.\n");
+        return -1;
+    }
+    return 0;
+}
+
+db_ctx* db_open_ctx(const char* path, int flags) {
+    int readonly = (flags & DB_CTX_READONLY) != 0;
+
+    if (!readonly) {
+        if (db_file_exists(path)) {
+            printf("Opening existing database: %s\n", path);
+        } else {
+            printf("Creating new database: %s\n", path);
+        }
+    }
+
+    db_ctx* ctx = (db_ctx*)calloc(1, sizeof(db_ctx));
+    if (!ctx) return NULL;
+    ctx->flags = flags;
+
+    // Each context is used by one thread at a time, so SQLite's own mutexes are redundant
+    int open_flags = SQLITE_OPEN_NOMUTEX |
+                     (readonly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+
+    int rc = sqlite3_open_v2(path, &ctx->conn, open_flags, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to open DB: %s\n", sqlite3_errmsg(ctx->conn));
+        sqlite3_close(ctx->conn);
+        free(ctx);
+        return NULL;
+    }
+
+    sqlite3_busy_timeout(ctx->conn, DB_BUSY_TIMEOUT_MS);
+
+    if (readonly) {
+        char pragma_sql[64];
+        snprintf(pragma_sql, sizeof(pragma_sql), "PRAGMA mmap_size=%lld;", (long long)DB_READ_MMAP_SIZE);
+        sqlite3_exec(ctx->conn, pragma_sql, 0, 0, NULL);
+        if (db_refuse_legacy(ctx) != 0) {
+            db_close_ctx(ctx);
+            return NULL;
+        }
+        return ctx;
+    }
 
-    return db_create_tables();  // Ensure tables exist
+    // WAL lets read-only contexts query while this one ingests; FULL keeps commits durable
+    if (sqlite3_exec(ctx->conn, "PRAGMA journal_mode=WAL; PRAGMA synchronous=FULL;", 0, 0, NULL) != SQLITE_OK ||
+        db_create_tables(ctx) != 0) {  // Ensure tables exist
+        db_close_ctx(ctx);
+        return NULL;
+    }
+
+    return ctx;
 }
 
-void db_close() {
-    if (db) {
-        sqlite3_close(db);
-        db = NULL;
+void db_close_ctx(db_ctx* ctx) {
+    if (!ctx) return;
+    if (ctx->bulk_mode) {
+        fprintf(stderr, "Warning: closing DB in bulk-load mode; staged fingerprints were not finalized.\n");
     }
+    db_clear_stmts(ctx);
+    sqlite3_close(ctx->conn);
+    free(ctx);
 }
 
-int db_create_tables() {
+// Returns 1 if Songs has the sketch column, 0 if not, -1 on error.
+static int db_songs_have_sketch(db_ctx* ctx) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(ctx->conn, "PRAGMA table_info(Songs);", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    int found = 0;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        found = name && strcmp(name, "sketch") == 0;
+    }
+
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+int db_create_tables(db_ctx* ctx) {
+    // sketch: the song's SongSketch (see minhash.h), NULL for songs ingested before it existed
     const char* songs_sql =
         "CREATE TABLE IF NOT EXISTS Songs ("
         "id INTEGER PRIMARY KEY, "
         "name TEXT NOT NULL, "
         "artist TEXT NOT NULL, "
+        "sketch BLOB, "
         "UNIQUE(name, artist));";
 
+    // Small key/value table for catalog-level settings (shard layout, versions)
+    const char* meta_sql =
+        "CREATE TABLE IF NOT EXISTS Meta ("
+        "key TEXT PRIMARY KEY, "
+        "value INTEGER NOT NULL);";
+
+    // Clustered on (hash, song_id, time_offset): a lookup by hash is one range scan
+    // and the primary key doubles as the uniqueness constraint.
     const char* fingerprints_sql =
         "CREATE TABLE IF NOT EXISTS Fingerprints ("
-        "id INTEGER PRIMARY KEY, "
-        "hash TEXT NOT NULL, "
-        "time_offset INTEGER NOT NULL, "
+        "hash INTEGER NOT NULL, "
         "song_id INTEGER NOT NULL, "
-        "FOREIGN KEY(song_id) REFERENCES Songs(id), "
-        "UNIQUE(hash, time_offset, song_id)); ";
+        "time_offset INTEGER NOT NULL, "
+        "PRIMARY KEY(hash, song_id, time_offset), "
+        "FOREIGN KEY(song_id) REFERENCES Songs(id)) WITHOUT ROWID;";
+
+    // Each song's spectrogram peaks in PEAK_BLOCK_FRAMES-frame blocks, so a
+    // verifier can read just the window a match points at. Stamping the block
+    // size marks the catalog as storing peaks.
+    char peaks_sql[512];
+    snprintf(peaks_sql, sizeof(peaks_sql),
+             "CREATE TABLE IF NOT EXISTS SongPeaks ("
+             "song_id INTEGER NOT NULL, "
+             "block INTEGER NOT NULL, "
+             "peaks BLOB NOT NULL, "
+             "PRIMARY KEY(song_id, block), "
+             "FOREIGN KEY(song_id) REFERENCES Songs(id)) WITHOUT ROWID;"
+             "INSERT OR IGNORE INTO Meta (key, value) VALUES ('peak_block_frames', %d);",
+             PEAK_BLOCK_FRAMES);
 
-    const char* index_sql =
-        "CREATE INDEX IF NOT EXISTS idx_hash ON Fingerprints(hash);";
+    // Checked first, so an old catalog is left untouched
+    if (db_refuse_legacy(ctx) != 0)
+        return -1;
 
     char* err = NULL;
 
-    if (sqlite3_exec(db, songs_sql, 0, 0, &err) != SQLITE_OK) {
+    if (sqlite3_exec(ctx->conn, songs_sql, 0, 0, &err) != SQLITE_OK) {
         fprintf(stderr, "Error creating Songs table: %s\n", err);
         sqlite3_free(err);
         return -1;
     }
 
-    if (sqlite3_exec(db, fingerprints_sql, 0, 0, &err) != SQLITE_OK) {
-        fprintf(stderr, "Error creating Fingerprints table: %s\n", err);
+    // Catalogs created before song sketches get the column added in place
+    int has_sketch = db_songs_have_sketch(ctx);
+    if (has_sketch < 0 ||
+        (has_sketch == 0 && sqlite3_exec(ctx->conn, "ALTER TABLE Songs ADD COLUMN sketch BLOB;", 0, 0, &err) != SQLITE_OK)) {
+        fprintf(stderr, "Error adding Songs.sketch: %s\n", err ? err : sqlite3_errmsg(ctx->conn));
+        sqlite3_free(err);
+        return -1;
+    }
+
+    if (sqlite3_exec(ctx->conn, meta_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Error creating Meta table: %s\n", err);
         sqlite3_free(err);
         return -1;
     }
 
-    if (sqlite3_exec(db, index_sql, 0, 0, &err) != SQLITE_OK) {
-        fprintf(stderr, "Error creating index: %s\n", err);
+    if (sqlite3_exec(ctx->conn, peaks_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Error creating SongPeaks table: %s\n", err);
+        sqlite3_free(err);
+        return -1;
+    }
+
+    if (sqlite3_exec(ctx->conn, fingerprints_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Error creating Fingerprints table: %s\n", err);
         sqlite3_free(err);
         return -1;
     }
@@ -79,11 +309,9 @@ int db_create_tables() {
     return 0;
 }
 
-int db_find_song(const char* name, const char* artist, int* song_id) {
-    sqlite3_stmt* stmt;
-    const char* sql = "SELECT id FROM Songs WHERE name = ? AND artist = ?;";
-
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+int db_find_song(db_ctx* ctx, const char* name, const char* artist, int* song_id) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_FIND_SONG);
+    if (!stmt)
         return -1;
 
     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_TRANSIENT);
@@ -92,16 +320,55 @@ int db_find_song(const char* name, const char* artist, int* song_id) {
     int rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
         *song_id = sqlite3_column_int(stmt, 0);
-        sqlite3_finalize(stmt);
+        sqlite3_reset(stmt);
         return 1;
     }
 
-    sqlite3_finalize(stmt);
-    return 0;
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+int db_get_song(db_ctx* ctx, int song_id, char* name, size_t name_size, char* artist, size_t artist_size) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_GET_SONG);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_int(stmt, 1, song_id);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        const char* n = (const char*)sqlite3_column_text(stmt, 0);
+        const char* a = (const char*)sqlite3_column_text(stmt, 1);
+        snprintf(name, name_size, "%s", n ? n : "");
+        snprintf(artist, artist_size, "%s", a ? a : "");
+        sqlite3_reset(stmt);
+        return 1;
+    }
+
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+// A NULL id lets SQLite pick the next rowid.
+static int insert_song_row(db_ctx* ctx, int song_id, const char* name, const char* artist) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_INSERT_SONG);
+    if (!stmt)
+        return -1;
+
+    if (song_id > 0)
+        sqlite3_bind_int(stmt, 1, song_id);
+    else
+        sqlite3_bind_null(stmt, 1);
+    sqlite3_bind_text(stmt, 2, name, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, artist, -1, SQLITE_TRANSIENT);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
 }
 
-int db_insert_song(const char* name, const char* artist, int* song_id) {
-    int found = db_find_song(name, artist, song_id);
+int db_insert_song(db_ctx* ctx, const char* name, const char* artist, int* song_id) {
+    int found = db_find_song(ctx, name, artist, song_id);
     if (found == 1) {
         printf("Duplicate song: '%s' by '%s', ID=%d\n", name, artist, *song_id);
         return 1;
@@ -109,39 +376,775 @@ int db_insert_song(const char* name, const char* artist, int* song_id) {
         return -1;
     }
 
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT INTO Songs (name, artist) VALUES (?, ?);";
+    if (insert_song_row(ctx, 0, name, artist) != 0)
+        return -1;
+    *song_id = (int)sqlite3_last_insert_rowid(ctx->conn);
+    return 0;
+}
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+int db_insert_song_with_id(db_ctx* ctx, int song_id, const char* name, const char* artist) {
+    if (song_id <= 0) return -1;
+    return insert_song_row(ctx, song_id, name, artist);
+}
+
+int db_max_song_id(db_ctx* ctx, int* song_id) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_MAX_SONG_ID);
+    if (!stmt)
         return -1;
 
-    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, artist, -1, SQLITE_TRANSIENT);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) *song_id = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_ROW ? 0 : -1;
+}
 
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
+// Hashes are stored bit-for-bit as signed 64-bit INTEGERs.
+int db_insert_fingerprint(db_ctx* ctx, uint64_t hash, int time_offset, int song_id) {
+    sqlite3_stmt* stmt = db_stmt(ctx, ctx->bulk_mode ? STMT_INSERT_STAGING : STMT_INSERT_FINGERPRINT);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)hash);
+    sqlite3_bind_int(stmt, 2, song_id);
+    sqlite3_bind_int(stmt, 3, time_offset);
+
+    int rc = sqlite3_step(stmt);
+    int changes = sqlite3_changes(ctx->conn);  // Get number of rows actually inserted
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE) return -1;
+    return changes > 0 ? 0 : 1;  // 0 = inserted, 1 = duplicate ignored
+}
+
+int db_get_meta(db_ctx* ctx, const char* key, int64_t* value) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_GET_META);
+    if (!stmt)
         return -1;
+
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *value = sqlite3_column_int64(stmt, 0);
+        sqlite3_reset(stmt);
+        return 1;
     }
 
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+int db_set_meta(db_ctx* ctx, const char* key, int64_t value) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_SET_META);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, value);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+int db_get_generation(db_ctx* ctx, int64_t* generation) {
+    int found = db_get_meta(ctx, "index_generation", generation);
+    if (found == 0) *generation = 0;
+    return found < 0 ? -1 : 0;
+}
+
+int db_bump_generation(db_ctx* ctx) {
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_BUMP_GENERATION);
+    if (!stmt)
+        return -1;
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+// ===========================
+// Song sketches
+// ===========================
+
+#define SKETCH_BLOB_BYTES (SONG_SKETCH_BINS * 4)   // Little-endian uint32 per bin
+
+int db_set_song_sketch(db_ctx* ctx, int song_id, const SongSketch* sketch) {
+    uint8_t blob[SKETCH_BLOB_BYTES];
+    for (int b = 0; b < SONG_SKETCH_BINS; b++)
+        for (int i = 0; i < 4; i++)
+            blob[b * 4 + i] = (uint8_t)(sketch->mins[b] >> (8 * i));
+
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_SET_SKETCH);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_blob(stmt, 1, blob, sizeof(blob), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, song_id);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+int db_scan_song_sketches(db_ctx* ctx, db_sketch_cb cb, void* user) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(ctx->conn, "SELECT id, sketch FROM Songs WHERE sketch IS NOT NULL ORDER BY id;",
+                           -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Song sketch scan failed: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+
+    int rc, stopped = 0, skipped = 0;
+    while (!stopped && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const uint8_t* blob = (const uint8_t*)sqlite3_column_blob(stmt, 1);
+        if (sqlite3_column_bytes(stmt, 1) != SKETCH_BLOB_BYTES || !blob) {
+            skipped++;  // Written with another SONG_SKETCH_BINS
+            continue;
+        }
+
+        SongSketch sketch;
+        for (int b = 0; b < SONG_SKETCH_BINS; b++)
+            sketch.mins[b] = (uint32_t)blob[b * 4] | (uint32_t)blob[b * 4 + 1] << 8 |
+                             (uint32_t)blob[b * 4 + 2] << 16 | (uint32_t)blob[b * 4 + 3] << 24;
+        stopped = cb(sqlite3_column_int(stmt, 0), &sketch, user) != 0;
+    }
+
+    if (skipped > 0)
+        fprintf(stderr, "Warning: ignored %d song sketches of another size.\n", skipped);
     sqlite3_finalize(stmt);
-    *song_id = (int)sqlite3_last_insert_rowid(db);
+    if (stopped) return 1;
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+// ===========================
+// Song peaks
+// ===========================
+
+// A block's peaks, in time order, are one varint each:
+// (frames since the previous peak, or since the block start) << PEAK_FREQ_BITS | freq_bin.
+#define PEAK_FREQ_BITS 11
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static int compare_peak_time(const void* a, const void* b) {
+    const Peak* x = (const Peak*)a;
+    const Peak* y = (const Peak*)b;
+    if (x->time_index != y->time_index) return x->time_index < y->time_index ? -1 : 1;
+    if (x->freq_bin != y->freq_bin) return x->freq_bin < y->freq_bin ? -1 : 1;
+    return 0;
+}
+
+int db_insert_song_peaks(db_ctx* ctx, int song_id, Peak* peaks, int count) {
+    if (!ctx || (!peaks && count > 0) || count < 0) return -1;
+    if (count == 0) return 0;
+
+    qsort(peaks, count, sizeof(Peak), compare_peak_time);
+    uint8_t* blob = (uint8_t*)malloc((size_t)count * 10);
+    if (!blob) {
+        fprintf(stderr, "Memory allocation failed for song peaks.\n");
+        return -1;
+    }
+
+    int rc = 0;
+    for (int i = 0; i < count && rc == 0;) {
+        int block = peaks[i].time_index / PEAK_BLOCK_FRAMES;
+        int prev = block * PEAK_BLOCK_FRAMES;
+        size_t n = 0;
+        for (; i < count && peaks[i].time_index / PEAK_BLOCK_FRAMES == block; i++) {
+            if (peaks[i].freq_bin < 0 || peaks[i].freq_bin >= (1 << PEAK_FREQ_BITS)) continue;
+            uint64_t dt = (uint64_t)(peaks[i].time_index - prev);
+            n += put_varint(blob + n, dt << PEAK_FREQ_BITS | (uint64_t)peaks[i].freq_bin);
+            prev = peaks[i].time_index;
+        }
+
+        sqlite3_stmt* stmt = db_stmt(ctx, STMT_INSERT_PEAKS);
+        if (!stmt) {
+            rc = -1;
+            break;
+        }
+        sqlite3_bind_int(stmt, 1, song_id);
+        sqlite3_bind_int(stmt, 2, block);
+        sqlite3_bind_blob(stmt, 3, blob, (int)n, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "Song peaks insert failed: %s\n", sqlite3_errmsg(ctx->conn));
+            rc = -1;
+        }
+        sqlite3_reset(stmt);
+    }
+
+    free(blob);
+    return rc;
+}
+
+// Append one block's peaks within [first_frame, last_frame] to *out.
+static int decode_peak_block(const uint8_t* blob, int bytes, int block, int first_frame, int last_frame,
+                             Peak** out, int* count, int* capacity) {
+    int t = block * PEAK_BLOCK_FRAMES;
+    for (int p = 0; p < bytes;) {
+        uint64_t v = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (p >= bytes || shift > 42) return -1;  // Truncated or corrupt
+            byte = blob[p++];
+            v |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        t += (int)(v >> PEAK_FREQ_BITS);
+        if (t < first_frame) continue;
+        if (t > last_frame) break;
+
+        if (*count == *capacity) {
+            int grown_capacity = *capacity ? *capacity * 2 : 1024;
+            Peak* grown = realloc(*out, grown_capacity * sizeof(Peak));
+            if (!grown) return -1;
+            *out = grown;
+            *capacity = grown_capacity;
+        }
+        (*out)[(*count)++] = (Peak){ .time_index = t,
+                                     .freq_bin = (int)(v & ((1 << PEAK_FREQ_BITS) - 1)),
+                                     .magnitude = 0.0f };
+    }
     return 0;
 }
 
-int db_insert_fingerprint(const char* hash, int time_offset, int song_id) {
+int db_load_song_peaks(db_ctx* ctx, int song_id, int first_frame, int last_frame, Peak** out, int* count) {
+    *out = NULL;
+    *count = 0;
+    if (first_frame < 0) first_frame = 0;
+    if (last_frame < first_frame) return 1;
+
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_LOAD_PEAKS);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_int(stmt, 1, song_id);
+    sqlite3_bind_int(stmt, 2, first_frame / PEAK_BLOCK_FRAMES);
+    sqlite3_bind_int(stmt, 3, last_frame / PEAK_BLOCK_FRAMES);
+
+    int capacity = 0;
+    int rc;
+    int failed = 0;
+    int rows = 0;
+    while (!failed && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        rows++;
+        int block = sqlite3_column_int(stmt, 0);
+        const uint8_t* blob = (const uint8_t*)sqlite3_column_blob(stmt, 1);
+        int bytes = sqlite3_column_bytes(stmt, 1);
+        failed = decode_peak_block(blob, bytes, block, first_frame, last_frame, out, count, &capacity) != 0;
+    }
+    sqlite3_reset(stmt);
+
+    if (failed || rc != SQLITE_DONE) {
+        if (failed) fprintf(stderr, "Corrupt or oversized peak block for song %d.\n", song_id);
+        free(*out);
+        *out = NULL;
+        *count = 0;
+        return -1;
+    }
+    if (rows > 0) return 1;
+
+    // Nothing in the window: either the song ends before it or it has no peaks stored
+    stmt = db_stmt(ctx, STMT_HAS_PEAKS);
+    if (!stmt)
+        return -1;
+    sqlite3_bind_int(stmt, 1, song_id);
+    rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc == SQLITE_ROW) return 1;
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+void db_set_filter(db_ctx* ctx, const BloomFilter* filter) {
+    ctx->filter = filter;
+}
+
+int db_lookup_hash(db_ctx* ctx, uint64_t hash, Posting* out, int max_out) {
+    if (ctx->filter && !bloom_may_contain(ctx->filter, hash))
+        return 0;
+
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_LOOKUP_HASH);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)hash);
+
+    int n = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (n < max_out) {
+            out[n].song_id = sqlite3_column_int(stmt, 0);
+            out[n].time_offset = sqlite3_column_int(stmt, 1);
+        }
+        n++;
+    }
+
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? n : -1;
+}
+
+int db_count_hash(db_ctx* ctx, uint64_t hash, int cap) {
+    if (ctx->filter && !bloom_may_contain(ctx->filter, hash))
+        return 0;
+
+    sqlite3_stmt* stmt = db_stmt(ctx, STMT_COUNT_HASH);
+    if (!stmt)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)hash);
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)cap + 1);
+
+    int n = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) n = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    return n;
+}
+
+int db_begin_transaction(db_ctx* ctx) {
+    return sqlite3_exec(ctx->conn, "BEGIN;", 0, 0, NULL) == SQLITE_OK ? 0 : -1;
+}
+
+int db_commit_transaction(db_ctx* ctx) {
+    if (sqlite3_exec(ctx->conn, "COMMIT;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Commit failed: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+    return 0;
+}
+
+void db_rollback_transaction(db_ctx* ctx) {
+    sqlite3_exec(ctx->conn, "ROLLBACK;", 0, 0, NULL);
+}
+
+int db_savepoint(db_ctx* ctx, const char* name) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "SAVEPOINT %s;", name);
+    if (sqlite3_exec(ctx->conn, sql, 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Savepoint failed: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+    return 0;
+}
+
+int db_release_savepoint(db_ctx* ctx, const char* name) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "RELEASE %s;", name);
+    if (sqlite3_exec(ctx->conn, sql, 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Release failed: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+    return 0;
+}
+
+void db_rollback_to_savepoint(db_ctx* ctx, const char* name) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "ROLLBACK TO %s; RELEASE %s;", name, name);
+    sqlite3_exec(ctx->conn, sql, 0, 0, NULL);
+}
+
+// Read an integer-valued pragma such as "PRAGMA page_count;". Returns 0 or -1.
+static int db_pragma_int(db_ctx* ctx, const char* sql, int64_t* value) {
     sqlite3_stmt* stmt;
-    const char* sql = "INSERT OR IGNORE INTO Fingerprints (hash, time_offset, song_id) VALUES (?, ?, ?);";
+    if (sqlite3_prepare_v2(ctx->conn, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    int rc = sqlite3_step(stmt) == SQLITE_ROW ? 0 : -1;
+    if (rc == 0) *value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+int db_size_bytes(db_ctx* ctx, int64_t* bytes) {
+    int64_t pages, page_size;
+    if (db_pragma_int(ctx, "PRAGMA page_count;", &pages) != 0 ||
+        db_pragma_int(ctx, "PRAGMA page_size;", &page_size) != 0) {
+        fprintf(stderr, "Failed to read catalog size: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+    *bytes = pages * page_size;
+    return 0;
+}
+
+int db_scan_fingerprints(db_ctx* ctx, db_fingerprint_cb cb, void* user) {
+    return db_scan_fingerprint_range(ctx, 0, UINT64_MAX, cb, user);
+}
+
+int db_scan_fingerprint_range(db_ctx* ctx, uint64_t lo, uint64_t hi, db_fingerprint_cb cb, void* user) {
+    // SQLite orders INTEGERs as signed; visiting the non-negative range first
+    // yields ascending order of the hash read as uint64_t.
+    const uint64_t sign = 1ULL << 63;
+    uint64_t bounds[2][2] = {
+        { lo, hi < sign ? hi : sign - 1 },      // Stored as non-negative
+        { lo > sign ? lo : sign, hi },          // Stored as negative
+    };
+
+    for (int r = 0; r < 2; r++) {
+        if (bounds[r][0] > bounds[r][1]) continue;
+
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(ctx->conn,
+                               "SELECT hash, song_id, time_offset FROM Fingerprints "
+                               "WHERE hash BETWEEN ? AND ? ORDER BY hash, song_id, time_offset;",
+                               -1, &stmt, NULL) != SQLITE_OK) {
+            fprintf(stderr, "Fingerprint scan failed: %s\n", sqlite3_errmsg(ctx->conn));
+            return -1;
+        }
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)bounds[r][0]);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)bounds[r][1]);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            uint64_t hash = (uint64_t)sqlite3_column_int64(stmt, 0);
+            int song_id = sqlite3_column_int(stmt, 1);
+            int time_offset = sqlite3_column_int(stmt, 2);
+            if (cb(hash, song_id, time_offset, user) != 0) {
+                sqlite3_finalize(stmt);
+                return 1;
+            }
+        }
+
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Fingerprint scan failed: %s\n", sqlite3_errmsg(ctx->conn));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Orders records the way SQLite orders the clustered key: hash as a signed 64-bit integer.
+static int compare_fingerprint_key(const void* a, const void* b) {
+    const FingerprintHash64* x = (const FingerprintHash64*)a;
+    const FingerprintHash64* y = (const FingerprintHash64*)b;
+    int64_t hx = (int64_t)x->hash, hy = (int64_t)y->hash;
+    if (hx != hy) return hx < hy ? -1 : 1;
+    if (x->song_id != y->song_id) return x->song_id < y->song_id ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
+}
+
+int db_insert_fingerprints(db_ctx* ctx, FingerprintHash64* hashes, int count, int* inserted) {
+    if (!ctx || !hashes || count < 0) return -1;
+    if (inserted) *inserted = 0;
+    if (count == 0) return 0;
+
+    // Sorted input turns B-tree inserts into mostly-sequential page appends
+    qsort(hashes, count, sizeof(*hashes), compare_fingerprint_key);
+
+    sqlite3_stmt* stmt = db_stmt(ctx, ctx->bulk_mode ? STMT_INSERT_STAGING : STMT_INSERT_FINGERPRINT);
+    if (!stmt)
+        return -1;
+
+    // A savepoint nests inside a caller's transaction and acts as BEGIN outside one
+    if (sqlite3_exec(ctx->conn, "SAVEPOINT fp_batch;", 0, 0, NULL) != SQLITE_OK)
+        return -1;
+
+    int added = 0;
+    for (int i = 0; i < count; i++) {
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)hashes[i].hash);
+        sqlite3_bind_int(stmt, 2, hashes[i].song_id);
+        sqlite3_bind_int(stmt, 3, hashes[i].time_offset);
 
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "Fingerprint insert failed: %s\n", sqlite3_errmsg(ctx->conn));
+            sqlite3_reset(stmt);
+            sqlite3_exec(ctx->conn, "ROLLBACK TO fp_batch; RELEASE fp_batch;", 0, 0, NULL);
+            return -1;
+        }
+        added += sqlite3_changes(ctx->conn);
+        sqlite3_reset(stmt);
+    }
+
+    // Staged rows are not visible yet; db_finalize_bulk_load bumps the generation for them
+    if (added > 0 && !ctx->bulk_mode && db_bump_generation(ctx) != 0) {
+        sqlite3_exec(ctx->conn, "ROLLBACK TO fp_batch; RELEASE fp_batch;", 0, 0, NULL);
+        return -1;
+    }
+
+    if (sqlite3_exec(ctx->conn, "RELEASE fp_batch;", 0, 0, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Fingerprint commit failed: %s\n", sqlite3_errmsg(ctx->conn));
+        sqlite3_exec(ctx->conn, "ROLLBACK TO fp_batch; RELEASE fp_batch;", 0, 0, NULL);
         return -1;
+    }
 
-    sqlite3_bind_text(stmt, 1, hash, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 2, time_offset);
-    sqlite3_bind_int(stmt, 3, song_id);
+    if (inserted) *inserted = added;
+    return 0;
+}
 
+// Returns 1 if Fingerprints has no rows, 0 if it has, -1 on error.
+static int db_fingerprints_empty(db_ctx* ctx) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(ctx->conn, "SELECT 1 FROM Fingerprints LIMIT 1;", -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
     int rc = sqlite3_step(stmt);
-    int changes = sqlite3_changes(db);  // Get number of rows actually inserted
     sqlite3_finalize(stmt);
+    if (rc == SQLITE_ROW) return 0;
+    return rc == SQLITE_DONE ? 1 : -1;
+}
+
+int db_begin_bulk_load(db_ctx* ctx) {
+    if (!ctx || ctx->bulk_mode || (ctx->flags & DB_CTX_READONLY)) return -1;
+
+    // Whatever the connection was tuned to comes back at finalize
+    if (db_pragma_int(ctx, "PRAGMA cache_size;", &ctx->saved_cache_size) != 0 ||
+        db_pragma_int(ctx, "PRAGMA mmap_size;", &ctx->saved_mmap_size) != 0 ||
+        db_pragma_int(ctx, "PRAGMA temp_store;", &ctx->saved_temp_store) != 0) {
+        fprintf(stderr, "Failed to read pragmas before bulk load: %s\n", sqlite3_errmsg(ctx->conn));
+        return -1;
+    }
+
+    char* err = NULL;
+
+    // page_size only takes effect via VACUUM outside WAL mode; skip it when the table
+    // already holds data, since rewriting a large catalog would cost more than it saves.
+    int empty = db_fingerprints_empty(ctx);
+    if (empty < 0) return -1;
+    if (empty == 1) {
+        char page_sql[96];
+        snprintf(page_sql, sizeof(page_sql),
+                 "PRAGMA journal_mode=DELETE; PRAGMA page_size=%d; VACUUM;", DB_BULK_PAGE_SIZE);
+        if (sqlite3_exec(ctx->conn, page_sql, 0, 0, &err) != SQLITE_OK) {
+            fprintf(stderr, "Warning: could not change page size: %s\n", err);
+            sqlite3_free(err);
+            err = NULL;
+        }
+    }
+
+    char pragma_sql[256];
+    snprintf(pragma_sql, sizeof(pragma_sql),
+             "PRAGMA journal_mode=WAL;"
+             "PRAGMA synchronous=OFF;"
+             "PRAGMA cache_size=-%d;"
+             "PRAGMA mmap_size=%lld;"
+             "PRAGMA temp_store=FILE;",
+             DB_BULK_CACHE_KB, (long long)DB_BULK_MMAP_SIZE);
+
+    // Staging table has no key or index: appends only, deduplicated at finalize
+    const char* staging_sql =
+        "CREATE TABLE IF NOT EXISTS Fingerprints_staging ("
+        "hash INTEGER NOT NULL, "
+        "song_id INTEGER NOT NULL, "
+        "time_offset INTEGER NOT NULL);";
+
+    if (sqlite3_exec(ctx->conn, pragma_sql, 0, 0, &err) != SQLITE_OK ||
+        sqlite3_exec(ctx->conn, staging_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Failed to enter bulk-load mode: %s\n", err);
+        sqlite3_free(err);
+        return -1;
+    }
+
+    db_clear_stmts(ctx);
+    ctx->bulk_mode = 1;
+    printf("Bulk-load mode enabled.\n");
+    return 0;
+}
+
+int db_finalize_bulk_load(db_ctx* ctx) {
+    if (!ctx || !ctx->bulk_mode) return -1;
+
+    printf("Finalizing bulk load (building clustered fingerprint index)...\n");
+
+    // One sorted pass builds the clustered key bottom-up instead of per-row descents
+    const char* merge_sql =
+        "BEGIN;"
+        "INSERT OR IGNORE INTO Fingerprints (hash, song_id, time_offset) "
+        "SELECT hash, song_id, time_offset FROM Fingerprints_staging "
+        "ORDER BY hash, song_id, time_offset;"
+        "DROP TABLE Fingerprints_staging;"
+        "INSERT INTO Meta (key, value) VALUES ('index_generation', 1) "
+        "ON CONFLICT(key) DO UPDATE SET value = value + 1;"
+        "COMMIT;";
+
+    db_clear_stmts(ctx);  // Release the staging insert before dropping its table
+
+    char* err = NULL;
+    if (sqlite3_exec(ctx->conn, merge_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Bulk-load finalize failed: %s\n", err);
+        sqlite3_free(err);
+        sqlite3_exec(ctx->conn, "ROLLBACK;", 0, 0, NULL);
+        return -1;
+    }
+
+    // Back to durable incremental-ingest settings and the connection's own tuning
+    char restore_sql[256];
+    snprintf(restore_sql, sizeof(restore_sql),
+             "PRAGMA wal_checkpoint(TRUNCATE);"
+             "PRAGMA journal_mode=WAL;"
+             "PRAGMA synchronous=FULL;"
+             "PRAGMA cache_size=%lld;"
+             "PRAGMA mmap_size=%lld;"
+             "PRAGMA temp_store=%lld;"
+             "PRAGMA optimize;",
+             (long long)ctx->saved_cache_size, (long long)ctx->saved_mmap_size,
+             (long long)ctx->saved_temp_store);
+
+    if (sqlite3_exec(ctx->conn, restore_sql, 0, 0, &err) != SQLITE_OK) {
+        fprintf(stderr, "Warning: failed to restore pragmas after bulk load: %s\n", err);
+        sqlite3_free(err);
+    }
+
+    ctx->bulk_mode = 0;
+    printf("Bulk load finalized.\n");
+    return 0;
+}
+
+db_pool* db_pool_open(const char* path, int size) {
+    if (!path || size <= 0) {
+        fprintf(stderr, "Invalid input to db_pool_open.\n");
+        return NULL;
+    }
+
+    db_pool* pool = (db_pool*)calloc(1, sizeof(db_pool));
+    if (!pool) return NULL;
+
+    pool->conns = (db_ctx**)calloc(size, sizeof(db_ctx*));
+    if (!pool->conns) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+
+    for (int i = 0; i < size; i++) {
+        pool->conns[i] = db_open_ctx(path, DB_CTX_READONLY);
+        if (!pool->conns[i]) {
+            db_pool_close(pool);
+            return NULL;
+        }
+        pool->size++;
+        pool->free_count++;
+    }
+
+    return pool;
+}
+
+db_ctx* db_pool_acquire(db_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->free_count == 0)
+        pthread_cond_wait(&pool->available, &pool->lock);
+    db_ctx* ctx = pool->conns[--pool->free_count];
+    ctx->pool_filter = pool->filter;
+    ctx->filter = pool->filter ? pool->filter->filter : NULL;
+    if (pool->filter) pool->filter->refs++;
+    pthread_mutex_unlock(&pool->lock);
+    return ctx;
+}
+
+// Caller holds the pool lock.
+static void pool_filter_unref(PoolFilter* pf) {
+    if (!pf || --pf->refs > 0) return;
+    bloom_free(pf->owned);
+    free(pf);
+}
+
+void db_pool_release(db_pool* pool, db_ctx* ctx) {
+    pthread_mutex_lock(&pool->lock);
+    pool_filter_unref(ctx->pool_filter);
+    ctx->pool_filter = NULL;
+    ctx->filter = NULL;
+    pool->conns[pool->free_count++] = ctx;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Swap in `filter` (NULL detaches). Returns -1 if the holder cannot be allocated.
+static int pool_attach_filter(db_pool* pool, const BloomFilter* filter, BloomFilter* owned) {
+    PoolFilter* pf = NULL;
+    if (filter) {
+        pf = (PoolFilter*)calloc(1, sizeof(PoolFilter));
+        if (!pf) {
+            bloom_free(owned);
+            return -1;
+        }
+        pf->filter = filter;
+        pf->owned = owned;
+        pf->refs = 1;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool_filter_unref(pool->filter);
+    pool->filter = pf;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void db_pool_set_filter(db_pool* pool, const BloomFilter* filter) {
+    pool_attach_filter(pool, filter, NULL);
+}
+
+int db_pool_load_filter(db_pool* pool, const char* path) {
+    char* copy = strdup(path);
+    if (!copy) return -1;
+    pthread_mutex_lock(&pool->lock);
+    free(pool->filter_path);
+    pool->filter_path = copy;
+    pthread_mutex_unlock(&pool->lock);
+
+    int64_t generation;
+    db_ctx* ctx = db_pool_acquire(pool);
+    int rc = db_get_generation(ctx, &generation);
+    db_pool_release(pool, ctx);
+    if (rc != 0) return -1;
+    db_pool_sync_filter(pool, generation);
+
+    pthread_mutex_lock(&pool->lock);
+    rc = pool->filter ? 0 : -1;
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
+void db_pool_sync_filter(db_pool* pool, int64_t generation) {
+    pthread_mutex_lock(&pool->lock);
+    int current = pool->filter && bloom_generation(pool->filter->filter) == generation;
+    if (current || !pool->filter_path || pool->filter_loading) {
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    // The filter in use no longer covers every row: stop consulting it now
+    if (pool->filter) {
+        pool_filter_unref(pool->filter);
+        pool->filter = NULL;
+        fprintf(stderr, "Catalog changed; filter %s detached until it is rebuilt.\n", pool->filter_path);
+    }
+
+    pool->filter_loading = 1;
+    pthread_mutex_unlock(&pool->lock);
+
+    // Only the header is read until the file has been rebuilt for this generation
+    int64_t file_generation;
+    BloomFilter* filter = NULL;
+    if (bloom_file_generation(pool->filter_path, &file_generation) == 0 && file_generation == generation)
+        filter = bloom_load(pool->filter_path);
+    int ok = filter && bloom_generation(filter) == generation;
+    if (!ok) bloom_free(filter);
+    if (ok && pool_attach_filter(pool, filter, filter) != 0) ok = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->filter_loading = 0;
+    pthread_mutex_unlock(&pool->lock);
+    if (ok) printf("Loaded filter %s for catalog generation %lld.\n", pool->filter_path, (long long)generation);
+}
 
-    return (rc == SQLITE_DONE && changes > 0) ? 0 : 1;  // 0 = inserted, 1 = duplicate ignored
+// All connections must have been released.
+void db_pool_close(db_pool* pool) {
+    if (!pool) return;
+    for (int i = 0; i < pool->free_count; i++)
+        db_close_ctx(pool->conns[i]);
+    pool_filter_unref(pool->filter);
+    free(pool->filter_path);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->available);
+    free(pool->conns);
+    free(pool);
 }
@@ -0,0 +1,330 @@
+// File: src/db_writer.c
+// Dedicated SQLite writer thread fed by a bounded batch queue.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "config.h"
+#include "db.h"
+#include "db_writer.h"
+#include "shard_set.h"
+#include "lsm_index.h"
+
+typedef struct {
+    char* name;
+    char* artist;
+    FingerprintHash64* hashes;
+    int count;
+    Peak* peaks;
+    int num_peaks;
+} WriteJob;
+
+struct DbWriter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    WriteJob* ring;          // Circular buffer of pending jobs
+    int capacity;
+    int head;
+    int size;
+    int stopping;
+
+    db_ctx* db;              // Connection owned by the writer thread
+    ShardSet* shards;        // If set, fingerprints go here instead of `db`
+    LsmIndex* lsm;           // Likewise; duplicates are dropped when segments are written
+    int next_song_id;        // Lowest id apply_external may hand out
+    int txn_rows;
+    int failed;              // Batches that could not be written
+    long long rows_written;
+    int songs_written;
+};
+
+static void free_job(WriteJob* job) {
+    free(job->name);
+    free(job->artist);
+    free(job->hashes);
+    free(job->peaks);
+}
+
+// Peaks and sketch of a song already registered in the current savepoint.
+static int store_song_extras(DbWriter* w, WriteJob* job, int song_id) {
+    if (job->peaks && db_insert_song_peaks(w->db, song_id, job->peaks, job->num_peaks) != 0) {
+        fprintf(stderr, "Writer: failed to store peaks for '%s'.\n", job->name);
+        return -1;
+    }
+
+    // Lets later ingests recognise re-encodes of this song (see sketch_index.h)
+    SongSketch sketch;
+    song_sketch_compute(job->hashes, job->count, &sketch);
+    if (db_set_song_sketch(w->db, song_id, &sketch) != 0) {
+        fprintf(stderr, "Writer: failed to store the sketch of '%s'.\n", job->name);
+        return -1;
+    }
+    return 0;
+}
+
+// Fingerprints go to the main DB: song and fingerprints share one savepoint.
+static int apply_local(DbWriter* w, WriteJob* job, int* song_id, int* inserted) {
+    if (db_insert_song(w->db, job->name, job->artist, song_id) != 0) {
+        fprintf(stderr, "Writer: failed to insert song '%s'.\n", job->name);
+        return -1;
+    }
+    for (int i = 0; i < job->count; i++)
+        job->hashes[i].song_id = *song_id;
+
+    if (db_insert_fingerprints(w->db, job->hashes, job->count, inserted) != 0) {
+        fprintf(stderr, "Writer: failed to insert hashes for '%s'.\n", job->name);
+        return -1;
+    }
+    return store_song_extras(w, job, *song_id);
+}
+
+// Fingerprints go to shards or the LSM index, which commit on their own. They are
+// written first under an id picked here, and the Songs row only afterwards, so a
+// failure never leaves a registered song without fingerprints. An id is never
+// handed out twice, even if its fingerprints were only partly written.
+static int apply_external(DbWriter* w, WriteJob* job, int* song_id, int* inserted) {
+    int max_id;
+    if (db_max_song_id(w->db, &max_id) != 0) return -1;
+    *song_id = max_id + 1 > w->next_song_id ? max_id + 1 : w->next_song_id;
+    w->next_song_id = *song_id + 1;
+
+    for (int i = 0; i < job->count; i++)
+        job->hashes[i].song_id = *song_id;
+
+    int rc;
+    if (w->lsm) {
+        rc = lsm_index_add(w->lsm, job->hashes, job->count);
+        *inserted = job->count;
+    } else {
+        rc = shard_set_insert_fingerprints(w->shards, job->hashes, job->count, inserted);
+    }
+    if (rc != 0) {
+        fprintf(stderr, "Writer: failed to insert hashes for '%s'.\n", job->name);
+        return -1;
+    }
+
+    if (db_insert_song_with_id(w->db, *song_id, job->name, job->artist) != 0) {
+        fprintf(stderr, "Writer: failed to insert song '%s'.\n", job->name);
+        return -1;
+    }
+    return store_song_extras(w, job, *song_id);
+}
+
+// Register the song and insert its fingerprints in one savepoint, so a failed job
+// leaves nothing behind in the main DB. Returns rows written, or -1.
+static int apply_job(DbWriter* w, WriteJob* job) {
+    int song_id = -1;
+    int found = db_find_song(w->db, job->name, job->artist, &song_id);
+    if (found < 0) {
+        fprintf(stderr, "Writer: failed to look up song '%s'.\n", job->name);
+        return -1;
+    }
+    if (found == 1) {
+        printf("Skipping duplicate song: %s\n", job->name);
+        return 0;
+    }
+
+    if (db_savepoint(w->db, "song_job") != 0) return -1;
+
+    int inserted = 0;
+    int rc = (w->lsm || w->shards) ? apply_external(w, job, &song_id, &inserted)
+                                   : apply_local(w, job, &song_id, &inserted);
+    if (rc != 0 || db_release_savepoint(w->db, "song_job") != 0) {
+        db_rollback_to_savepoint(w->db, "song_job");
+        return -1;
+    }
+
+    printf("Inserted %d/%d hashes for '%s' (ID=%d, %d duplicates skipped).\n",
+           inserted, job->count, job->name, song_id, job->count - inserted);
+    w->songs_written++;
+    return inserted;
+}
+
+// Commit the open transaction. Buffered LSM records are flushed first: the Songs
+// rows must not become durable before their fingerprints.
+static void commit_batch(DbWriter* w, int txn_jobs) {
+    if (w->lsm && lsm_index_flush(w->lsm) != 0) {
+        fprintf(stderr, "Writer: LSM flush failed; rolling back %d songs.\n", txn_jobs);
+        db_rollback_transaction(w->db);
+        w->failed += txn_jobs;
+        return;
+    }
+    if (db_commit_transaction(w->db) != 0) {
+        db_rollback_transaction(w->db);
+        w->failed += txn_jobs;
+    }
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void* writer_main(void* arg) {
+    DbWriter* w = (DbWriter*)arg;
+    int in_txn = 0;
+    int txn_rows = 0;
+    int txn_jobs = 0;
+    double txn_started = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        // An empty queue is not a reason to commit: a single producer leaves it
+        // empty between most songs. An open transaction waits until it is full,
+        // DB_WRITER_TXN_MS old, or the writer stops.
+        while (w->size == 0 && !w->stopping) {
+            if (!in_txn) {
+                pthread_cond_wait(&w->not_empty, &w->lock);
+                continue;
+            }
+            double wait_ms = txn_started + DB_WRITER_TXN_MS - now_ms();
+            if (wait_ms <= 0) break;
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            long long ns = until.tv_nsec + (long long)(wait_ms * 1e6);
+            until.tv_sec += ns / 1000000000LL;
+            until.tv_nsec = ns % 1000000000LL;
+            pthread_cond_timedwait(&w->not_empty, &w->lock, &until);
+        }
+
+        if (w->size == 0) {
+            int done = w->stopping;
+            pthread_mutex_unlock(&w->lock);
+            if (in_txn) {
+                commit_batch(w, txn_jobs);
+                in_txn = 0;
+                txn_rows = 0;
+                txn_jobs = 0;
+            }
+            if (done) break;
+            continue;
+        }
+
+        WriteJob job = w->ring[w->head];
+        w->head = (w->head + 1) % w->capacity;
+        w->size--;
+        pthread_cond_signal(&w->not_full);
+        pthread_mutex_unlock(&w->lock);
+
+        if (!in_txn) {
+            if (db_begin_transaction(w->db) == 0) {
+                in_txn = 1;
+                txn_started = now_ms();
+            } else {
+                fprintf(stderr, "Writer: failed to begin transaction.\n");
+            }
+        }
+
+        // Without a transaction the Songs row would commit ahead of buffered LSM records
+        int rows = in_txn || !w->lsm ? apply_job(w, &job) : -1;
+        if (rows < 0) {
+            w->failed++;
+        } else {
+            txn_rows += rows;
+            txn_jobs++;
+            w->rows_written += rows;
+        }
+        free_job(&job);
+
+        if (in_txn && (txn_rows >= w->txn_rows || now_ms() - txn_started >= DB_WRITER_TXN_MS)) {
+            commit_batch(w, txn_jobs);
+            in_txn = 0;
+            txn_rows = 0;
+            txn_jobs = 0;
+        }
+    }
+
+    return NULL;
+}
+
+DbWriter* db_writer_start(db_ctx* db, ShardSet* shards, LsmIndex* lsm,
+                          int queue_depth, int txn_rows) {
+    if (!db || queue_depth <= 0 || txn_rows <= 0) {
+        fprintf(stderr, "Invalid input to db_writer_start.\n");
+        return NULL;
+    }
+
+    DbWriter* w = (DbWriter*)calloc(1, sizeof(DbWriter));
+    if (!w) return NULL;
+
+    w->ring = (WriteJob*)calloc(queue_depth, sizeof(WriteJob));
+    if (!w->ring) {
+        free(w);
+        return NULL;
+    }
+
+    w->db = db;
+    w->shards = shards;
+    w->lsm = lsm;
+    w->capacity = queue_depth;
+    w->txn_rows = txn_rows;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->not_empty, NULL);
+    pthread_cond_init(&w->not_full, NULL);
+
+    if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+        fprintf(stderr, "Failed to start DB writer thread.\n");
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->not_empty);
+        pthread_cond_destroy(&w->not_full);
+        free(w->ring);
+        free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+int db_writer_submit(DbWriter* w, const char* name, const char* artist,
+                     FingerprintHash64* hashes, int count, Peak* peaks, int num_peaks) {
+    WriteJob job = { strdup(name), strdup(artist), hashes, count, peaks, num_peaks };
+    if (!w || !job.name || !job.artist) {
+        free_job(&job);
+        return -1;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    while (w->size == w->capacity && !w->stopping)
+        pthread_cond_wait(&w->not_full, &w->lock);
+
+    if (w->stopping) {
+        pthread_mutex_unlock(&w->lock);
+        free_job(&job);
+        return -1;
+    }
+
+    w->ring[(w->head + w->size) % w->capacity] = job;
+    w->size++;
+    pthread_cond_signal(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+int db_writer_stop(DbWriter* w) {
+    if (!w) return -1;
+
+    pthread_mutex_lock(&w->lock);
+    w->stopping = 1;
+    pthread_cond_broadcast(&w->not_empty);
+    pthread_cond_broadcast(&w->not_full);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    printf("Writer: %d songs, %lld hashes written, %d batches failed.\n",
+           w->songs_written, w->rows_written, w->failed);
+
+    int rc = w->failed ? -1 : 0;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->not_empty);
+    pthread_cond_destroy(&w->not_full);
+    free(w->ring);
+    free(w);
+    return rc;
+}
@@ -0,0 +1,578 @@
+// File: src/dedup.c
+// Catalog-wide duplicate detection by pair voting over hash-sorted posting lists.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "config.h"
+#include "hashing.h"
+#include "dedup.h"
+
+#define DEDUP_PATH_LEN 1024
+
+// One pair vote as spilled to disk
+typedef struct {
+    uint32_t song_a, song_b;
+    int32_t delta;              // time_b - time_a
+} PairVote;
+
+typedef struct {
+    char path[DEDUP_PATH_LEN];
+    FILE* file;
+    pthread_mutex_t lock;
+    long long records;
+} Partition;
+
+typedef struct {
+    Partition parts[DEDUP_PARTITIONS];
+    int num_open;
+    pthread_mutex_t lock;       // Guards everything below
+    int* song_hashes;           // Postings per song_id, for similarity
+    int song_capacity;
+    DedupStats stats;
+    int failed;
+} DedupJob;
+
+// One hash range (SQLite) or position range (mapped index) of the scan
+typedef struct {
+    DedupJob* job;
+    db_pool* pool;
+    const MmapIndex* index;
+    uint64_t lo, hi;            // Inclusive hash range, or [lo, hi) positions
+
+    PairVote* buffers;          // DEDUP_SPILL_RECORDS per partition
+    int fill[DEDUP_PARTITIONS];
+    int* song_hashes;
+    int song_capacity;
+
+    uint64_t group_hash;        // SQLite scan: postings of the current hash
+    Posting* group;
+    size_t group_count;
+    size_t group_capacity;
+    int has_group;
+
+    long long postings;
+    long long lists_skipped;
+    long long votes;
+    int failed;
+} ScanTask;
+
+// Counting stage: the qualifying pairs of one partition
+typedef struct {
+    DedupJob* job;
+    int part;
+    int min_score;
+    float min_similarity;
+    DuplicatePair* pairs;
+    int count;
+    int capacity;
+    int failed;
+} CountTask;
+
+static void run_tasks(ThreadPool* workers, task_fn fn, void* tasks, size_t task_size, int n) {
+    TaskGroup group;
+    task_group_init(&group);
+    for (int i = 0; i < n; i++) {
+        void* arg = (char*)tasks + (size_t)i * task_size;
+        if (!workers || thread_pool_submit(workers, &group, fn, arg) != 0)
+            fn(arg, 0);  // No pool, or the queue refused the task: run it here
+    }
+    task_group_wait(&group);
+    task_group_destroy(&group);
+}
+
+// ===========================
+// Spill files
+// ===========================
+
+static int job_open(DedupJob* job, const char* spill_dir) {
+    memset(job, 0, sizeof(*job));
+    pthread_mutex_init(&job->lock, NULL);
+    for (; job->num_open < DEDUP_PARTITIONS; job->num_open++) {
+        Partition* p = &job->parts[job->num_open];
+        int n = snprintf(p->path, sizeof(p->path), "%s/dedup_%ld_%03d.spill",
+                         spill_dir, (long)getpid(), job->num_open);
+        if (n < 0 || n >= (int)sizeof(p->path) || !(p->file = fopen(p->path, "w+b"))) {
+            fprintf(stderr, "Failed to create spill file in %s\n", spill_dir);
+            return -1;
+        }
+        pthread_mutex_init(&p->lock, NULL);
+        p->records = 0;
+    }
+    return 0;
+}
+
+static void job_close(DedupJob* job) {
+    for (int i = 0; i < job->num_open; i++) {
+        Partition* p = &job->parts[i];
+        if (p->file) fclose(p->file);
+        remove(p->path);
+        pthread_mutex_destroy(&p->lock);
+    }
+    free(job->song_hashes);
+    pthread_mutex_destroy(&job->lock);
+}
+
+static int partition_of(uint32_t song_a, uint32_t song_b) {
+    return (int)(mix_hash64(((uint64_t)song_a << 32) | song_b) % DEDUP_PARTITIONS);
+}
+
+static void flush_partition(ScanTask* t, int part) {
+    Partition* p = &t->job->parts[part];
+    size_t n = (size_t)t->fill[part];
+    if (n == 0) return;
+
+    pthread_mutex_lock(&p->lock);
+    if (fwrite(t->buffers + (size_t)part * DEDUP_SPILL_RECORDS, sizeof(PairVote), n, p->file) != n)
+        t->failed = 1;
+    else
+        p->records += (long long)n;
+    pthread_mutex_unlock(&p->lock);
+    t->fill[part] = 0;
+}
+
+// ===========================
+// Scanning
+// ===========================
+
+static void count_song(ScanTask* t, int song_id) {
+    if (song_id < 0) return;
+    if (song_id >= t->song_capacity) {
+        int capacity = t->song_capacity ? t->song_capacity : 1024;
+        while (capacity <= song_id) capacity *= 2;
+        int* grown = realloc(t->song_hashes, capacity * sizeof(int));
+        if (!grown) {
+            t->failed = 1;
+            return;
+        }
+        memset(grown + t->song_capacity, 0, (capacity - t->song_capacity) * sizeof(int));
+        t->song_hashes = grown;
+        t->song_capacity = capacity;
+    }
+    t->song_hashes[song_id]++;
+}
+
+// One vote per pair of different songs in a list sorted by (song_id, time_offset).
+static void vote_list(ScanTask* t, const Posting* p, size_t count) {
+    if (count > DEDUP_MAX_LIST_LEN) {
+        t->lists_skipped++;
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (p[j].song_id == p[i].song_id) continue;
+            uint32_t a = (uint32_t)p[i].song_id, b = (uint32_t)p[j].song_id;
+            int part = partition_of(a, b);
+            PairVote* v = &t->buffers[(size_t)part * DEDUP_SPILL_RECORDS + t->fill[part]++];
+            v->song_a = a;
+            v->song_b = b;
+            v->delta = p[j].time_offset - p[i].time_offset;
+            t->votes++;
+            if (t->fill[part] == DEDUP_SPILL_RECORDS) flush_partition(t, part);
+        }
+    }
+}
+
+static void flush_group(ScanTask* t) {
+    if (!t->has_group) return;
+    vote_list(t, t->group, t->group_count);
+    t->group_count = 0;
+    t->has_group = 0;
+}
+
+static int scan_row(uint64_t hash, int song_id, int time_offset, void* user) {
+    ScanTask* t = (ScanTask*)user;
+    if (t->has_group && hash != t->group_hash) flush_group(t);
+    if (t->failed) return -1;
+
+    t->group_hash = hash;
+    t->has_group = 1;
+    t->postings++;
+    count_song(t, song_id);
+
+    // Lists over the limit are dropped at flush; stop buffering them early
+    if (t->group_count > DEDUP_MAX_LIST_LEN) return 0;
+    if (t->group_count == t->group_capacity) {
+        size_t capacity = t->group_capacity ? t->group_capacity * 2 : 64;
+        Posting* group = realloc(t->group, capacity * sizeof(Posting));
+        if (!group) {
+            t->failed = 1;
+            return -1;
+        }
+        t->group = group;
+        t->group_capacity = capacity;
+    }
+    t->group[t->group_count++] = (Posting){ song_id, time_offset };
+    return 0;
+}
+
+static void scan_range(void* arg, int worker_id) {
+    (void)worker_id;
+    ScanTask* t = (ScanTask*)arg;
+    t->buffers = (PairVote*)malloc((size_t)DEDUP_PARTITIONS * DEDUP_SPILL_RECORDS * sizeof(PairVote));
+    if (!t->buffers) {
+        t->failed = 1;
+    } else if (t->index) {
+        for (uint64_t i = t->lo; i < t->hi && !t->failed; i++) {
+            const Posting* p;
+            size_t count = mmap_index_postings_at(t->index, i, &p);
+            for (size_t j = 0; j < count; j++) count_song(t, p[j].song_id);
+            t->postings += (long long)count;
+            vote_list(t, p, count);
+        }
+    } else {
+        db_ctx* ctx = db_pool_acquire(t->pool);
+        if (db_scan_fingerprint_range(ctx, t->lo, t->hi, scan_row, t) < 0) t->failed = 1;
+        db_pool_release(t->pool, ctx);
+        flush_group(t);
+    }
+
+    for (int part = 0; part < DEDUP_PARTITIONS; part++) flush_partition(t, part);
+    free(t->buffers);
+    free(t->group);
+    t->buffers = NULL;
+    t->group = NULL;
+
+    // Fold this range's counters into the job
+    DedupJob* job = t->job;
+    pthread_mutex_lock(&job->lock);
+    if (t->song_capacity > job->song_capacity) {
+        int* grown = realloc(job->song_hashes, t->song_capacity * sizeof(int));
+        if (grown) {
+            memset(grown + job->song_capacity, 0, (t->song_capacity - job->song_capacity) * sizeof(int));
+            job->song_hashes = grown;
+            job->song_capacity = t->song_capacity;
+        } else {
+            t->failed = 1;
+        }
+    }
+    for (int s = 0; s < t->song_capacity && s < job->song_capacity; s++)
+        job->song_hashes[s] += t->song_hashes[s];
+    job->stats.postings += t->postings;
+    job->stats.lists_skipped += t->lists_skipped;
+    job->stats.votes += t->votes;
+    job->failed |= t->failed;
+    pthread_mutex_unlock(&job->lock);
+    free(t->song_hashes);
+    t->song_hashes = NULL;
+}
+
+// ===========================
+// Counting
+// ===========================
+
+static int compare_vote(const void* a, const void* b) {
+    const PairVote* x = (const PairVote*)a;
+    const PairVote* y = (const PairVote*)b;
+    if (x->song_a != y->song_a) return x->song_a < y->song_a ? -1 : 1;
+    if (x->song_b != y->song_b) return x->song_b < y->song_b ? -1 : 1;
+    if (x->delta != y->delta) return x->delta < y->delta ? -1 : 1;
+    return 0;
+}
+
+static int compare_pair(const void* a, const void* b) {
+    const DuplicatePair* x = (const DuplicatePair*)a;
+    const DuplicatePair* y = (const DuplicatePair*)b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    if (x->song_a != y->song_a) return x->song_a < y->song_a ? -1 : 1;
+    return x->song_b - y->song_b;
+}
+
+static int song_hashes(const DedupJob* job, uint32_t song_id) {
+    return song_id < (uint32_t)job->song_capacity ? job->song_hashes[song_id] : 0;
+}
+
+// Score the votes of one song pair, votes[0..n) sorted by delta.
+static void score_pair(CountTask* t, const PairVote* votes, size_t n) {
+    // Re-encodes drift by a fraction of a frame, so neighbouring deltas count together
+    int best = 0, best_delta = 0;
+    size_t run = 0;
+    int prev_count = 0, prev_delta = 0;
+    for (size_t i = 0; i < n; i = run) {
+        run = i;
+        while (run < n && votes[run].delta == votes[i].delta) run++;
+        int count = (int)(run - i);
+        int score = count + (i > 0 && prev_delta == votes[i].delta - 1 ? prev_count : 0);
+        if (score > best) {
+            best = score;
+            best_delta = count >= prev_count || prev_delta != votes[i].delta - 1 ? votes[i].delta : prev_delta;
+        }
+        prev_count = count;
+        prev_delta = votes[i].delta;
+    }
+
+    int shorter = song_hashes(t->job, votes[0].song_a);
+    int other = song_hashes(t->job, votes[0].song_b);
+    if (other < shorter) shorter = other;
+    float similarity = shorter > 0 ? (float)best / shorter : 0.0f;
+    if (best < t->min_score || similarity < t->min_similarity) return;
+
+    if (t->count == t->capacity) {
+        int capacity = t->capacity ? t->capacity * 2 : 64;
+        DuplicatePair* grown = realloc(t->pairs, capacity * sizeof(DuplicatePair));
+        if (!grown) {
+            t->failed = 1;
+            return;
+        }
+        t->pairs = grown;
+        t->capacity = capacity;
+    }
+    t->pairs[t->count++] = (DuplicatePair){ (int)votes[0].song_a, (int)votes[0].song_b, best, best_delta,
+                                            similarity > 1.0f ? 1.0f : similarity };
+}
+
+// Score every pair in votes[0..n), sorted by (song_a, song_b, delta).
+static void score_sorted(CountTask* t, const PairVote* votes, size_t n) {
+    for (size_t i = 0, end; i < n && !t->failed; i = end) {
+        end = i + 1;
+        while (end < n && votes[end].song_a == votes[i].song_a && votes[end].song_b == votes[i].song_b) end++;
+        score_pair(t, votes + i, end - i);
+    }
+}
+
+// Read position in one sorted run of the run file
+typedef struct {
+    off_t offset;
+    long long left;             // Records not yet read
+    PairVote* buf;              // DEDUP_MERGE_RECORDS
+    size_t pos, len;
+} RunCursor;
+
+static int refill_run(FILE* f, RunCursor* r) {
+    size_t want = r->left < DEDUP_MERGE_RECORDS ? (size_t)r->left : DEDUP_MERGE_RECORDS;
+    if (fseeko(f, r->offset, SEEK_SET) != 0 || fread(r->buf, sizeof(PairVote), want, f) != want)
+        return -1;
+    r->offset += (off_t)(want * sizeof(PairVote));
+    r->left -= (long long)want;
+    r->pos = 0;
+    r->len = want;
+    return 0;
+}
+
+// Partitions over DEDUP_SORT_RECORDS are sorted in runs of that size, written to
+// a second file, and merged; only one song pair's votes are held at a time.
+static int count_external(CountTask* t, Partition* p, size_t n) {
+    size_t run_len = DEDUP_SORT_RECORDS;
+    int num_runs = (int)((n + run_len - 1) / run_len);
+    char path[DEDUP_PATH_LEN + 8];
+    snprintf(path, sizeof(path), "%s.runs", p->path);
+
+    FILE* runs = fopen(path, "w+b");
+    PairVote* buf = (PairVote*)malloc(run_len * sizeof(PairVote));
+    RunCursor* cursors = (RunCursor*)calloc(num_runs, sizeof(RunCursor));
+    PairVote* ahead = (PairVote*)malloc((size_t)num_runs * DEDUP_MERGE_RECORDS * sizeof(PairVote));
+    PairVote* group = NULL;
+    size_t group_count = 0, group_capacity = 0;
+    int rc = runs && buf && cursors && ahead ? 0 : -1;
+
+    for (int r = 0; r < num_runs && rc == 0; r++) {
+        size_t m = n - (size_t)r * run_len < run_len ? n - (size_t)r * run_len : run_len;
+        if (fread(buf, sizeof(PairVote), m, p->file) != m) {
+            rc = -1;
+            break;
+        }
+        qsort(buf, m, sizeof(PairVote), compare_vote);
+        if (fwrite(buf, sizeof(PairVote), m, runs) != m) rc = -1;
+        cursors[r].offset = (off_t)((size_t)r * run_len * sizeof(PairVote));
+        cursors[r].left = (long long)m;
+        cursors[r].buf = ahead + (size_t)r * DEDUP_MERGE_RECORDS;
+    }
+    free(buf);
+    fclose(p->file);
+    p->file = NULL;
+    remove(p->path);
+
+    if (rc == 0 && fflush(runs) != 0) rc = -1;
+    for (int r = 0; r < num_runs && rc == 0; r++) rc = refill_run(runs, &cursors[r]);
+
+    while (rc == 0 && !t->failed) {
+        int min = -1;
+        for (int r = 0; r < num_runs; r++) {
+            if (cursors[r].pos == cursors[r].len) continue;
+            if (min < 0 || compare_vote(&cursors[r].buf[cursors[r].pos], &cursors[min].buf[cursors[min].pos]) < 0)
+                min = r;
+        }
+        if (min < 0) break;
+
+        RunCursor* c = &cursors[min];
+        PairVote v = c->buf[c->pos++];
+        if (c->pos == c->len && c->left > 0 && refill_run(runs, c) != 0) rc = -1;
+
+        if (group_count > 0 && (group[0].song_a != v.song_a || group[0].song_b != v.song_b)) {
+            score_pair(t, group, group_count);
+            group_count = 0;
+        }
+        if (group_count == group_capacity) {
+            size_t capacity = group_capacity ? group_capacity * 2 : 1024;
+            PairVote* grown = realloc(group, capacity * sizeof(PairVote));
+            if (!grown) {
+                rc = -1;
+                break;
+            }
+            group = grown;
+            group_capacity = capacity;
+        }
+        group[group_count++] = v;
+    }
+    if (rc == 0 && group_count > 0) score_pair(t, group, group_count);
+
+    free(group);
+    free(ahead);
+    free(cursors);
+    if (runs) fclose(runs);
+    remove(path);
+    return rc;
+}
+
+static void count_partition(void* arg, int worker_id) {
+    (void)worker_id;
+    CountTask* t = (CountTask*)arg;
+    Partition* p = &t->job->parts[t->part];
+    size_t n = (size_t)p->records;
+    if (n == 0) return;
+
+    if (fflush(p->file) != 0 || fseek(p->file, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "Failed to read spill file %s\n", p->path);
+        t->failed = 1;
+        return;
+    }
+    if (n > DEDUP_SORT_RECORDS) {
+        if (count_external(t, p, n) != 0) {
+            fprintf(stderr, "Failed to merge spill file %s\n", p->path);
+            t->failed = 1;
+        }
+        return;
+    }
+
+    PairVote* votes = (PairVote*)malloc(n * sizeof(PairVote));
+    if (!votes || fread(votes, sizeof(PairVote), n, p->file) != n) {
+        fprintf(stderr, "Failed to read spill file %s\n", p->path);
+        free(votes);
+        t->failed = 1;
+        return;
+    }
+
+    // The file is no longer needed; give the disk space back before sorting
+    fclose(p->file);
+    p->file = NULL;
+    remove(p->path);
+
+    qsort(votes, n, sizeof(PairVote), compare_vote);
+    score_sorted(t, votes, n);
+    free(votes);
+}
+
+// ===========================
+// Public API
+// ===========================
+
+static int find_duplicates(DedupJob* job, ScanTask* scans, int num_scans, ThreadPool* workers,
+                           int min_score, float min_similarity, DuplicatePair** out, int* count,
+                           DedupStats* stats) {
+    run_tasks(workers, scan_range, scans, sizeof(ScanTask), num_scans);
+    if (job->failed) {
+        fprintf(stderr, "Duplicate scan failed.\n");
+        return -1;
+    }
+    for (int i = 0; i < DEDUP_PARTITIONS; i++)
+        job->stats.spill_bytes += job->parts[i].records * (long long)sizeof(PairVote);
+
+    CountTask* counts = (CountTask*)calloc(DEDUP_PARTITIONS, sizeof(CountTask));
+    if (!counts) return -1;
+    for (int i = 0; i < DEDUP_PARTITIONS; i++) {
+        counts[i].job = job;
+        counts[i].part = i;
+        counts[i].min_score = min_score;
+        counts[i].min_similarity = min_similarity;
+    }
+    run_tasks(workers, count_partition, counts, sizeof(CountTask), DEDUP_PARTITIONS);
+
+    int total = 0, failed = 0;
+    for (int i = 0; i < DEDUP_PARTITIONS; i++) {
+        total += counts[i].count;
+        failed |= counts[i].failed;
+    }
+
+    DuplicatePair* pairs = failed ? NULL : (DuplicatePair*)malloc((total > 0 ? total : 1) * sizeof(DuplicatePair));
+    if (pairs) {
+        int n = 0;
+        for (int i = 0; i < DEDUP_PARTITIONS; i++) {
+            if (counts[i].count > 0) memcpy(pairs + n, counts[i].pairs, counts[i].count * sizeof(DuplicatePair));
+            n += counts[i].count;
+        }
+        qsort(pairs, total, sizeof(DuplicatePair), compare_pair);
+    }
+    for (int i = 0; i < DEDUP_PARTITIONS; i++) free(counts[i].pairs);
+    free(counts);
+
+    if (!pairs) {
+        fprintf(stderr, "Duplicate counting failed.\n");
+        return -1;
+    }
+    *out = pairs;
+    *count = total;
+    if (stats) *stats = job->stats;
+    return 0;
+}
+
+static int check_input(const char* spill_dir, int min_score, DuplicatePair** out, int* count) {
+    if (!spill_dir || min_score <= 0 || !out || !count) {
+        fprintf(stderr, "Invalid input to duplicate detection.\n");
+        return -1;
+    }
+    *out = NULL;
+    *count = 0;
+    return 0;
+}
+
+int dedup_find_db(db_pool* pool, ThreadPool* workers, const char* spill_dir, int min_score,
+                  float min_similarity, DuplicatePair** out, int* count, DedupStats* stats) {
+    if (!pool || check_input(spill_dir, min_score, out, count) != 0) return -1;
+
+    DedupJob job;
+    ScanTask* scans = (ScanTask*)calloc(DEDUP_SCAN_RANGES, sizeof(ScanTask));
+    int rc = scans && job_open(&job, spill_dir) == 0 ? 0 : -1;
+    if (rc == 0) {
+        // Equal slices of the 64-bit hash space, scanned in hash order
+        uint64_t step = UINT64_MAX / DEDUP_SCAN_RANGES + 1;
+        for (int i = 0; i < DEDUP_SCAN_RANGES; i++) {
+            scans[i].job = &job;
+            scans[i].pool = pool;
+            scans[i].lo = (uint64_t)i * step;
+            scans[i].hi = i + 1 < DEDUP_SCAN_RANGES ? scans[i].lo + step - 1 : UINT64_MAX;
+        }
+        rc = find_duplicates(&job, scans, DEDUP_SCAN_RANGES, workers, min_score, min_similarity,
+                             out, count, stats);
+    }
+    if (scans) job_close(&job);
+    free(scans);
+    return rc;
+}
+
+int dedup_find_mmap(const MmapIndex* index, ThreadPool* workers, const char* spill_dir, int min_score,
+                    float min_similarity, DuplicatePair** out, int* count, DedupStats* stats) {
+    if (!index || check_input(spill_dir, min_score, out, count) != 0) return -1;
+
+    DedupJob job;
+    ScanTask* scans = (ScanTask*)calloc(DEDUP_SCAN_RANGES, sizeof(ScanTask));
+    int rc = scans && job_open(&job, spill_dir) == 0 ? 0 : -1;
+    if (rc == 0) {
+        // Equal slices of the hash table by position
+        uint64_t num_hashes = mmap_index_num_hashes(index);
+        for (int i = 0; i < DEDUP_SCAN_RANGES; i++) {
+            scans[i].job = &job;
+            scans[i].index = index;
+            scans[i].lo = num_hashes * i / DEDUP_SCAN_RANGES;
+            scans[i].hi = num_hashes * (i + 1) / DEDUP_SCAN_RANGES;
+        }
+        rc = find_duplicates(&job, scans, DEDUP_SCAN_RANGES, workers, min_score, min_similarity,
+                             out, count, stats);
+    }
+    if (scans) job_close(&job);
+    free(scans);
+    return rc;
+}
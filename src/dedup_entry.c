@@ -0,0 +1,110 @@
+// File: src/dedup_entry.c
+// Command-line front end: list catalog songs that duplicate each other.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "db.h"
+#include "mmap_index.h"
+#include "thread_pool.h"
+#include "dedup.h"
+
+#define MAX_NAME_LEN 256
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--index PATH] [--threads N] [--spill DIR] [--min-score N]\n"
+            "          [--min-similarity F]\n"
+            "  (default)          scan the SQLite catalog at %s\n"
+            "  --index PATH       scan a memory-mapped index built with song_entry --index\n"
+            "  --threads N        scanning and counting threads (default %d)\n"
+            "  --spill DIR        directory for the temporary vote files (default data)\n"
+            "  --min-score N      shared time-aligned hashes needed (default %d)\n"
+            "  --min-similarity F fraction of the shorter song's hashes needed (default %.2f)\n",
+            prog, DB_PATH, DB_READ_POOL_SIZE, DEDUP_MIN_SCORE, DEDUP_MIN_SIMILARITY);
+}
+
+int main(int argc, char** argv) {
+    const char* index_path = NULL;
+    const char* spill_dir = "data";
+    int num_threads = DB_READ_POOL_SIZE, min_score = DEDUP_MIN_SCORE;
+    float min_similarity = DEDUP_MIN_SIMILARITY;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spill") == 0 && i + 1 < argc) {
+            spill_dir = argv[++i];
+        } else if (strcmp(argv[i], "--min-score") == 0 && i + 1 < argc) {
+            min_score = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-similarity") == 0 && i + 1 < argc) {
+            min_similarity = (float)atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (num_threads <= 0 || min_score <= 0 || min_similarity < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Song names always come from the main DB
+    db_ctx* db = db_open_ctx(DB_PATH, DB_CTX_READONLY);
+    if (!db) {
+        fprintf(stderr, "Failed to open catalog at %s\n", DB_PATH);
+        return 1;
+    }
+
+    MmapIndex* mmap_index = index_path ? mmap_index_open(index_path) : NULL;
+    db_pool* pool = index_path ? NULL : db_pool_open(DB_PATH, num_threads);
+    ThreadPool* workers = thread_pool_create(num_threads);
+    DuplicatePair* pairs = NULL;
+    DedupStats stats;
+    int count = 0, rc = 1;
+
+    if ((mmap_index || pool) && workers) {
+        double start = now_ms();
+        rc = mmap_index ? dedup_find_mmap(mmap_index, workers, spill_dir, min_score, min_similarity,
+                                          &pairs, &count, &stats)
+                        : dedup_find_db(pool, workers, spill_dir, min_score, min_similarity,
+                                        &pairs, &count, &stats);
+        double elapsed = now_ms() - start;
+
+        if (rc == 0) {
+            printf("Scanned %lld postings (%lld lists skipped), %lld pair votes, %.1f MiB spilled, %.1f s\n",
+                   stats.postings, stats.lists_skipped, stats.votes,
+                   stats.spill_bytes / (1024.0 * 1024.0), elapsed / 1000.0);
+            printf("%d duplicate pair(s)\n", count);
+        }
+        for (int i = 0; i < count; i++) {
+            char name_a[MAX_NAME_LEN] = "?", artist_a[MAX_NAME_LEN] = "?";
+            char name_b[MAX_NAME_LEN] = "?", artist_b[MAX_NAME_LEN] = "?";
+            db_get_song(db, pairs[i].song_a, name_a, sizeof(name_a), artist_a, sizeof(artist_a));
+            db_get_song(db, pairs[i].song_b, name_b, sizeof(name_b), artist_b, sizeof(artist_b));
+            printf("  score=%d  similarity=%.2f  offset=%.2fs  %s - %s (id=%d)  <->  %s - %s (id=%d)\n",
+                   pairs[i].score, pairs[i].similarity, (float)pairs[i].offset * HOP_SIZE / SAMPLE_RATE,
+                   artist_a, name_a, pairs[i].song_a, artist_b, name_b, pairs[i].song_b);
+        }
+        rc = rc == 0 ? 0 : 1;
+    } else {
+        fprintf(stderr, "Failed to open the fingerprint index.\n");
+    }
+
+    free(pairs);
+    thread_pool_destroy(workers);
+    db_pool_close(pool);
+    mmap_index_close(mmap_index);
+    db_close_ctx(db);
+    return rc;
+}
@@ -0,0 +1,200 @@
+// File: src/fingerprint_blob.c
+// Varint-delta wire format for query fingerprints computed on the client.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "matcher.h"
+#include "fingerprint_blob.h"
+
+#define HEADER_BYTES 5          // Magic + schema
+#define MAX_VARINT_BYTES 10
+
+// Hash layout 2 leaves bits 27-0 zero (see hashing.c); they are not sent
+#if HASH_LAYOUT_VERSION != 2
+#error "Update HASH_LOW_BITS for the new hash layout"
+#endif
+#define HASH_LOW_BITS 28
+
+// ===========================
+// Varints
+// ===========================
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Bounded read for untrusted input. Returns bytes consumed, or 0 if the
+// varint runs past `end` or is longer than 64 bits.
+static size_t get_varint(const uint8_t* in, const uint8_t* end, uint64_t* v) {
+    uint64_t result = 0;
+    size_t n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (in + n >= end) return 0;
+        uint8_t byte = in[n++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *v = result;
+            return n;
+        }
+    }
+    return 0;
+}
+
+// ===========================
+// Encoding
+// ===========================
+
+static int compare_hash_time(const void* a, const void* b) {
+    const FingerprintHash64* x = (const FingerprintHash64*)a;
+    const FingerprintHash64* y = (const FingerprintHash64*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
+}
+
+size_t fingerprint_blob_max_size(size_t n) {
+    return HEADER_BYTES + 3 * MAX_VARINT_BYTES + n * 2 * MAX_VARINT_BYTES;
+}
+
+int fingerprint_blob_encode(const FingerprintHash64* hashes, int count,
+                            uint8_t** out, size_t* out_bytes) {
+    if ((!hashes && count > 0) || count < 0 || !out || !out_bytes) {
+        fprintf(stderr, "Invalid input to fingerprint_blob_encode.\n");
+        return -1;
+    }
+    *out = NULL;
+    *out_bytes = 0;
+
+    // generate_fingerprint_hashes already emits (hash, time) order; sort a copy otherwise
+    const FingerprintHash64* sorted = hashes;
+    FingerprintHash64* copy = NULL;
+    for (int i = 0; i < count; i++) {
+        if (hashes[i].time_offset < 0 || (hashes[i].hash & ((1ULL << HASH_LOW_BITS) - 1))) {
+            fprintf(stderr, "Fingerprint blob input is not a query fingerprint.\n");
+            return -1;
+        }
+        if (i > 0 && !copy && compare_hash_time(&hashes[i - 1], &hashes[i]) > 0) {
+            copy = (FingerprintHash64*)malloc(count * sizeof(FingerprintHash64));
+            if (!copy) {
+                fprintf(stderr, "Memory allocation failed for fingerprint blob.\n");
+                return -1;
+            }
+            memcpy(copy, hashes, count * sizeof(FingerprintHash64));
+            qsort(copy, count, sizeof(FingerprintHash64), compare_hash_time);
+            sorted = copy;
+        }
+    }
+
+    uint8_t* blob = (uint8_t*)malloc(fingerprint_blob_max_size((size_t)count));
+    if (!blob) {
+        fprintf(stderr, "Memory allocation failed for fingerprint blob.\n");
+        free(copy);
+        return -1;
+    }
+
+    uint32_t magic = FINGERPRINT_BLOB_MAGIC;
+    for (int b = 0; b < 4; b++) blob[b] = (uint8_t)(magic >> (8 * b));
+    blob[4] = HASH_LAYOUT_VERSION;
+    size_t n = HEADER_BYTES;
+    n += put_varint(blob + n, SAMPLE_RATE);
+    n += put_varint(blob + n, HOP_SIZE);
+    n += put_varint(blob + n, (uint64_t)count);
+
+    uint64_t prev_hash = 0;
+    int prev_time = 0;
+    for (int i = 0; i < count; i++) {
+        const FingerprintHash64* h = &sorted[i];
+        int same = i > 0 && h->hash == prev_hash;
+        n += put_varint(blob + n, (h->hash - prev_hash) >> HASH_LOW_BITS);
+        n += put_varint(blob + n, (uint64_t)(same ? h->time_offset - prev_time : h->time_offset));
+        prev_hash = h->hash;
+        prev_time = h->time_offset;
+    }
+    free(copy);
+
+    uint8_t* shrunk = realloc(blob, n);
+    *out = shrunk ? shrunk : blob;
+    *out_bytes = n;
+    return 0;
+}
+
+// ===========================
+// Decoding
+// ===========================
+
+int fingerprint_blob_decode(const uint8_t* blob, size_t bytes,
+                            FingerprintHash64** out, int* count) {
+    *out = NULL;
+    *count = 0;
+    if (!blob || bytes < HEADER_BYTES) return -1;
+
+    uint32_t magic = 0;
+    for (int b = 0; b < 4; b++) magic |= (uint32_t)blob[b] << (8 * b);
+    if (magic != FINGERPRINT_BLOB_MAGIC || blob[4] != HASH_LAYOUT_VERSION) return -1;
+
+    const uint8_t* p = blob + HEADER_BYTES;
+    const uint8_t* end = blob + bytes;
+    uint64_t sample_rate, hop_size, n;
+    size_t used;
+    if (!(used = get_varint(p, end, &sample_rate))) return -1;
+    p += used;
+    if (!(used = get_varint(p, end, &hop_size))) return -1;
+    p += used;
+    if (!(used = get_varint(p, end, &n))) return -1;
+    p += used;
+
+    // Frame offsets only line up with the catalog at the same rate and hop;
+    // each entry takes at least two bytes, which bounds n before allocating
+    if (sample_rate != SAMPLE_RATE || hop_size != HOP_SIZE || n > (uint64_t)(end - p) / 2)
+        return -1;
+    if (n == 0) return p == end ? 0 : -1;
+
+    FingerprintHash64* hashes = (FingerprintHash64*)calloc((size_t)n, sizeof(FingerprintHash64));
+    if (!hashes) return -2;
+
+    uint64_t hash = 0;          // Shifted right by HASH_LOW_BITS
+    uint64_t time = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t gap, value;
+        if (!(used = get_varint(p, end, &gap))) break;
+        p += used;
+        if (!(used = get_varint(p, end, &value))) break;
+        p += used;
+
+        if (i > 0 && gap == 0) value += time;
+        if (value > INT32_MAX || gap >> (64 - HASH_LOW_BITS)) break;
+        hash += gap;
+        time = value;
+        hashes[i].hash = hash << HASH_LOW_BITS;
+        hashes[i].time_offset = (int)time;
+        *count = (int)(i + 1);
+    }
+
+    if ((uint64_t)*count != n || p != end) {
+        free(hashes);
+        *count = 0;
+        return -1;
+    }
+    *out = hashes;
+    return 0;
+}
+
+int fingerprint_blob_from_samples(const float* samples, int num_samples, int sample_rate,
+                                  uint8_t** out, size_t* out_bytes) {
+    FingerprintHash64* hashes = NULL;
+    int count = 0;
+    if (query_fingerprint_samples(samples, num_samples, sample_rate, &hashes, &count) != 0)
+        return -1;
+
+    int rc = fingerprint_blob_encode(hashes, count, out, out_bytes);
+    free(hashes);
+    return rc;
+}
@@ -0,0 +1,196 @@
+// File: src/fingerprint_index.c
+// Adapters from each catalog backend to the FingerprintIndex interface.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "fingerprint_index.h"
+
+// ===========================
+// SQLite
+// ===========================
+
+static size_t db_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    int max_out = scratch_cap > INT_MAX ? INT_MAX : (int)scratch_cap;
+    int n = db_lookup_hash((db_ctx*)impl, hash, scratch, max_out);
+    if (n <= 0) {
+        *out = NULL;
+        return 0;
+    }
+    *out = (size_t)n <= scratch_cap ? scratch : NULL;
+    return (size_t)n;
+}
+
+static size_t db_count(void* impl, uint64_t hash, size_t cap) {
+    int n = db_count_hash((db_ctx*)impl, hash, cap >= INT_MAX ? INT_MAX - 1 : (int)cap);
+    return n > 0 ? (size_t)n : 0;
+}
+
+static int db_generation(void* impl, int64_t* out) {
+    return db_get_generation((db_ctx*)impl, out);
+}
+
+FingerprintIndex fingerprint_index_from_db(db_ctx* ctx) {
+    FingerprintIndex index = { ctx, db_lookup, db_count, NULL, 0, db_generation };
+    return index;
+}
+
+static size_t pool_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    db_ctx* ctx = db_pool_acquire((db_pool*)impl);
+    if (!ctx) {
+        *out = NULL;
+        return 0;
+    }
+    size_t n = db_lookup(ctx, hash, scratch, scratch_cap, out);
+    db_pool_release((db_pool*)impl, ctx);
+    return n;
+}
+
+static size_t pool_count(void* impl, uint64_t hash, size_t cap) {
+    db_ctx* ctx = db_pool_acquire((db_pool*)impl);
+    if (!ctx) return 0;
+    size_t n = db_count(ctx, hash, cap);
+    db_pool_release((db_pool*)impl, ctx);
+    return n;
+}
+
+// Also re-validates the pool's filter, which only covers one generation.
+static int pool_generation(void* impl, int64_t* out) {
+    db_ctx* ctx = db_pool_acquire((db_pool*)impl);
+    if (!ctx) return -1;
+    int rc = db_get_generation(ctx, out);
+    db_pool_release((db_pool*)impl, ctx);
+    if (rc == 0) db_pool_sync_filter((db_pool*)impl, *out);
+    return rc;
+}
+
+FingerprintIndex fingerprint_index_from_pool(db_pool* pool) {
+    FingerprintIndex index = { pool, pool_lookup, pool_count, NULL, 1, pool_generation };
+    return index;
+}
+
+// ===========================
+// Memory-mapped file
+// ===========================
+
+static size_t mmap_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    (void)scratch;
+    (void)scratch_cap;
+    return mmap_index_lookup((const MmapIndex*)impl, hash, out);
+}
+
+static size_t mmap_count(void* impl, uint64_t hash, size_t cap) {
+    (void)cap;
+    const Posting* p;
+    return mmap_index_lookup((const MmapIndex*)impl, hash, &p);
+}
+
+FingerprintIndex fingerprint_index_from_mmap(MmapIndex* index) {
+    FingerprintIndex fi = { index, mmap_lookup, mmap_count, NULL, 1, NULL };
+    return fi;
+}
+
+// ===========================
+// In-memory hash table
+// ===========================
+
+static size_t hash_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    (void)scratch;
+    (void)scratch_cap;
+    return hash_index_lookup((const HashIndex*)impl, hash, out);
+}
+
+static size_t hash_count(void* impl, uint64_t hash, size_t cap) {
+    (void)cap;
+    const Posting* p;
+    return hash_index_lookup((const HashIndex*)impl, hash, &p);
+}
+
+static int hash_lookup_batch(void* impl, const uint64_t* hashes, size_t n, PostingList* out) {
+    hash_index_lookup_batch((const HashIndex*)impl, hashes, n, out);
+    return 0;
+}
+
+FingerprintIndex fingerprint_index_from_hash(HashIndex* index) {
+    FingerprintIndex fi = { index, hash_lookup, hash_count, hash_lookup_batch, 1, NULL };
+    return fi;
+}
+
+// ===========================
+// Compressed in-memory index
+// ===========================
+
+static size_t compressed_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    const CompressedIndex* index = (const CompressedIndex*)impl;
+    size_t n = compressed_index_count(index, hash);
+    if (n == 0 || n > scratch_cap) {
+        *out = NULL;
+        return n;
+    }
+    *out = scratch;
+    return compressed_index_lookup(index, hash, scratch);
+}
+
+static size_t compressed_count(void* impl, uint64_t hash, size_t cap) {
+    (void)cap;
+    return compressed_index_count((const CompressedIndex*)impl, hash);
+}
+
+FingerprintIndex fingerprint_index_from_compressed(CompressedIndex* index) {
+    FingerprintIndex fi = { index, compressed_lookup, compressed_count, NULL, 1, NULL };
+    return fi;
+}
+
+// ===========================
+// Shards
+// ===========================
+
+static size_t shards_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    (void)scratch;
+    (void)scratch_cap;
+    PostingList list;
+    if (shard_set_lookup_batch((ShardSet*)impl, &hash, 1, &list) != 0) {
+        *out = NULL;
+        return 0;
+    }
+    *out = list.postings;
+    return list.count;
+}
+
+static size_t shards_count(void* impl, uint64_t hash, size_t cap) {
+    int n = shard_set_count((ShardSet*)impl, hash, cap >= INT_MAX ? INT_MAX - 1 : (int)cap);
+    return n > 0 ? (size_t)n : 0;
+}
+
+static int shards_lookup_batch(void* impl, const uint64_t* hashes, size_t n, PostingList* out) {
+    return shard_set_lookup_batch((ShardSet*)impl, hashes, n, out);
+}
+
+static int shards_generation(void* impl, int64_t* out) {
+    return shard_set_generation((ShardSet*)impl, out);
+}
+
+FingerprintIndex fingerprint_index_from_shards(ShardSet* set) {
+    FingerprintIndex fi = { set, shards_lookup, shards_count, shards_lookup_batch, 0, shards_generation };
+    return fi;
+}
+
+// ===========================
+// LSM snapshot
+// ===========================
+
+static size_t lsm_lookup(void* impl, uint64_t hash, Posting* scratch, size_t scratch_cap, const Posting** out) {
+    size_t n = lsm_snapshot_lookup((const LsmSnapshot*)impl, hash, scratch, scratch_cap);
+    *out = n > 0 && n <= scratch_cap ? scratch : NULL;
+    return n;
+}
+
+static size_t lsm_count(void* impl, uint64_t hash, size_t cap) {
+    (void)cap;
+    return lsm_snapshot_lookup((const LsmSnapshot*)impl, hash, NULL, 0);
+}
+
+FingerprintIndex fingerprint_index_from_lsm(LsmSnapshot* snapshot) {
+    FingerprintIndex fi = { snapshot, lsm_lookup, lsm_count, NULL, 1, NULL };
+    return fi;
+}
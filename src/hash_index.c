@@ -0,0 +1,246 @@
+// File: src/hash_index.c
+// Cache-line-aligned open-addressing hash index with a contiguous postings arena.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hashing.h"
+#include "hash_index.h"
+#include "bloom.h"
+
+#define SLOTS_PER_BUCKET    4
+#define CACHE_LINE          64
+#define MAX_LOAD_PERCENT    75
+#define START_BITS          40          // Arena offset; count uses the remaining 24 bits
+#define MAX_POSTINGS        (1ULL << START_BITS)
+#define MAX_LIST_LEN        ((1ULL << (64 - START_BITS)) - 1)
+#define PREFETCH_DISTANCE   8
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+typedef struct {
+    uint64_t hash;
+    uint64_t span;              // start | count << START_BITS; 0 marks an empty slot
+} HashSlot;
+
+typedef struct {
+    HashSlot slots[SLOTS_PER_BUCKET];
+} HashBucket;                   // Exactly one cache line
+
+struct HashIndex {
+    HashBucket* buckets;        // Aligned view into bucket_mem
+    void* bucket_mem;
+    uint64_t bucket_mask;       // num_buckets - 1
+    Posting* arena;
+    uint64_t num_postings;
+    uint64_t num_hashes;
+    BloomFilter* filter;        // Absent hashes stop here instead of probing the table
+};
+
+// Collects the sorted scan into the arena plus a list of (hash, span) keys.
+typedef struct {
+    Posting* arena;
+    uint64_t num_postings;
+    uint64_t arena_capacity;
+    HashSlot* keys;
+    uint64_t num_keys;
+    uint64_t key_capacity;
+    int overflow;
+} LoadState;
+
+static int load_record(uint64_t hash, int song_id, int time_offset, void* user) {
+    LoadState* st = (LoadState*)user;
+
+    if (st->num_postings == st->arena_capacity) {
+        uint64_t capacity = st->arena_capacity ? st->arena_capacity * 2 : 1 << 16;
+        Posting* arena = realloc(st->arena, capacity * sizeof(Posting));
+        if (!arena) return -1;
+        st->arena = arena;
+        st->arena_capacity = capacity;
+    }
+
+    HashSlot* last = st->num_keys ? &st->keys[st->num_keys - 1] : NULL;
+    if (last && last->hash == hash) {
+        if ((last->span >> START_BITS) == MAX_LIST_LEN) {
+            st->overflow = 1;
+            return -1;
+        }
+        last->span += 1ULL << START_BITS;
+    } else {
+        if (st->num_postings >= MAX_POSTINGS) {
+            st->overflow = 1;
+            return -1;
+        }
+        if (st->num_keys == st->key_capacity) {
+            uint64_t capacity = st->key_capacity ? st->key_capacity * 2 : 1 << 14;
+            HashSlot* keys = realloc(st->keys, capacity * sizeof(HashSlot));
+            if (!keys) return -1;
+            st->keys = keys;
+            st->key_capacity = capacity;
+        }
+        st->keys[st->num_keys++] = (HashSlot){ hash, st->num_postings | (1ULL << START_BITS) };
+    }
+
+    st->arena[st->num_postings++] = (Posting){ song_id, time_offset };
+    return 0;
+}
+
+static inline uint64_t bucket_of(const HashIndex* index, uint64_t hash) {
+    return mix_hash64(hash) & index->bucket_mask;
+}
+
+static void insert_slot(HashIndex* index, HashSlot slot) {
+    uint64_t b = bucket_of(index, slot.hash);
+    for (;;) {
+        HashBucket* bucket = &index->buckets[b];
+        for (int s = 0; s < SLOTS_PER_BUCKET; s++) {
+            if (bucket->slots[s].span == 0) {
+                bucket->slots[s] = slot;
+                return;
+            }
+        }
+        b = (b + 1) & index->bucket_mask;  // Linear probing over buckets
+    }
+}
+
+HashIndex* hash_index_load_from_db(db_ctx* ctx) {
+    LoadState st;
+    memset(&st, 0, sizeof(st));
+
+    if (db_scan_fingerprints(ctx, load_record, &st) != 0) {
+        fprintf(stderr, st.overflow ? "Fingerprint catalog exceeds hash index limits.\n"
+                                    : "Failed to load fingerprints into hash index.\n");
+        free(st.arena);
+        free(st.keys);
+        return NULL;
+    }
+
+    HashIndex* index = (HashIndex*)calloc(1, sizeof(HashIndex));
+    if (!index) {
+        free(st.arena);
+        free(st.keys);
+        return NULL;
+    }
+
+    uint64_t num_buckets = 1;
+    while (num_buckets * SLOTS_PER_BUCKET * MAX_LOAD_PERCENT / 100 < st.num_keys + 1)
+        num_buckets <<= 1;
+
+    // Over-allocate and align by hand; aligned_alloc is not available everywhere
+    index->bucket_mem = calloc(1, num_buckets * sizeof(HashBucket) + CACHE_LINE);
+    if (!index->bucket_mem) {
+        fprintf(stderr, "Memory allocation failed for hash index table.\n");
+        free(st.arena);
+        free(st.keys);
+        free(index);
+        return NULL;
+    }
+    uintptr_t addr = ((uintptr_t)index->bucket_mem + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+    index->buckets = (HashBucket*)addr;
+    index->bucket_mask = num_buckets - 1;
+
+    index->filter = bloom_create(st.num_keys);
+    if (!index->filter) {
+        fprintf(stderr, "Memory allocation failed for hash index filter.\n");
+        free(st.arena);
+        free(st.keys);
+        free(index->bucket_mem);
+        free(index);
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < st.num_keys; i++) {
+        insert_slot(index, st.keys[i]);
+        bloom_add(index->filter, st.keys[i].hash);
+    }
+    free(st.keys);
+
+    // Trim the arena to its final size
+    Posting* arena = st.num_postings ? realloc(st.arena, st.num_postings * sizeof(Posting)) : st.arena;
+    index->arena = arena ? arena : st.arena;
+    index->num_postings = st.num_postings;
+    index->num_hashes = st.num_keys;
+
+    printf("Hash index loaded: %llu hashes, %llu postings, %.1f MiB.\n",
+           (unsigned long long)index->num_hashes, (unsigned long long)index->num_postings,
+           hash_index_memory_usage(index) / (1024.0 * 1024.0));
+    return index;
+}
+
+void hash_index_free(HashIndex* index) {
+    if (!index) return;
+    free(index->bucket_mem);
+    free(index->arena);
+    bloom_free(index->filter);
+    free(index);
+}
+
+// Table probe without the filter check.
+static size_t probe(const HashIndex* index, uint64_t hash, const Posting** out) {
+    uint64_t b = bucket_of(index, hash);
+    for (;;) {
+        const HashBucket* bucket = &index->buckets[b];
+        for (int s = 0; s < SLOTS_PER_BUCKET; s++) {
+            const HashSlot* slot = &bucket->slots[s];
+            if (slot->span == 0) {
+                *out = NULL;
+                return 0;
+            }
+            if (slot->hash == hash) {
+                *out = index->arena + (slot->span & (MAX_POSTINGS - 1));
+                return (size_t)(slot->span >> START_BITS);
+            }
+        }
+        b = (b + 1) & index->bucket_mask;
+    }
+}
+
+size_t hash_index_lookup(const HashIndex* index, uint64_t hash, const Posting** out) {
+    if (!bloom_may_contain(index->filter, hash)) {
+        *out = NULL;
+        return 0;
+    }
+    return probe(index, hash, out);
+}
+
+void hash_index_lookup_batch(const HashIndex* index, const uint64_t* hashes, size_t n, PostingList* out) {
+    // Pass 1: filter the whole query (the filter is small and mostly cached);
+    // out[i].count temporarily flags the hashes that may be present.
+    for (size_t i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n)
+            bloom_prefetch(index->filter, hashes[i + PREFETCH_DISTANCE]);
+        out[i].postings = NULL;
+        out[i].count = (size_t)bloom_may_contain(index->filter, hashes[i]);
+    }
+
+    // Pass 2: probe the survivors, prefetching home buckets a few lookups ahead
+    for (size_t i = 0; i < n && i < PREFETCH_DISTANCE; i++)
+        if (out[i].count) PREFETCH(&index->buckets[bucket_of(index, hashes[i])]);
+
+    for (size_t i = 0; i < n; i++) {
+        if (i + PREFETCH_DISTANCE < n && out[i + PREFETCH_DISTANCE].count)
+            PREFETCH(&index->buckets[bucket_of(index, hashes[i + PREFETCH_DISTANCE])]);
+        if (out[i].count)
+            out[i].count = probe(index, hashes[i], &out[i].postings);
+    }
+}
+
+uint64_t hash_index_num_hashes(const HashIndex* index) {
+    return index->num_hashes;
+}
+
+uint64_t hash_index_num_postings(const HashIndex* index) {
+    return index->num_postings;
+}
+
+size_t hash_index_memory_usage(const HashIndex* index) {
+    return sizeof(HashIndex) +
+           (size_t)(index->bucket_mask + 1) * sizeof(HashBucket) + CACHE_LINE +
+           (size_t)index->num_postings * sizeof(Posting) +
+           bloom_size_bytes(index->filter);
+}
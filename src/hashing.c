@@ -18,26 +18,63 @@ static inline int encode_delta_freq(int df) {
     return df & 0x3F;
 }
 
-// Create a 64-bit hash with optimized bit allocation
-static uint64_t generate_hash64(int a_freq, int delta_f, int dt, int a_time, uint8_t mag_q) {
+// Create a 64-bit hash with optimized bit allocation. The anchor time is not part
+// of the hash (it travels separately as time_offset), so the same landmark pair
+// hashes identically wherever it occurs in a song or a query clip.
+static uint64_t generate_hash64(int a_freq, int delta_f, int dt, uint8_t mag_q) {
     return  (((uint64_t)(a_freq   & 0x3FF))   << 54) |  // bits 63–54: anchor freq (10 bits)
             (((uint64_t)(delta_f  & 0x3F))    << 48) |  // bits 53–48: delta freq (6 bits)
             (((uint64_t)(dt       & 0xFFF))   << 36) |  // bits 47–36: delta time (12 bits)
-            (((uint64_t)(mag_q    & 0xFF))    << 28) |  // bits 35–28: magnitude byte (8 bits)
-            (((uint64_t)(a_time   & 0xFFFFF)) << 8);    // bits 27–8: anchor time (20 bits)
-            // bits 7–0: reserved (unused)
+            (((uint64_t)(mag_q    & 0xFF))    << 28);   // bits 35–28: magnitude byte (8 bits)
+            // bits 27–0: reserved (unused)
+}
+
+int hash_peak_pair(const Peak* anchor, const Peak* target, uint64_t* out) {
+    int af = anchor->freq_bin;
+    int tf = target->freq_bin;
+    int dt = target->time_index - anchor->time_index;
+
+    if (af > MAX_FREQ_BIN || tf > MAX_FREQ_BIN) return 0;
+    if (dt <= 0 || dt > MAX_TIME_DELTA) return 0;
+
+    int df = tf - af;
+    if (df < -32 || df > 31) return 0;  // signed 6-bit range check
+
+    // Pack both magnitudes into a byte: high nibble = anchor, low = target
+    uint8_t aq = quantize_mag(anchor->magnitude);
+    uint8_t tq = quantize_mag(target->magnitude);
+    uint8_t mag_byte = ((aq >> 4) << 4) | ((tq >> 4) & 0x0F);
+
+    *out = generate_hash64(af, encode_delta_freq(df), dt, mag_byte);
+    return 1;
+}
+
+static int compare_hash_time(const void* a, const void* b) {
+    const FingerprintHash64* x = (const FingerprintHash64*)a;
+    const FingerprintHash64* y = (const FingerprintHash64*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
 }
 
 FingerprintHash64* generate_fingerprint_hashes(const Peak* peaks,
                                               int num_peaks,
                                               int song_id,
                                               int* out_count) {
-    if (!peaks || num_peaks <= 0 || !out_count) {
+    return generate_fingerprint_hashes_fan(peaks, num_peaks, song_id, FAN_VALUE, out_count);
+}
+
+FingerprintHash64* generate_fingerprint_hashes_fan(const Peak* peaks,
+                                                  int num_peaks,
+                                                  int song_id,
+                                                  int fan_value,
+                                                  int* out_count) {
+    if (!peaks || num_peaks <= 0 || fan_value <= 0 || !out_count) {
         fprintf(stderr, "Error: invalid input to generate_fingerprint_hashes\n");
         return NULL;
     }
 
-    int capacity = num_peaks * FAN_VALUE;
+    int capacity = num_peaks * fan_value;
     FingerprintHash64* list = malloc(capacity * sizeof(*list));
     if (!list) {
         perror("malloc");
@@ -46,35 +83,14 @@ FingerprintHash64* generate_fingerprint_hashes(const Peak* peaks,
 
     int n = 0;
     for (int i = 0; i < num_peaks; ++i) {
-        int af = peaks[i].freq_bin;
         int at = peaks[i].time_index;
-        float am = peaks[i].magnitude;
-        uint8_t aq = quantize_mag(am);
 
-        if (af > MAX_FREQ_BIN || at > MAX_TIME) continue;
-
-        for (int j = 1; j <= FAN_VALUE; ++j) {
+        for (int j = 1; j <= fan_value; ++j) {
             int k = i + j;
             if (k >= num_peaks) break;
 
-            int tf = peaks[k].freq_bin;
-            int tt = peaks[k].time_index;
-            int dt = tt - at;
-            float tm = peaks[k].magnitude;
-            uint8_t tq = quantize_mag(tm);
-
-            if (dt <= 0 || dt > MAX_TIME_DELTA) continue;
-            if (tf > MAX_FREQ_BIN) continue;
-
-            int df = tf - af;
-            if (df < -32 || df > 31) continue;  // signed 6-bit range check
-
-            int df_encoded = encode_delta_freq(df);
-
-            // Pack both magnitudes into a byte: high nibble = anchor, low = target
-            uint8_t mag_byte = ((aq >> 4) << 4) | ((tq >> 4) & 0x0F);
-
-            uint64_t h = generate_hash64(af, df_encoded, dt, at, mag_byte);
+            uint64_t h;
+            if (!hash_peak_pair(&peaks[i], &peaks[k], &h)) continue;
             list[n++] = (FingerprintHash64){ .hash = h,
                                              .time_offset = at,
                                              .song_id = song_id };
@@ -92,21 +108,14 @@ FingerprintHash64* generate_fingerprint_hashes(const Peak* peaks,
         }
     }
 
-    // Deduplicate (in-place): same hash + time_offset
+    // Deduplicate (in-place): same hash + time_offset. Sorting keeps this
+    // O(n log n); the output is ordered by (hash, time_offset).
+    qsort(list, n, sizeof(*list), compare_hash_time);
     int w = 0;
     for (int r = 0; r < n; ++r) {
-        uint64_t h = list[r].hash;
-        int to = list[r].time_offset;
-        int dup = 0;
-        for (int t = 0; t < w; ++t) {
-            if (list[t].hash == h && list[t].time_offset == to) {
-                dup = 1;
-                break;
-            }
-        }
-        if (!dup) {
-            list[w++] = list[r];
-        }
+        if (w > 0 && list[w - 1].hash == list[r].hash && list[w - 1].time_offset == list[r].time_offset)
+            continue;
+        list[w++] = list[r];
     }
 
     *out_count = w;
@@ -0,0 +1,613 @@
+// File: src/lsm_index.c
+// Segmented (LSM-style) fingerprint index with size-tiered background compaction.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "config.h"
+#include "mmap_index.h"
+#include "lsm_index.h"
+
+#define MAX_PATH_LEN    1024
+#define MANIFEST_NAME   "MANIFEST"
+
+typedef struct {
+    uint64_t id;
+    char path[MAX_PATH_LEN];
+    MmapIndex* index;
+    uint64_t num_postings;
+    int tier;
+    int refs;                   // Snapshots holding this segment (guarded by LsmIndex.lock)
+    int obsolete;               // Merged away; delete the file when refs reaches 0
+} Segment;
+
+struct LsmSnapshot {
+    Segment** segments;         // Oldest first
+    int num_segments;
+    int refs;                   // Current-pointer + readers (guarded by LsmIndex.lock)
+};
+
+struct LsmIndex {
+    char dir[MAX_PATH_LEN];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t compactor;
+    int readonly;
+    int stopping;
+
+    LsmSnapshot* current;
+    uint64_t next_id;
+
+    FingerprintHash64* memtable;
+    int mem_count;
+    int mem_capacity;
+};
+
+// ===========================
+// Segments and snapshots
+// ===========================
+
+static int tier_of(uint64_t num_postings) {
+    int tier = 0;
+    uint64_t threshold = LSM_MEMTABLE_RECORDS;
+    while (num_postings > threshold) {
+        tier++;
+        threshold *= LSM_TIER_FANOUT;
+    }
+    return tier;
+}
+
+// Returns 0, or -1 if the path does not fit MAX_PATH_LEN.
+static int segment_path(const LsmIndex* index, uint64_t id, char* out) {
+    int n = snprintf(out, MAX_PATH_LEN, "%s/seg_%08llu.idx", index->dir, (unsigned long long)id);
+    if (n < 0 || n >= MAX_PATH_LEN) {
+        fprintf(stderr, "LSM: segment path too long in %s\n", index->dir);
+        return -1;
+    }
+    return 0;
+}
+
+static Segment* open_segment(const LsmIndex* index, uint64_t id) {
+    Segment* seg = (Segment*)calloc(1, sizeof(Segment));
+    if (!seg) return NULL;
+
+    seg->id = id;
+    if (segment_path(index, id, seg->path) == 0)
+        seg->index = mmap_index_open(seg->path);
+    if (!seg->index) {
+        free(seg);
+        return NULL;
+    }
+    seg->num_postings = mmap_index_num_postings(seg->index);
+    seg->tier = tier_of(seg->num_postings);
+    return seg;
+}
+
+// Caller holds the lock.
+static LsmSnapshot* snapshot_create(Segment** segments, int n) {
+    LsmSnapshot* snap = (LsmSnapshot*)calloc(1, sizeof(LsmSnapshot));
+    if (!snap) return NULL;
+
+    snap->segments = (Segment**)malloc((n > 0 ? n : 1) * sizeof(Segment*));
+    if (!snap->segments) {
+        free(snap);
+        return NULL;
+    }
+    memcpy(snap->segments, segments, n * sizeof(Segment*));
+    snap->num_segments = n;
+    snap->refs = 1;
+    for (int i = 0; i < n; i++) segments[i]->refs++;
+    return snap;
+}
+
+// Caller holds the lock.
+static void snapshot_unref(LsmSnapshot* snap) {
+    if (--snap->refs > 0) return;
+
+    for (int i = 0; i < snap->num_segments; i++) {
+        Segment* seg = snap->segments[i];
+        if (--seg->refs > 0) continue;
+        mmap_index_close(seg->index);
+        if (seg->obsolete) remove(seg->path);
+        free(seg);
+    }
+    free(snap->segments);
+    free(snap);
+}
+
+static int sync_file(FILE* f) {
+    if (fflush(f) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0 ? 0 : -1;
+#else
+    return fsync(fileno(f)) == 0 ? 0 : -1;
+#endif
+}
+
+// Make created, renamed and removed entries in `dir` durable. No-op on Windows.
+static int sync_dir(const char* dir) {
+#ifdef _WIN32
+    (void)dir;
+    return 0;
+#else
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+// Atomically replace the manifest. Segment files it lists were fsynced by
+// mmap_index_writer_finish; the directory sync before the rename makes their
+// entries durable, the one after makes the new manifest durable.
+static int write_manifest(const LsmIndex* index, const LsmSnapshot* snap) {
+    char path[MAX_PATH_LEN], tmp[MAX_PATH_LEN];
+    int n = snprintf(path, sizeof(path), "%s/%s", index->dir, MANIFEST_NAME);
+    int m = snprintf(tmp, sizeof(tmp), "%s/%s.tmp", index->dir, MANIFEST_NAME);
+    if (n < 0 || n >= (int)sizeof(path) || m < 0 || m >= (int)sizeof(tmp)) {
+        fprintf(stderr, "LSM: manifest path too long in %s\n", index->dir);
+        return -1;
+    }
+
+    FILE* f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "Error writing LSM manifest: %s\n", tmp);
+        return -1;
+    }
+    for (int i = 0; i < snap->num_segments; i++)
+        fprintf(f, "%llu\n", (unsigned long long)snap->segments[i]->id);
+    int rc = sync_file(f);
+    if (fclose(f) != 0 || rc != 0 || sync_dir(index->dir) != 0) {
+        fprintf(stderr, "Error writing LSM manifest: %s\n", tmp);
+        remove(tmp);
+        return -1;
+    }
+
+#ifdef _WIN32
+    remove(path);  // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp, path) != 0) return -1;
+    return sync_dir(index->dir);
+}
+
+// Swap in a new segment list. Caller holds the lock.
+static int publish(LsmIndex* index, Segment** segments, int n) {
+    LsmSnapshot* snap = snapshot_create(segments, n);
+    if (!snap) return -1;
+
+    if (!index->readonly && write_manifest(index, snap) != 0) {
+        snapshot_unref(snap);
+        return -1;
+    }
+
+    LsmSnapshot* old = index->current;
+    index->current = snap;
+    if (old) snapshot_unref(old);
+    return 0;
+}
+
+// ===========================
+// Compaction
+// ===========================
+
+static int compare_posting(const void* a, const void* b) {
+    const Posting* x = (const Posting*)a;
+    const Posting* y = (const Posting*)b;
+    if (x->song_id != y->song_id) return x->song_id < y->song_id ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
+}
+
+// K-way merge of whole segments into a new segment file.
+static int merge_segments(Segment** inputs, int k, const char* out_path) {
+    MmapIndexWriter* w = mmap_index_writer_open(out_path);
+    if (!w) return -1;
+
+    uint64_t cursor[LSM_TIER_FANOUT];
+    memset(cursor, 0, sizeof(cursor));
+    Posting* merged = NULL;
+    size_t merged_capacity = 0;
+    int rc = 0;
+
+    for (;;) {
+        // Smallest current hash across inputs
+        int have = 0;
+        uint64_t min_hash = 0;
+        for (int s = 0; s < k; s++) {
+            if (cursor[s] >= mmap_index_num_hashes(inputs[s]->index)) continue;
+            uint64_t h = mmap_index_hash_at(inputs[s]->index, cursor[s]);
+            if (!have || h < min_hash) min_hash = h;
+            have = 1;
+        }
+        if (!have) break;
+
+        size_t total = 0;
+        for (int s = 0; s < k; s++) {
+            if (cursor[s] >= mmap_index_num_hashes(inputs[s]->index) ||
+                mmap_index_hash_at(inputs[s]->index, cursor[s]) != min_hash)
+                continue;
+
+            const Posting* p;
+            size_t n = mmap_index_postings_at(inputs[s]->index, cursor[s], &p);
+            if (total + n > merged_capacity) {
+                size_t capacity = merged_capacity ? merged_capacity : 1024;
+                while (capacity < total + n) capacity *= 2;
+                Posting* buf = realloc(merged, capacity * sizeof(Posting));
+                if (!buf) {
+                    rc = -1;
+                    break;
+                }
+                merged = buf;
+                merged_capacity = capacity;
+            }
+            memcpy(merged + total, p, n * sizeof(Posting));
+            total += n;
+            cursor[s]++;
+        }
+        if (rc != 0) break;
+
+        // Lists from different segments interleave; restore (song_id, time_offset) order
+        qsort(merged, total, sizeof(Posting), compare_posting);
+        for (size_t i = 0; i < total && rc == 0; i++)
+            rc = mmap_index_writer_add(w, min_hash, merged[i].song_id, merged[i].time_offset);
+        if (rc != 0) break;
+    }
+
+    free(merged);
+    if (rc != 0) {
+        mmap_index_writer_abort(w);
+        return -1;
+    }
+    return mmap_index_writer_finish(w);
+}
+
+// Pick LSM_TIER_FANOUT oldest segments of the lowest full tier. Caller holds the lock.
+static int pick_compaction(const LsmSnapshot* snap, Segment** picked) {
+    for (int tier = 0; tier < 64; tier++) {
+        int n = 0;
+        for (int i = 0; i < snap->num_segments && n < LSM_TIER_FANOUT; i++) {
+            if (snap->segments[i]->tier == tier)
+                picked[n++] = snap->segments[i];
+        }
+        if (n == LSM_TIER_FANOUT) return n;
+    }
+    return 0;
+}
+
+static void* compactor_main(void* arg) {
+    LsmIndex* index = (LsmIndex*)arg;
+    Segment* picked[LSM_TIER_FANOUT];
+
+    pthread_mutex_lock(&index->lock);
+    for (;;) {
+        int n = 0;
+        while (!index->stopping && (n = pick_compaction(index->current, picked)) == 0)
+            pthread_cond_wait(&index->wake, &index->lock);
+        if (index->stopping) break;
+
+        // Pin the inputs and merge without holding the lock
+        LsmSnapshot* pin = index->current;
+        pin->refs++;
+        uint64_t id = index->next_id++;
+        pthread_mutex_unlock(&index->lock);
+
+        char path[MAX_PATH_LEN];
+        int rc = segment_path(index, id, path) == 0 ? merge_segments(picked, n, path) : -1;
+        Segment* merged = rc == 0 ? open_segment(index, id) : NULL;
+
+        pthread_mutex_lock(&index->lock);
+        if (!merged) {
+            fprintf(stderr, "LSM compaction failed; retrying on next flush.\n");
+            snapshot_unref(pin);
+            pthread_cond_wait(&index->wake, &index->lock);
+            continue;
+        }
+
+        // Rebuild from the live list: flushes may have added segments meanwhile
+        LsmSnapshot* cur = index->current;
+        Segment** next = (Segment**)malloc((cur->num_segments + 1) * sizeof(Segment*));
+        int m = 0;
+        int inserted = 0;
+        for (int i = 0; next && i < cur->num_segments; i++) {
+            int is_input = 0;
+            for (int j = 0; j < n; j++) is_input |= (cur->segments[i] == picked[j]);
+            if (!is_input) {
+                next[m++] = cur->segments[i];
+            } else if (!inserted) {
+                next[m++] = merged;  // Keep the merged data at the inputs' age position
+                inserted = 1;
+            }
+        }
+
+        if (next && publish(index, next, m) == 0) {
+            for (int j = 0; j < n; j++) picked[j]->obsolete = 1;
+            printf("LSM: merged %d tier-%d segments into seg_%08llu (%llu postings).\n",
+                   n, picked[0]->tier, (unsigned long long)id, (unsigned long long)merged->num_postings);
+        } else {
+            fprintf(stderr, "LSM: failed to publish compacted segment.\n");
+            mmap_index_close(merged->index);
+            remove(merged->path);
+            free(merged);
+        }
+        free(next);
+        snapshot_unref(pin);
+    }
+    pthread_mutex_unlock(&index->lock);
+    return NULL;
+}
+
+// ===========================
+// Open / close
+// ===========================
+
+// Remove segment files left behind by an interrupted flush or compaction.
+static void remove_orphans(const LsmIndex* index) {
+    DIR* dir = opendir(index->dir);
+    if (!dir) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        unsigned long long id;
+        char tail[8];
+        if (sscanf(entry->d_name, "seg_%llu.%7s", &id, tail) != 2) continue;
+
+        // A writer interrupted before its rename leaves seg_N.idx.tmp behind
+        if (strcmp(tail, "idx.tmp") == 0) {
+            char path[MAX_PATH_LEN];
+            if (snprintf(path, sizeof(path), "%s/%s", index->dir, entry->d_name) < (int)sizeof(path))
+                remove(path);
+            continue;
+        }
+        if (strcmp(tail, "idx") != 0) continue;
+
+        int live = 0;
+        for (int i = 0; i < index->current->num_segments; i++)
+            live |= (index->current->segments[i]->id == id);
+        if (!live) {
+            char path[MAX_PATH_LEN];
+            if (segment_path(index, id, path) == 0) remove(path);
+        }
+    }
+    closedir(dir);
+}
+
+LsmIndex* lsm_index_open(const char* dir, int flags) {
+    LsmIndex* index = (LsmIndex*)calloc(1, sizeof(LsmIndex));
+    if (!index) return NULL;
+    // Leave room for the segment and manifest names
+    if (strlen(dir) + sizeof("/seg_00000000.idx") > sizeof(index->dir)) {
+        fprintf(stderr, "LSM: directory path too long: %s\n", dir);
+        free(index);
+        return NULL;
+    }
+    memcpy(index->dir, dir, strlen(dir) + 1);
+    index->readonly = (flags & LSM_OPEN_READONLY) != 0;
+    pthread_mutex_init(&index->lock, NULL);
+    pthread_cond_init(&index->wake, NULL);
+
+    Segment** segments = NULL;
+    int n = 0, capacity = 0;
+    int ok = 1;
+
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", index->dir, MANIFEST_NAME);
+    FILE* f = fopen(path, "r");
+    if (f) {
+        unsigned long long id;
+        while (ok && fscanf(f, "%llu", &id) == 1) {
+            if (n == capacity) {
+                capacity = capacity ? capacity * 2 : 16;
+                Segment** grown = realloc(segments, capacity * sizeof(Segment*));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                segments = grown;
+            }
+            segments[n] = open_segment(index, id);
+            if (!segments[n]) {
+                fprintf(stderr, "LSM: missing segment %llu listed in manifest.\n", id);
+                ok = 0;
+                break;
+            }
+            n++;
+            if (id >= index->next_id) index->next_id = id + 1;
+        }
+        fclose(f);
+    }
+
+    pthread_mutex_lock(&index->lock);
+    if (ok) ok = publish(index, segments, n) == 0;
+    pthread_mutex_unlock(&index->lock);
+
+    if (!ok) {
+        for (int i = 0; i < n; i++) {
+            if (segments[i]->refs == 0) {
+                mmap_index_close(segments[i]->index);
+                free(segments[i]);
+            }
+        }
+        free(segments);
+        if (index->current) snapshot_unref(index->current);
+        pthread_mutex_destroy(&index->lock);
+        pthread_cond_destroy(&index->wake);
+        free(index);
+        return NULL;
+    }
+    free(segments);
+    if (index->readonly) return index;
+    remove_orphans(index);
+
+    if (pthread_create(&index->compactor, NULL, compactor_main, index) != 0) {
+        fprintf(stderr, "Failed to start LSM compaction thread.\n");
+        snapshot_unref(index->current);
+        pthread_mutex_destroy(&index->lock);
+        pthread_cond_destroy(&index->wake);
+        free(index);
+        return NULL;
+    }
+
+    // Existing tiers may already be due for compaction
+    pthread_cond_signal(&index->wake);
+    return index;
+}
+
+int lsm_index_close(LsmIndex* index) {
+    if (!index) return 0;
+    int rc = 0;
+
+    if (!index->readonly) {
+        rc = lsm_index_flush(index);
+        pthread_mutex_lock(&index->lock);
+        index->stopping = 1;
+        pthread_cond_broadcast(&index->wake);
+        pthread_mutex_unlock(&index->lock);
+        pthread_join(index->compactor, NULL);
+    }
+
+    snapshot_unref(index->current);
+    pthread_mutex_destroy(&index->lock);
+    pthread_cond_destroy(&index->wake);
+    free(index->memtable);
+    free(index);
+    return rc;
+}
+
+// ===========================
+// Ingest
+// ===========================
+
+static int compare_record(const void* a, const void* b) {
+    const FingerprintHash64* x = (const FingerprintHash64*)a;
+    const FingerprintHash64* y = (const FingerprintHash64*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->song_id != y->song_id) return x->song_id < y->song_id ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
+}
+
+int lsm_index_flush(LsmIndex* index) {
+    if (index->mem_count == 0) return 0;
+    if (index->readonly) return -1;
+
+    qsort(index->memtable, index->mem_count, sizeof(FingerprintHash64), compare_record);
+
+    pthread_mutex_lock(&index->lock);
+    uint64_t id = index->next_id++;
+    pthread_mutex_unlock(&index->lock);
+
+    char path[MAX_PATH_LEN];
+    if (segment_path(index, id, path) != 0) return -1;
+    MmapIndexWriter* w = mmap_index_writer_open(path);
+    if (!w) return -1;
+
+    for (int i = 0; i < index->mem_count; i++) {
+        const FingerprintHash64* r = &index->memtable[i];
+        if (mmap_index_writer_add(w, r->hash, r->song_id, r->time_offset) != 0) {
+            mmap_index_writer_abort(w);
+            return -1;
+        }
+    }
+    if (mmap_index_writer_finish(w) != 0) return -1;
+
+    Segment* seg = open_segment(index, id);
+    if (!seg) return -1;
+
+    pthread_mutex_lock(&index->lock);
+    LsmSnapshot* cur = index->current;
+    Segment** next = (Segment**)malloc((cur->num_segments + 1) * sizeof(Segment*));
+    int rc = -1;
+    if (next) {
+        memcpy(next, cur->segments, cur->num_segments * sizeof(Segment*));
+        next[cur->num_segments] = seg;
+        rc = publish(index, next, cur->num_segments + 1);
+        free(next);
+    }
+    if (rc == 0) pthread_cond_signal(&index->wake);
+    pthread_mutex_unlock(&index->lock);
+
+    if (rc != 0) {
+        mmap_index_close(seg->index);
+        remove(seg->path);
+        free(seg);
+        return -1;
+    }
+
+    index->mem_count = 0;
+    return 0;
+}
+
+int lsm_index_add(LsmIndex* index, const FingerprintHash64* hashes, int count) {
+    if (index->readonly) {
+        fprintf(stderr, "LSM index opened read-only.\n");
+        return -1;
+    }
+    if (index->mem_count + count > index->mem_capacity) {
+        int capacity = index->mem_capacity ? index->mem_capacity : 1 << 16;
+        while (capacity < index->mem_count + count) capacity *= 2;
+        FingerprintHash64* grown = realloc(index->memtable, capacity * sizeof(FingerprintHash64));
+        if (!grown) return -1;
+        index->memtable = grown;
+        index->mem_capacity = capacity;
+    }
+
+    memcpy(index->memtable + index->mem_count, hashes, count * sizeof(FingerprintHash64));
+    index->mem_count += count;
+
+    if (index->mem_count >= LSM_MEMTABLE_RECORDS)
+        return lsm_index_flush(index);
+    return 0;
+}
+
+// ===========================
+// Reads
+// ===========================
+
+LsmSnapshot* lsm_index_acquire(LsmIndex* index) {
+    pthread_mutex_lock(&index->lock);
+    LsmSnapshot* snap = index->current;
+    snap->refs++;
+    pthread_mutex_unlock(&index->lock);
+    return snap;
+}
+
+void lsm_index_release(LsmIndex* index, LsmSnapshot* snapshot) {
+    pthread_mutex_lock(&index->lock);
+    snapshot_unref(snapshot);
+    pthread_mutex_unlock(&index->lock);
+}
+
+size_t lsm_snapshot_lookup(const LsmSnapshot* snapshot, uint64_t hash, Posting* out, size_t max_out) {
+    size_t total = 0;
+    for (int i = 0; i < snapshot->num_segments; i++) {
+        const Posting* p;
+        size_t n = mmap_index_lookup(snapshot->segments[i]->index, hash, &p);
+        if (total < max_out) {
+            size_t take = n < max_out - total ? n : max_out - total;
+            memcpy(out + total, p, take * sizeof(Posting));
+        }
+        total += n;
+    }
+    return total;
+}
+
+int lsm_snapshot_num_segments(const LsmSnapshot* snapshot) {
+    return snapshot->num_segments;
+}
+
+uint64_t lsm_snapshot_num_postings(const LsmSnapshot* snapshot) {
+    uint64_t total = 0;
+    for (int i = 0; i < snapshot->num_segments; i++)
+        total += snapshot->segments[i]->num_postings;
+    return total;
+}
@@ -0,0 +1,896 @@
+// File: src/match_server.c
+// Socket front end: per-connection reader threads feeding a shared matcher pool.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "config.h"
+#include "thread_pool.h"
+#include "matcher.h"
+#include "match_server.h"
+#include "fingerprint_blob.h"
+#include "result_cache.h"
+
+#define LATENCY_BUCKETS 104     // Quarter-octave buckets from 1 us to ~67 s
+
+typedef struct Connection Connection;
+typedef struct Request Request;
+
+// Micro-batch lookup: one slice of the batch's distinct hashes
+typedef struct {
+    const FingerprintIndex* index;
+    const uint64_t* hashes;
+    PostingList* lists;
+    size_t begin, end;
+    Posting* scratch;           // MATCH_MAX_LIST_LEN entries
+    Posting* arena;             // Copies of the slice's postings
+    size_t arena_capacity;
+    int failed;
+} LookupSlice;
+
+// Micro-batch: one request's decoded hashes and its lists
+typedef struct {
+    Request* req;
+    MatchServer* server;
+    FingerprintHash64* hashes;
+    int count;
+    int status;                 // 0, -1 (error) or -2 (bad request) after decoding
+    double batch_started;
+    MinHashSketch sketch;       // Result cache key and token, when caching
+    uint64_t generation;
+    int cached;                 // Results answered from the cache, or -1
+    MatchResult results[SERVER_MAX_K];
+} BatchItem;
+
+struct MatchServer {
+    FingerprintIndex index;
+    ThreadPool* pool;
+    Matcher** matchers;         // One per pool worker, then one for run_all's inline fallback
+    int num_workers;
+
+    int listen_fds[2];          // Unix, TCP; -1 if unused
+    char unix_path[108];        // Removed again on free
+    int stop_pipe[2];           // match_server_stop writes here
+
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    Connection* connections;    // Open connections (linked through next)
+    int active;                 // Reader threads still running
+
+    pthread_mutex_t stats_lock;
+    long long requests;
+    long long errors;
+    long long accepted;
+    double total_ms;
+    double max_ms;
+    long long latency[LATENCY_BUCKETS];
+    long long batches;
+    long long hashes_requested;
+    long long hashes_looked_up;
+
+    // Micro-batching (batch_window_ms > 0): readers queue, one scheduler thread batches
+    double batch_window_ms;
+    pthread_t scheduler;
+    int scheduler_running;
+    int scheduler_stopping;
+    pthread_cond_t batch_ready;
+    Request* batch_head;        // Guarded by lock
+    Request* batch_tail;
+    int batch_queued;
+    LookupSlice* slices;        // One per worker
+
+    ResultCache* cache;         // Borrowed; NULL = no caching
+};
+
+struct Connection {
+    MatchServer* server;
+    int fd;
+    Connection* next;
+
+    pthread_mutex_t write_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t drained;
+    int pending;                // Requests queued or running
+};
+
+struct Request {
+    Connection* conn;
+    uint32_t request_id;
+    uint16_t type;
+    uint16_t k;
+    uint32_t payload_bytes;
+    unsigned char* payload;
+    double received_ms;
+    Request* next;              // Micro-batch queue
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// ===========================
+// Wire encoding
+// ===========================
+
+static uint32_t get_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get_le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint64_t get_le64(const unsigned char* p) {
+    return (uint64_t)get_le32(p) | (uint64_t)get_le32(p + 4) << 32;
+}
+
+static void put_le32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void put_le16(unsigned char* p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static int read_full(int fd, void* buf, size_t n) {
+    unsigned char* p = (unsigned char*)buf;
+    while (n > 0) {
+        ssize_t got = read(fd, p, n);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        p += got;
+        n -= (size_t)got;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void* buf, size_t n) {
+    const unsigned char* p = (const unsigned char*)buf;
+    while (n > 0) {
+        ssize_t put = send(fd, p, n, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return -1;
+        p += put;
+        n -= (size_t)put;
+    }
+    return 0;
+}
+
+// ===========================
+// Latency accounting
+// ===========================
+
+static void record_latency(MatchServer* s, double ms, int failed) {
+    double us = ms * 1000.0;
+    int bucket = us <= 1.0 ? 0 : (int)(4.0 * log2(us));
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+
+    pthread_mutex_lock(&s->stats_lock);
+    s->requests++;
+    s->errors += failed;
+    s->total_ms += ms;
+    if (ms > s->max_ms) s->max_ms = ms;
+    s->latency[bucket]++;
+    pthread_mutex_unlock(&s->stats_lock);
+}
+
+// Upper edge of the bucket holding the q-quantile.
+static double latency_quantile(const MatchServer* s, double q) {
+    long long target = (long long)ceil(q * s->requests);
+    long long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += s->latency[b];
+        if (seen >= target && seen > 0) return fmin(exp2((b + 1) / 4.0) / 1000.0, s->max_ms);
+    }
+    return 0.0;
+}
+
+void match_server_get_stats(MatchServer* s, MatchServerStats* out) {
+    pthread_mutex_lock(&s->stats_lock);
+    out->requests = s->requests;
+    out->errors = s->errors;
+    out->connections = s->accepted;
+    out->mean_ms = s->requests ? s->total_ms / s->requests : 0.0;
+    out->p50_ms = latency_quantile(s, 0.50);
+    out->p99_ms = latency_quantile(s, 0.99);
+    out->max_ms = s->max_ms;
+    out->batches = s->batches;
+    out->hashes_requested = s->hashes_requested;
+    out->hashes_looked_up = s->hashes_looked_up;
+    pthread_mutex_unlock(&s->stats_lock);
+}
+
+// ===========================
+// Request handling
+// ===========================
+
+// Turn a request payload into query hashes. Returns 0, -1 on error or -2 if malformed.
+static int decode_hashes(const Request* req, FingerprintHash64** out, int* count) {
+    *out = NULL;
+    *count = 0;
+
+    if (req->type == MATCH_REQ_PCM) {
+        if (req->payload_bytes % sizeof(float) != 0) return -2;
+        int n = (int)(req->payload_bytes / sizeof(float));
+        if (n < FRAME_SIZE) return 0;  // Too short to fingerprint: no hashes
+        float* samples = (float*)malloc(n * sizeof(float));
+        if (!samples) return -1;
+        for (int i = 0; i < n; i++) {
+            uint32_t bits = get_le32(req->payload + (size_t)i * 4);
+            memcpy(&samples[i], &bits, sizeof(float));
+        }
+        int rc = query_fingerprint_samples(samples, n, SAMPLE_RATE, out, count);
+        free(samples);
+        return rc;
+    }
+
+    if (req->type == MATCH_REQ_BLOB) {
+        int rc = fingerprint_blob_decode(req->payload, req->payload_bytes, out, count);
+        return rc == -1 ? -2 : rc == -2 ? -1 : 0;
+    }
+
+    if (req->payload_bytes % MATCH_PROTO_HASH_SIZE != 0) return -2;
+    int n = (int)(req->payload_bytes / MATCH_PROTO_HASH_SIZE);
+    if (n == 0) return 0;
+    FingerprintHash64* hashes = (FingerprintHash64*)calloc(n, sizeof(FingerprintHash64));
+    if (!hashes) return -1;
+    for (int i = 0; i < n; i++) {
+        const unsigned char* p = req->payload + (size_t)i * MATCH_PROTO_HASH_SIZE;
+        hashes[i].hash = get_le64(p);
+        hashes[i].time_offset = (int32_t)get_le32(p + 8);
+    }
+    *out = hashes;
+    *count = n;
+    return 0;
+}
+
+static int match_request(Matcher* m, const Request* req, MatchResult* results) {
+    FingerprintHash64* hashes;
+    int count;
+    int rc = decode_hashes(req, &hashes, &count);
+    if (rc != 0) return rc;
+
+    int found = matcher_match_hashes(m, hashes, count, results, req->k);
+    free(hashes);
+    return found;
+}
+
+static void send_response(Connection* conn, uint32_t request_id, MatchStatus status,
+                          const MatchResult* results, int count, double queue_ms, double match_ms) {
+    unsigned char buf[MATCH_PROTO_RESPONSE_SIZE + SERVER_MAX_K * MATCH_PROTO_RESULT_SIZE];
+    put_le32(buf, MATCH_PROTO_MAGIC);
+    put_le32(buf + 4, request_id);
+    put_le16(buf + 8, (uint16_t)status);
+    put_le16(buf + 10, (uint16_t)count);
+    put_le32(buf + 12, (uint32_t)(queue_ms * 1000.0));
+    put_le32(buf + 16, (uint32_t)(match_ms * 1000.0));
+
+    unsigned char* p = buf + MATCH_PROTO_RESPONSE_SIZE;
+    for (int i = 0; i < count; i++, p += MATCH_PROTO_RESULT_SIZE) {
+        uint32_t bits;
+        memcpy(&bits, &results[i].offset_seconds, sizeof(bits));
+        put_le32(p, (uint32_t)results[i].song_id);
+        put_le32(p + 4, (uint32_t)results[i].score);
+        put_le32(p + 8, bits);
+    }
+
+    // A failed write means the peer is gone; its reader notices on the next read
+    pthread_mutex_lock(&conn->write_lock);
+    write_full(conn->fd, buf, (size_t)(p - buf));
+    pthread_mutex_unlock(&conn->write_lock);
+}
+
+static void finish_request(Connection* conn) {
+    pthread_mutex_lock(&conn->lock);
+    conn->pending--;
+    pthread_cond_broadcast(&conn->drained);
+    pthread_mutex_unlock(&conn->lock);
+}
+
+// Answer a request, account for it and release it.
+static void complete_request(Request* req, int found, const MatchResult* results, double started) {
+    MatchServer* s = req->conn->server;
+    double done = now_ms();
+
+    MatchStatus status = found >= 0 ? MATCH_STATUS_OK
+                       : found == -2 ? MATCH_STATUS_BAD_REQUEST : MATCH_STATUS_ERROR;
+    send_response(req->conn, req->request_id, status, results, found > 0 ? found : 0,
+                  started - req->received_ms, done - started);
+    record_latency(s, done - req->received_ms, status != MATCH_STATUS_OK);
+
+    finish_request(req->conn);
+    free(req->payload);
+    free(req);
+}
+
+// Pool task: match one request with the worker's own Matcher and answer it.
+static void serve_request(void* arg, int worker_id) {
+    Request* req = (Request*)arg;
+    MatchServer* s = req->conn->server;
+    double started = now_ms();
+
+    MatchResult results[SERVER_MAX_K];
+    int found = req->type == MATCH_REQ_PING ? 0 : match_request(s->matchers[worker_id], req, results);
+    complete_request(req, found, results, started);
+}
+
+// ===========================
+// Micro-batching
+// ===========================
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Run fn(items[i]) for every item on the pool and wait. Only the scheduler thread
+// calls this, so items the queue refuses run here on the spare Matcher.
+static void run_all(MatchServer* s, task_fn fn, void* items, size_t item_size, int n) {
+    TaskGroup group;
+    task_group_init(&group);
+    for (int i = 0; i < n; i++) {
+        void* item = (char*)items + (size_t)i * item_size;
+        if (thread_pool_submit(s->pool, &group, fn, item) != 0)
+            fn(item, s->num_workers);
+    }
+    task_group_wait(&group);
+    task_group_destroy(&group);
+}
+
+static void decode_item(void* arg, int worker_id) {
+    (void)worker_id;
+    BatchItem* item = (BatchItem*)arg;
+    item->status = decode_hashes(item->req, &item->hashes, &item->count);
+    item->cached = -1;
+
+    ResultCache* cache = item->server->cache;
+    if (cache && item->status == 0) {
+        minhash_compute(item->hashes, item->count, &item->sketch);
+        item->cached = result_cache_lookup(cache, &item->sketch, item->count, item->results,
+                                           item->req->k, &item->generation);
+    }
+}
+
+// Whether a decoded batch item still needs its posting lists
+static int needs_lookup(const BatchItem* item) {
+    return item->status == 0 && item->cached < 0;
+}
+
+// Fetch one slice of the distinct hashes, copying postings into the slice's arena.
+static void lookup_slice(void* arg, int worker_id) {
+    (void)worker_id;
+    LookupSlice* sl = (LookupSlice*)arg;
+    size_t used = 0;
+    sl->failed = 0;
+
+    for (size_t i = sl->begin; i < sl->end; i++) {
+        const Posting* p;
+        size_t c = sl->index->lookup(sl->index->impl, sl->hashes[i], sl->scratch, MATCH_MAX_LIST_LEN, &p);
+        sl->lists[i].count = c;
+        sl->lists[i].postings = NULL;
+        if (c > MATCH_MAX_LIST_LEN) continue;  // Skipped by the matcher on count alone
+        if (!p) c = sl->lists[i].count = 0;
+        if (c == 0) continue;
+
+        if (used + c > sl->arena_capacity) {
+            size_t capacity = sl->arena_capacity ? sl->arena_capacity : 1 << 16;
+            while (capacity < used + c) capacity *= 2;
+            Posting* arena = realloc(sl->arena, capacity * sizeof(Posting));
+            if (!arena) {
+                sl->failed = 1;
+                return;
+            }
+            sl->arena = arena;
+            sl->arena_capacity = capacity;
+        }
+        memcpy(sl->arena + used, p, c * sizeof(Posting));
+        sl->lists[i].postings = (const Posting*)(uintptr_t)used;  // Offset until the arena stops moving
+        used += c;
+    }
+
+    for (size_t i = sl->begin; i < sl->end; i++)
+        if (sl->lists[i].count > 0 && sl->lists[i].count <= MATCH_MAX_LIST_LEN)
+            sl->lists[i].postings = sl->arena + (uintptr_t)sl->lists[i].postings;
+}
+
+typedef struct {
+    BatchItem* item;
+    const uint64_t* unique;
+    size_t num_unique;
+    const PostingList* lists;
+} ScoreTask;
+
+static void score_item(void* arg, int worker_id) {
+    ScoreTask* t = (ScoreTask*)arg;
+    BatchItem* item = t->item;
+    int found = item->status;
+    if (item->cached >= 0) {
+        complete_request(item->req, item->cached, item->results, item->batch_started);
+        free(item->hashes);
+        return;
+    }
+
+    PostingList* lists = NULL;
+    if (found == 0 && item->count > 0) {
+        lists = (PostingList*)malloc(item->count * sizeof(PostingList));
+        if (!lists) found = -1;
+    }
+    if (found == 0) {
+        for (int i = 0; i < item->count; i++) {
+            const uint64_t* hit = bsearch(&item->hashes[i].hash, t->unique, t->num_unique,
+                                          sizeof(uint64_t), compare_u64);
+            lists[i] = t->lists[hit - t->unique];
+        }
+        found = matcher_match_lists(item->server->matchers[worker_id], item->hashes, lists,
+                                    item->count, item->results, item->req->k);
+        if (found >= 0 && item->server->cache)
+            result_cache_store(item->server->cache, &item->sketch, item->count, item->generation,
+                               item->results, found, item->req->k);
+    }
+
+    complete_request(item->req, found, item->results, item->batch_started);
+    free(lists);
+    free(item->hashes);
+}
+
+// Decode all requests, look up the union of their distinct hashes once, then score each.
+static void process_batch(MatchServer* s, Request** reqs, int n) {
+    double started = now_ms();
+    BatchItem* items = (BatchItem*)calloc(n, sizeof(BatchItem));
+    ScoreTask* tasks = (ScoreTask*)calloc(n, sizeof(ScoreTask));
+    if (!items || !tasks) {
+        for (int i = 0; i < n; i++)
+            complete_request(reqs[i], -1, NULL, started);
+        free(items);
+        free(tasks);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        items[i].req = reqs[i];
+        items[i].server = s;
+        items[i].batch_started = started;
+    }
+
+    // Once per batch: drop cached results (and re-validate a pool's filter) if
+    // the catalog has grown since the last one
+    int64_t index_generation;
+    if (s->index.generation && s->index.generation(s->index.impl, &index_generation) == 0 && s->cache)
+        result_cache_sync(s->cache, index_generation);
+    run_all(s, decode_item, items, sizeof(BatchItem), n);
+
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+        if (needs_lookup(&items[i])) total += (size_t)items[i].count;
+
+    uint64_t* unique = (uint64_t*)malloc((total > 0 ? total : 1) * sizeof(uint64_t));
+    PostingList* lists = (PostingList*)malloc((total > 0 ? total : 1) * sizeof(PostingList));
+    size_t num_unique = 0;
+    int failed = !unique || !lists;
+
+    if (!failed) {
+        for (int i = 0; i < n; i++)
+            for (int j = 0; needs_lookup(&items[i]) && j < items[i].count; j++)
+                unique[num_unique++] = items[i].hashes[j].hash;
+        qsort(unique, num_unique, sizeof(uint64_t), compare_u64);
+        size_t w = 0;
+        for (size_t r = 0; r < num_unique; r++)
+            if (w == 0 || unique[w - 1] != unique[r]) unique[w++] = unique[r];
+        num_unique = w;
+
+        // One pass over the index in hash order
+        if (s->index.lookup_batch) {
+            failed = s->index.lookup_batch(s->index.impl, unique, num_unique, lists) != 0;
+        } else {
+            int num_slices = s->num_workers;
+            size_t per_slice = (num_unique + num_slices - 1) / num_slices;
+            for (int i = 0; i < num_slices; i++) {
+                LookupSlice* sl = &s->slices[i];
+                sl->index = &s->index;
+                sl->hashes = unique;
+                sl->lists = lists;
+                sl->begin = (size_t)i * per_slice < num_unique ? (size_t)i * per_slice : num_unique;
+                sl->end = sl->begin + per_slice < num_unique ? sl->begin + per_slice : num_unique;
+            }
+            run_all(s, lookup_slice, s->slices, sizeof(LookupSlice), num_slices);
+            for (int i = 0; i < num_slices; i++) failed |= s->slices[i].failed;
+        }
+    }
+
+    pthread_mutex_lock(&s->stats_lock);
+    s->batches++;
+    s->hashes_requested += (long long)total;
+    s->hashes_looked_up += (long long)num_unique;
+    pthread_mutex_unlock(&s->stats_lock);
+
+    for (int i = 0; i < n; i++) {
+        if (failed && needs_lookup(&items[i])) items[i].status = -1;
+        tasks[i].item = &items[i];
+        tasks[i].unique = unique;
+        tasks[i].num_unique = num_unique;
+        tasks[i].lists = lists;
+    }
+    run_all(s, score_item, tasks, sizeof(ScoreTask), n);
+
+    free(unique);
+    free(lists);
+    free(items);
+    free(tasks);
+}
+
+// Scheduler thread: wait for a request, hold the batch open for the window, run it.
+static void* scheduler_main(void* arg) {
+    MatchServer* s = (MatchServer*)arg;
+    Request* batch[SERVER_BATCH_MAX_REQUESTS];
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->batch_head && !s->scheduler_stopping)
+            pthread_cond_wait(&s->batch_ready, &s->lock);
+        if (!s->batch_head) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+
+        double deadline = s->batch_head->received_ms + s->batch_window_ms;
+        while (s->batch_queued < SERVER_BATCH_MAX_REQUESTS && !s->scheduler_stopping) {
+            double wait_ms = deadline - now_ms();
+            if (wait_ms <= 0) break;
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            long long ns = until.tv_nsec + (long long)(wait_ms * 1e6);
+            until.tv_sec += ns / 1000000000LL;
+            until.tv_nsec = ns % 1000000000LL;
+            pthread_cond_timedwait(&s->batch_ready, &s->lock, &until);
+        }
+
+        int n = 0;
+        while (s->batch_head && n < SERVER_BATCH_MAX_REQUESTS) {
+            batch[n++] = s->batch_head;
+            s->batch_head = s->batch_head->next;
+            s->batch_queued--;
+        }
+        if (!s->batch_head) s->batch_tail = NULL;
+        pthread_mutex_unlock(&s->lock);
+
+        process_batch(s, batch, n);
+    }
+    return NULL;
+}
+
+static void enqueue_batched(MatchServer* s, Request* req) {
+    pthread_mutex_lock(&s->lock);
+    req->next = NULL;
+    if (s->batch_tail) s->batch_tail->next = req;
+    else s->batch_head = req;
+    s->batch_tail = req;
+    s->batch_queued++;
+    pthread_cond_signal(&s->batch_ready);
+    pthread_mutex_unlock(&s->lock);
+}
+
+void match_server_set_result_cache(MatchServer* s, ResultCache* cache) {
+    s->cache = cache;
+    for (int i = 0; i <= s->num_workers; i++)
+        matcher_set_result_cache(s->matchers[i], cache);
+}
+
+void match_server_set_batch_window(MatchServer* s, double window_ms) {
+    s->batch_window_ms = window_ms > 0 ? window_ms : 0;
+}
+
+// ===========================
+// Connections
+// ===========================
+
+static void remove_connection(MatchServer* s, Connection* conn) {
+    pthread_mutex_lock(&s->lock);
+    for (Connection** p = &s->connections; *p; p = &(*p)->next) {
+        if (*p == conn) {
+            *p = conn->next;
+            break;
+        }
+    }
+    s->active--;
+    pthread_cond_broadcast(&s->idle);
+    pthread_mutex_unlock(&s->lock);
+}
+
+// Reader thread: parse requests and queue them, at most SERVER_MAX_PENDING at once.
+static void* connection_main(void* arg) {
+    Connection* conn = (Connection*)arg;
+    MatchServer* s = conn->server;
+
+    for (;;) {
+        unsigned char header[MATCH_PROTO_REQUEST_SIZE];
+        if (read_full(conn->fd, header, sizeof(header)) != 0) break;
+
+        uint32_t magic = get_le32(header);
+        uint32_t request_id = get_le32(header + 4);
+        uint16_t type = get_le16(header + 8);
+        uint16_t k = get_le16(header + 10);
+        uint32_t payload_bytes = get_le32(header + 12);
+
+        // The stream cannot be resynchronized after a bad header or oversized payload
+        if (magic != MATCH_PROTO_MAGIC || payload_bytes > SERVER_MAX_PAYLOAD_BYTES) {
+            send_response(conn, request_id, MATCH_STATUS_BAD_REQUEST, NULL, 0, 0.0, 0.0);
+            record_latency(s, 0.0, 1);
+            break;
+        }
+
+        Request* req = (Request*)calloc(1, sizeof(Request));
+        unsigned char* payload = (unsigned char*)malloc(payload_bytes > 0 ? payload_bytes : 1);
+        if (!req || !payload || read_full(conn->fd, payload, payload_bytes) != 0) {
+            free(req);
+            free(payload);
+            break;
+        }
+        req->received_ms = now_ms();
+
+        if (type > MATCH_REQ_BLOB || k == 0 || k > SERVER_MAX_K) {
+            send_response(conn, request_id, MATCH_STATUS_BAD_REQUEST, NULL, 0, 0.0, 0.0);
+            record_latency(s, 0.0, 1);
+            free(req);
+            free(payload);
+            continue;
+        }
+
+        req->conn = conn;
+        req->request_id = request_id;
+        req->type = type;
+        req->k = k;
+        req->payload_bytes = payload_bytes;
+        req->payload = payload;
+
+        pthread_mutex_lock(&conn->lock);
+        while (conn->pending >= SERVER_MAX_PENDING)
+            pthread_cond_wait(&conn->drained, &conn->lock);
+        conn->pending++;
+        pthread_mutex_unlock(&conn->lock);
+
+        if (s->batch_window_ms > 0 && type != MATCH_REQ_PING)
+            enqueue_batched(s, req);
+        else if (thread_pool_submit(s->pool, NULL, serve_request, req) != 0)
+            complete_request(req, type == MATCH_REQ_PING ? 0 : -1, NULL, now_ms());  // Queue full; no free Matcher
+    }
+
+    // Answer everything in flight before closing
+    pthread_mutex_lock(&conn->lock);
+    while (conn->pending > 0)
+        pthread_cond_wait(&conn->drained, &conn->lock);
+    pthread_mutex_unlock(&conn->lock);
+
+    remove_connection(s, conn);
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->write_lock);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_cond_destroy(&conn->drained);
+    free(conn);
+    return NULL;
+}
+
+static void accept_connection(MatchServer* s, int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // Fails harmlessly on Unix sockets
+
+    Connection* conn = (Connection*)calloc(1, sizeof(Connection));
+    if (!conn) {
+        close(fd);
+        return;
+    }
+    conn->server = s;
+    conn->fd = fd;
+    pthread_mutex_init(&conn->write_lock, NULL);
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->drained, NULL);
+
+    pthread_mutex_lock(&s->lock);
+    conn->next = s->connections;
+    s->connections = conn;
+    s->active++;
+    pthread_mutex_unlock(&s->lock);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&thread, &attr, connection_main, conn);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        fprintf(stderr, "Failed to start connection thread.\n");
+        remove_connection(s, conn);
+        close(fd);
+        free(conn);
+        return;
+    }
+
+    pthread_mutex_lock(&s->stats_lock);
+    s->accepted++;
+    pthread_mutex_unlock(&s->stats_lock);
+}
+
+// ===========================
+// Server lifecycle
+// ===========================
+
+MatchServer* match_server_create(FingerprintIndex index, int num_workers) {
+    if (num_workers <= 0 || !index.concurrent) {
+        fprintf(stderr, "Match server needs a concurrent index and at least one worker.\n");
+        return NULL;
+    }
+
+    MatchServer* s = (MatchServer*)calloc(1, sizeof(MatchServer));
+    if (!s) return NULL;
+    s->index = index;
+    s->listen_fds[0] = s->listen_fds[1] = -1;
+    s->stop_pipe[0] = s->stop_pipe[1] = -1;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->idle, NULL);
+    pthread_mutex_init(&s->stats_lock, NULL);
+    pthread_cond_init(&s->batch_ready, NULL);
+
+    s->matchers = (Matcher**)calloc(num_workers + 1, sizeof(Matcher*));
+    s->slices = (LookupSlice*)calloc(num_workers, sizeof(LookupSlice));
+    s->num_workers = num_workers;
+    int ok = s->matchers != NULL && s->slices != NULL && pipe(s->stop_pipe) == 0;
+    for (int i = 0; ok && i < num_workers; i++)
+        ok = (s->slices[i].scratch = (Posting*)malloc(MATCH_MAX_LIST_LEN * sizeof(Posting))) != NULL;
+    for (int i = 0; ok && i <= num_workers; i++)
+        ok = (s->matchers[i] = matcher_create(index)) != NULL;
+    if (ok) ok = (s->pool = thread_pool_create(num_workers)) != NULL;
+
+    if (!ok) {
+        fprintf(stderr, "Failed to set up match server.\n");
+        match_server_free(s);
+        return NULL;
+    }
+    fcntl(s->stop_pipe[1], F_SETFL, O_NONBLOCK);
+    return s;
+}
+
+int match_server_listen_unix(MatchServer* s, const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_LISTEN_BACKLOG) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    s->listen_fds[0] = fd;
+    strcpy(s->unix_path, path);
+    return 0;
+}
+
+int match_server_listen_tcp(MatchServer* s, int port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_LISTEN_BACKLOG) != 0) {
+        fprintf(stderr, "Failed to listen on 127.0.0.1:%d: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    s->listen_fds[1] = fd;
+    return 0;
+}
+
+int match_server_run(MatchServer* s) {
+    if (s->listen_fds[0] < 0 && s->listen_fds[1] < 0) {
+        fprintf(stderr, "Match server has no listening socket.\n");
+        return -1;
+    }
+
+    if (s->batch_window_ms > 0) {
+        s->scheduler_stopping = 0;
+        if (pthread_create(&s->scheduler, NULL, scheduler_main, s) != 0) {
+            fprintf(stderr, "Failed to start batch scheduler.\n");
+            return -1;
+        }
+        s->scheduler_running = 1;
+    }
+
+    int rc = 0;
+    for (;;) {
+        struct pollfd fds[3];
+        int n = 0;
+        fds[n].fd = s->stop_pipe[0];
+        fds[n++].events = POLLIN;
+        for (int i = 0; i < 2; i++) {
+            if (s->listen_fds[i] < 0) continue;
+            fds[n].fd = s->listen_fds[i];
+            fds[n++].events = POLLIN;
+        }
+
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) continue;
+            rc = -1;
+            break;
+        }
+        if (fds[0].revents) break;
+        for (int i = 1; i < n; i++)
+            if (fds[i].revents & POLLIN) accept_connection(s, fds[i].fd);
+    }
+
+    // Stop reading new requests; readers drain what they have queued and exit
+    pthread_mutex_lock(&s->lock);
+    for (Connection* c = s->connections; c; c = c->next)
+        shutdown(c->fd, SHUT_RD);
+    while (s->active > 0)
+        pthread_cond_wait(&s->idle, &s->lock);
+    s->scheduler_stopping = 1;
+    pthread_cond_signal(&s->batch_ready);
+    pthread_mutex_unlock(&s->lock);
+
+    if (s->scheduler_running) {
+        pthread_join(s->scheduler, NULL);
+        s->scheduler_running = 0;
+    }
+    return rc;
+}
+
+void match_server_stop(MatchServer* s) {
+    char byte = 1;
+    ssize_t ignored = write(s->stop_pipe[1], &byte, 1);
+    (void)ignored;
+}
+
+void match_server_free(MatchServer* s) {
+    if (!s) return;
+    thread_pool_destroy(s->pool);
+    for (int i = 0; s->matchers && i <= s->num_workers; i++)
+        matcher_free(s->matchers[i]);
+    free(s->matchers);
+    for (int i = 0; s->slices && i < s->num_workers; i++) {
+        free(s->slices[i].scratch);
+        free(s->slices[i].arena);
+    }
+    free(s->slices);
+    for (int i = 0; i < 2; i++)
+        if (s->listen_fds[i] >= 0) close(s->listen_fds[i]);
+    if (s->unix_path[0]) unlink(s->unix_path);
+    for (int i = 0; i < 2; i++)
+        if (s->stop_pipe[i] >= 0) close(s->stop_pipe[i]);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->idle);
+    pthread_mutex_destroy(&s->stats_lock);
+    pthread_cond_destroy(&s->batch_ready);
+    free(s);
+}
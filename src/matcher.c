@@ -0,0 +1,782 @@
+// File: src/matcher.c
+// Offset-difference voting over any FingerprintIndex backend.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "audio_io.h"
+#include "spectrogram.h"
+#include "peak_detection.h"
+#include "hashing.h"
+#include "matcher.h"
+#include "vote_scoring.h"
+#include "result_cache.h"
+#include "verifier.h"
+
+// Progressive mode: running count of one (song_id, delta) cell
+typedef struct {
+    uint64_t key;               // vote_pack() key; 0 marks an empty slot
+    uint32_t count;
+} VoteCell;
+
+// Progressive mode: best cell so far of one song
+typedef struct {
+    uint32_t song_plus1;        // song_id + 1; 0 marks an empty slot
+    int best;
+    int delta;
+} SongBest;
+
+typedef struct {
+    size_t count;
+    int hash;                   // Index into the query's hashes
+} ListOrder;
+
+// Parallel scoring: one task's slice of the query and its partial histogram
+typedef struct {
+    const FingerprintIndex* index;
+    const FingerprintHash64* hashes;
+    int begin, end;
+    Posting* scratch;
+    VoteScorer* scorer;
+    uint64_t* votes;
+    size_t votes_capacity;
+    VoteRuns* runs;
+    long long postings;
+    int skipped;
+    int failed;
+} ScoreSlice;
+
+struct Matcher {
+    FingerprintIndex index;
+    MatchMode mode;
+    MatchStats stats;
+    VoteScorer* scorer;
+
+    Posting* scratch;           // MATCH_MAX_LIST_LEN entries for copying backends
+    uint64_t* votes;            // Packed (song_id, delta) keys
+    size_t votes_capacity;
+
+    uint64_t* query_hashes;     // Batch path: hashes of the current query
+    PostingList* lists;
+    size_t lists_capacity;
+
+    ListOrder* order;           // Progressive mode buffers
+    size_t order_capacity;
+    VoteCell* cells;
+    SongBest* songs;
+    size_t table_capacity;      // Allocated slots, shared by cells and songs
+    size_t table_size;          // Slots in use by this query: power of two, <= capacity
+
+    ThreadPool* pool;           // Parallel exhaustive scoring (borrowed), NULL = serial
+    ScoreSlice* slices;
+    VoteRuns* runs;
+    int num_slices;
+
+    long long budget_postings;  // Bounded mode limits
+    int budget_hashes;
+    MatchSelect budget_select;
+    int* selected;              // Bounded mode: indices of the sampled hashes
+    size_t selected_capacity;
+
+    ResultCache* cache;         // Borrowed, may be shared; NULL = no caching
+    Verifier* verifier;         // Borrowed; NULL = single-stage matching
+};
+
+Matcher* matcher_create(FingerprintIndex index) {
+    Matcher* m = (Matcher*)calloc(1, sizeof(Matcher));
+    if (!m) return NULL;
+
+    m->index = index;
+    m->budget_postings = MATCH_BUDGET_POSTINGS;
+    m->budget_hashes = MATCH_BUDGET_HASHES;
+    m->budget_select = MATCH_SELECT_RAREST;
+    m->scratch = (Posting*)malloc(MATCH_MAX_LIST_LEN * sizeof(Posting));
+    m->scorer = vote_scorer_create();
+    if (!m->scratch || !m->scorer) {
+        free(m->scratch);
+        vote_scorer_free(m->scorer);
+        free(m);
+        return NULL;
+    }
+    return m;
+}
+
+void matcher_free(Matcher* m) {
+    if (!m) return;
+    free(m->scratch);
+    vote_scorer_free(m->scorer);
+    free(m->votes);
+    free(m->query_hashes);
+    free(m->lists);
+    free(m->order);
+    free(m->cells);
+    free(m->songs);
+    free(m->selected);
+    for (int i = 0; i < m->num_slices; i++) {
+        free(m->slices[i].scratch);
+        vote_scorer_free(m->slices[i].scorer);
+        free(m->slices[i].votes);
+    }
+    free(m->slices);
+    free(m->runs);
+    free(m);
+}
+
+void matcher_set_mode(Matcher* m, MatchMode mode) {
+    m->mode = mode;
+}
+
+void matcher_set_budget(Matcher* m, long long max_postings, int max_hashes, MatchSelect select) {
+    m->budget_postings = max_postings > 0 ? max_postings : MATCH_BUDGET_POSTINGS;
+    m->budget_hashes = max_hashes > 0 ? max_hashes : MATCH_BUDGET_HASHES;
+    m->budget_select = select;
+}
+
+void matcher_set_result_cache(Matcher* m, ResultCache* cache) {
+    m->cache = cache;
+}
+
+void matcher_set_verifier(Matcher* m, Verifier* verifier) {
+    m->verifier = verifier;
+}
+
+int matcher_set_thread_pool(Matcher* m, ThreadPool* pool) {
+    if (pool && !m->index.concurrent) {
+        fprintf(stderr, "Fingerprint index does not support concurrent lookups.\n");
+        return -1;
+    }
+    m->pool = NULL;
+    if (!pool) return 0;
+
+    // One slice per worker; buffers are kept for later queries
+    int wanted = thread_pool_size(pool);
+    if (wanted > m->num_slices) {
+        ScoreSlice* slices = realloc(m->slices, wanted * sizeof(ScoreSlice));
+        if (slices) m->slices = slices;
+        VoteRuns* runs = realloc(m->runs, wanted * sizeof(VoteRuns));
+        if (runs) m->runs = runs;
+        if (!slices || !runs) return -1;
+
+        for (; m->num_slices < wanted; m->num_slices++) {
+            ScoreSlice* s = &m->slices[m->num_slices];
+            memset(s, 0, sizeof(*s));
+            s->scratch = (Posting*)malloc(MATCH_MAX_LIST_LEN * sizeof(Posting));
+            s->scorer = vote_scorer_create();
+            if (!s->scratch || !s->scorer) {
+                free(s->scratch);
+                vote_scorer_free(s->scorer);
+                return -1;
+            }
+        }
+    }
+    m->pool = pool;
+    return 0;
+}
+
+const MatchStats* matcher_last_stats(const Matcher* m) {
+    return &m->stats;
+}
+
+static int reserve_votes(uint64_t** votes, size_t* votes_capacity, size_t needed) {
+    if (needed <= *votes_capacity) return 0;
+    size_t capacity = *votes_capacity ? *votes_capacity : 1 << 16;
+    while (capacity < needed) capacity *= 2;
+    uint64_t* grown = realloc(*votes, capacity * sizeof(uint64_t));
+    if (!grown) return -1;
+    *votes = grown;
+    *votes_capacity = capacity;
+    return 0;
+}
+
+// Append one vote per posting. Returns the new vote count, or -1.
+static long long cast_votes(uint64_t** votes, size_t* capacity, long long n,
+                            const Posting* p, size_t count, int query_time) {
+    if (reserve_votes(votes, capacity, (size_t)n + count) != 0) return -1;
+    for (size_t i = 0; i < count; i++)
+        (*votes)[n++] = vote_pack(p[i].song_id, p[i].time_offset - query_time);
+    return n;
+}
+
+static int reserve_lists(Matcher* m, int count) {
+    if ((size_t)count <= m->lists_capacity) return 0;
+    uint64_t* qh = realloc(m->query_hashes, count * sizeof(uint64_t));
+    if (qh) m->query_hashes = qh;
+    PostingList* lists = realloc(m->lists, count * sizeof(PostingList));
+    if (lists) m->lists = lists;
+    if (!qh || !lists) return -1;
+    m->lists_capacity = count;
+    return 0;
+}
+
+// Fetch every list of the query through the backend's batch call.
+static int lookup_all(Matcher* m, const FingerprintHash64* hashes, int count) {
+    if (reserve_lists(m, count) != 0) return -1;
+    for (int i = 0; i < count; i++)
+        m->query_hashes[i] = hashes[i].hash;
+
+    return m->index.lookup_batch(m->index.impl, m->query_hashes, count, m->lists);
+}
+
+// ===========================
+// Progressive matching
+// ===========================
+
+static int compare_order(const void* a, const void* b) {
+    const ListOrder* x = (const ListOrder*)a;
+    const ListOrder* y = (const ListOrder*)b;
+    if (x->count != y->count) return x->count < y->count ? -1 : 1;
+    return x->hash - y->hash;
+}
+
+// Size and clear the running tables for up to `postings` votes.
+static int reset_tables(Matcher* m, long long postings) {
+    size_t capacity = 1024;
+    while (capacity < (size_t)postings * 2) capacity *= 2;
+
+    if (capacity > m->table_capacity) {
+        free(m->cells);
+        free(m->songs);
+        m->cells = (VoteCell*)malloc(capacity * sizeof(VoteCell));
+        m->songs = (SongBest*)malloc(capacity * sizeof(SongBest));
+        m->table_capacity = capacity;
+        if (!m->cells || !m->songs) {
+            m->table_capacity = 0;
+            return -1;
+        }
+    }
+    // A short query after a long one clears and probes only the slots it needs
+    m->table_size = capacity;
+    memset(m->cells, 0, capacity * sizeof(VoteCell));
+    memset(m->songs, 0, capacity * sizeof(SongBest));
+    return 0;
+}
+
+static uint32_t bump_cell(Matcher* m, uint64_t key) {
+    size_t mask = m->table_size - 1;
+    size_t i = (size_t)mix_hash64(key) & mask;
+    while (m->cells[i].key != 0 && m->cells[i].key != key)
+        i = (i + 1) & mask;
+    m->cells[i].key = key;
+    return ++m->cells[i].count;
+}
+
+static SongBest* song_slot(Matcher* m, int song_id) {
+    size_t mask = m->table_size - 1;
+    uint32_t tag = (uint32_t)song_id + 1;
+    size_t i = (size_t)mix_hash64(tag) & mask;
+    while (m->songs[i].song_plus1 != 0 && m->songs[i].song_plus1 != tag)
+        i = (i + 1) & mask;
+    m->songs[i].song_plus1 = tag;
+    return &m->songs[i];
+}
+
+typedef struct {
+    int leader;                 // Song with the highest best cell, -1 if none
+    int lead;                   // Its score
+    int runner_up;              // Highest best cell of any other song
+} RaceState;
+
+static void vote_progressive(Matcher* m, RaceState* race, const Posting* p, size_t count, int query_time) {
+    for (size_t i = 0; i < count; i++) {
+        int delta = p[i].time_offset - query_time;
+        int votes = (int)bump_cell(m, vote_pack(p[i].song_id, delta));
+
+        SongBest* song = song_slot(m, p[i].song_id);
+        if (votes <= song->best) continue;
+        song->best = votes;
+        song->delta = delta;
+
+        // Song bests only grow, so the previous leader becomes the runner-up
+        if (p[i].song_id == race->leader) {
+            race->lead = votes;
+        } else if (votes > race->lead) {
+            race->runner_up = race->lead;
+            race->leader = p[i].song_id;
+            race->lead = votes;
+        } else if (votes > race->runner_up) {
+            race->runner_up = votes;
+        }
+    }
+}
+
+static int match_progressive(Matcher* m, const FingerprintHash64* hashes, int count, MatchResult* out, int k) {
+    if ((size_t)count > m->order_capacity) {
+        ListOrder* order = realloc(m->order, count * sizeof(ListOrder));
+        if (!order) return -1;
+        m->order = order;
+        m->order_capacity = count;
+    }
+
+    // List lengths first, from the batch results or the backend's count call
+    int batched = m->index.lookup_batch != NULL;
+    if (batched && lookup_all(m, hashes, count) != 0) return -1;
+
+    long long remaining = 0;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        size_t c = batched ? m->lists[i].count : m->index.count(m->index.impl, hashes[i].hash, MATCH_MAX_LIST_LEN);
+        if (c == 0) continue;
+        if (c > MATCH_MAX_LIST_LEN) {
+            m->stats.hashes_skipped++;
+            continue;
+        }
+        m->order[n].count = c;
+        m->order[n].hash = i;
+        n++;
+        remaining += (long long)c;
+    }
+    qsort(m->order, n, sizeof(ListOrder), compare_order);
+
+    if (reset_tables(m, remaining) != 0) return -1;
+
+    RaceState race = { -1, 0, 0 };
+    for (int j = 0; j < n; j++) {
+        int i = m->order[j].hash;
+        const Posting* p;
+        size_t c;
+        if (batched) {
+            p = m->lists[i].postings;
+            c = m->lists[i].count;
+        } else {
+            c = m->index.lookup(m->index.impl, hashes[i].hash, m->scratch, MATCH_MAX_LIST_LEN, &p);
+            if (c > MATCH_MAX_LIST_LEN || !p) c = 0;  // Changed since counting
+        }
+
+        vote_progressive(m, &race, p, c, hashes[i].time_offset);
+        m->stats.postings += (long long)c;
+        remaining -= (long long)m->order[j].count;
+
+        // Every unscanned posting adds at most one vote to one song
+        if (race.lead >= MATCH_MIN_SCORE && j + 1 < n &&
+            race.lead - race.runner_up > remaining + MATCH_EARLY_MARGIN) {
+            m->stats.terminated_early = 1;
+            m->stats.postings_left = remaining;
+            break;
+        }
+    }
+
+    int found = 0;
+    for (size_t s = 0; s < m->table_size; s++) {
+        const SongBest* song = &m->songs[s];
+        if (song->song_plus1 == 0 || song->best < MATCH_MIN_SCORE) continue;
+        if (found == k && out[k - 1].score >= song->best) continue;
+
+        int i = found < k ? found++ : k - 1;
+        while (i > 0 && out[i - 1].score < song->best) {
+            out[i] = out[i - 1];
+            i--;
+        }
+        out[i].song_id = (int)song->song_plus1 - 1;
+        out[i].score = song->best;
+        out[i].offset = song->delta;
+        out[i].offset_seconds = (float)song->delta * HOP_SIZE / SAMPLE_RATE;
+    }
+    return found;
+}
+
+// ===========================
+// Bounded matching
+// ===========================
+
+// Pick at most budget_hashes of the query, by hash value so that repeated
+// content is thinned the same way. Returns how many, or -1.
+static int sample_hashes(Matcher* m, const FingerprintHash64* hashes, int count) {
+    if ((size_t)count > m->selected_capacity) {
+        int* selected = realloc(m->selected, count * sizeof(int));
+        if (!selected) return -1;
+        m->selected = selected;
+        m->selected_capacity = count;
+    }
+
+    int limit = m->budget_hashes;
+    uint64_t threshold = count > limit ? UINT64_MAX / (uint64_t)count * (uint64_t)limit : UINT64_MAX;
+    int n = 0;
+    for (int i = 0; i < count && n < limit; i++) {
+        if (mix_hash64(hashes[i].hash) <= threshold) m->selected[n++] = i;
+    }
+    if (n < count) m->stats.budget_hit = 1;
+    return n;
+}
+
+// Choose which sampled lists to read, from capped counts only: a list too long
+// for the remaining budget costs at most that many postings to rule out. Rarest
+// first stops at the first list that does not fit, since every later one is
+// longer; sample order skips it and stops once the budget is spent. Leaves the
+// chosen query positions in m->selected and returns how many, or -1.
+static int plan_bounded(Matcher* m, int n) {
+    long long budget = m->budget_postings;
+    size_t cap = (long long)MATCH_MAX_LIST_LEN < budget ? MATCH_MAX_LIST_LEN : (size_t)budget;
+    long long planned = 0;
+    int chosen = 0;
+
+    if (m->budget_select == MATCH_SELECT_RAREST) {
+        if ((size_t)n > m->order_capacity) {
+            ListOrder* order = realloc(m->order, n * sizeof(ListOrder));
+            if (!order) return -1;
+            m->order = order;
+            m->order_capacity = n;
+        }
+        for (int j = 0; j < n; j++) {
+            m->order[j].count = m->index.count(m->index.impl, m->query_hashes[j], cap);
+            m->order[j].hash = m->selected[j];
+        }
+        qsort(m->order, n, sizeof(ListOrder), compare_order);
+
+        for (int j = 0; j < n; j++) {
+            size_t c = m->order[j].count;
+            if (c == 0) continue;
+            if (c > MATCH_MAX_LIST_LEN) {
+                m->stats.hashes_skipped++;
+                continue;
+            }
+            if (planned + (long long)c > budget) {
+                m->stats.budget_hit = 1;
+                break;
+            }
+            planned += (long long)c;
+            m->selected[chosen++] = m->order[j].hash;
+        }
+        return chosen;
+    }
+
+    for (int j = 0; j < n; j++) {
+        if (planned >= budget) {
+            m->stats.budget_hit = 1;
+            break;
+        }
+        size_t room = (size_t)(budget - planned);
+        size_t c = m->index.count(m->index.impl, m->query_hashes[j], cap < room ? cap : room);
+        if (c == 0) continue;
+        if (c > MATCH_MAX_LIST_LEN) {
+            m->stats.hashes_skipped++;
+            continue;
+        }
+        if (c > room) {
+            m->stats.budget_hit = 1;
+            continue;
+        }
+        planned += (long long)c;
+        m->selected[chosen++] = m->selected[j];  // chosen <= j
+    }
+    return chosen;
+}
+
+static int match_bounded(Matcher* m, const FingerprintHash64* hashes, int count, MatchResult* out, int k) {
+    int n = sample_hashes(m, hashes, count);
+    if (n < 0 || reserve_lists(m, n) != 0) return -1;
+    for (int j = 0; j < n; j++)
+        m->query_hashes[j] = hashes[m->selected[j]].hash;
+
+    n = plan_bounded(m, n);
+    if (n < 0) return -1;
+
+    // Only the chosen lists are fetched, in one batch call where the backend has one
+    int batched = m->index.lookup_batch != NULL;
+    if (batched) {
+        for (int j = 0; j < n; j++)
+            m->query_hashes[j] = hashes[m->selected[j]].hash;
+        if (m->index.lookup_batch(m->index.impl, m->query_hashes, n, m->lists) != 0) return -1;
+    }
+
+    long long votes = 0;
+    for (int j = 0; j < n && votes >= 0; j++) {
+        int i = m->selected[j];
+        const Posting* p;
+        size_t c;
+        if (batched) {
+            p = m->lists[j].postings;
+            c = m->lists[j].count;
+        } else {
+            c = m->index.lookup(m->index.impl, hashes[i].hash, m->scratch, MATCH_MAX_LIST_LEN, &p);
+        }
+
+        // Lists that grew since counting are left out rather than overrun the budget
+        if (c == 0 || c > MATCH_MAX_LIST_LEN || !p) continue;
+        if (votes + (long long)c > m->budget_postings) {
+            m->stats.budget_hit = 1;
+            continue;
+        }
+        votes = cast_votes(&m->votes, &m->votes_capacity, votes, p, c, hashes[i].time_offset);
+    }
+
+    if (votes < 0) {
+        fprintf(stderr, "Memory allocation failed for match votes.\n");
+        return -1;
+    }
+    m->stats.postings = votes;
+    return vote_scorer_score(m->scorer, m->votes, (size_t)votes, VOTE_SCORE_AUTO, MATCH_MIN_SCORE, out, k);
+}
+
+// ===========================
+// Parallel scoring
+// ===========================
+
+// Look up and vote one slice of the query, then collapse its votes into runs.
+static void score_slice(void* arg, int worker_id) {
+    (void)worker_id;
+    ScoreSlice* s = (ScoreSlice*)arg;
+    long long n = 0;
+    for (int i = s->begin; i < s->end && n >= 0; i++) {
+        const Posting* p;
+        size_t c = s->index->lookup(s->index->impl, s->hashes[i].hash, s->scratch, MATCH_MAX_LIST_LEN, &p);
+        if (c > MATCH_MAX_LIST_LEN) {
+            s->skipped++;
+            continue;
+        }
+        n = cast_votes(&s->votes, &s->votes_capacity, n, p, c, s->hashes[i].time_offset);
+    }
+    s->postings = n;
+    s->failed = n < 0 || vote_scorer_runs(s->scorer, s->votes, (size_t)n, s->runs) != 0;
+}
+
+static int match_parallel(Matcher* m, const FingerprintHash64* hashes, int count, MatchResult* out, int k) {
+    int num_slices = m->num_slices < count ? m->num_slices : count;
+    int per_slice = (count + num_slices - 1) / num_slices;
+
+    TaskGroup group;
+    task_group_init(&group);
+    for (int i = 0; i < num_slices; i++) {
+        ScoreSlice* s = &m->slices[i];
+        s->index = &m->index;
+        s->hashes = hashes;
+        s->begin = i * per_slice < count ? i * per_slice : count;
+        s->end = s->begin + per_slice < count ? s->begin + per_slice : count;
+        s->runs = &m->runs[i];
+        s->skipped = 0;
+        if (thread_pool_submit(m->pool, &group, score_slice, s) != 0)
+            score_slice(s, 0);  // Queue refused the task; run it here
+    }
+    task_group_wait(&group);
+    task_group_destroy(&group);
+
+    int failed = 0;
+    for (int i = 0; i < num_slices; i++) {
+        m->stats.hashes_skipped += m->slices[i].skipped;
+        m->stats.postings += m->slices[i].failed ? 0 : m->slices[i].postings;
+        failed |= m->slices[i].failed;
+    }
+    if (failed) {
+        fprintf(stderr, "Memory allocation failed for match votes.\n");
+        return -1;
+    }
+    return vote_runs_merge(m->runs, num_slices, MATCH_MIN_SCORE, out, k);
+}
+
+// ===========================
+// Matching
+// ===========================
+
+// Vote every list of the query and score. lists[i] answers hashes[i].
+static int score_lists(Matcher* m, const FingerprintHash64* hashes, const PostingList* lists, int count,
+                       MatchResult* out, int k) {
+    long long n = 0;
+    for (int i = 0; i < count && n >= 0; i++) {
+        if (lists[i].count > MATCH_MAX_LIST_LEN) {
+            m->stats.hashes_skipped++;
+            continue;
+        }
+        n = cast_votes(&m->votes, &m->votes_capacity, n, lists[i].postings, lists[i].count,
+                       hashes[i].time_offset);
+    }
+
+    if (n < 0) {
+        fprintf(stderr, "Memory allocation failed for match votes.\n");
+        return -1;
+    }
+    m->stats.postings = n;
+    return vote_scorer_score(m->scorer, m->votes, (size_t)n, VOTE_SCORE_AUTO, MATCH_MIN_SCORE, out, k);
+}
+
+int matcher_match_lists(Matcher* m, const FingerprintHash64* hashes, const PostingList* lists, int count,
+                        MatchResult* out, int k) {
+    if (!m || ((!hashes || !lists) && count > 0) || count < 0 || !out || k <= 0) {
+        fprintf(stderr, "Invalid input to matcher_match_lists.\n");
+        return -1;
+    }
+
+    memset(&m->stats, 0, sizeof(m->stats));
+    m->stats.query_hashes = count;
+    return score_lists(m, hashes, lists, count, out, k);
+}
+
+static int match_uncached(Matcher* m, const FingerprintHash64* hashes, int count, MatchResult* out, int k) {
+    long long n = 0;
+
+    if (m->mode == MATCH_PROGRESSIVE) {
+        int found = match_progressive(m, hashes, count, out, k);
+        if (found < 0) fprintf(stderr, "Progressive match failed.\n");
+        return found;
+    }
+
+    if (m->mode == MATCH_BOUNDED)
+        return match_bounded(m, hashes, count, out, k);
+
+    if (m->pool && count >= MATCH_PARALLEL_MIN_HASHES)
+        return match_parallel(m, hashes, count, out, k);
+
+    if (m->index.lookup_batch) {
+        if (lookup_all(m, hashes, count) != 0)
+            return -1;
+        return score_lists(m, hashes, m->lists, count, out, k);
+    }
+
+    for (int i = 0; i < count && n >= 0; i++) {
+        const Posting* p;
+        size_t c = m->index.lookup(m->index.impl, hashes[i].hash, m->scratch, MATCH_MAX_LIST_LEN, &p);
+        if (c > MATCH_MAX_LIST_LEN) {
+            m->stats.hashes_skipped++;
+            continue;
+        }
+        n = cast_votes(&m->votes, &m->votes_capacity, n, p, c, hashes[i].time_offset);
+    }
+
+    if (n < 0) {
+        fprintf(stderr, "Memory allocation failed for match votes.\n");
+        return -1;
+    }
+    m->stats.postings = n;
+    return vote_scorer_score(m->scorer, m->votes, (size_t)n, VOTE_SCORE_AUTO, MATCH_MIN_SCORE, out, k);
+}
+
+int matcher_match_hashes(Matcher* m, const FingerprintHash64* hashes, int count, MatchResult* out, int k) {
+    if (!m || (!hashes && count > 0) || count < 0 || !out || k <= 0) {
+        fprintf(stderr, "Invalid input to matcher_match_hashes.\n");
+        return -1;
+    }
+
+    memset(&m->stats, 0, sizeof(m->stats));
+    m->stats.query_hashes = count;
+
+    // Catalogs that grow under the reader (e.g. a live SQLite DB) invalidate the
+    // cache here; reading the generation also re-validates a pool's filter
+    int64_t index_generation;
+    int have_generation = m->index.generation && m->index.generation(m->index.impl, &index_generation) == 0;
+    if (!m->cache) return match_uncached(m, hashes, count, out, k);
+    if (have_generation) result_cache_sync(m->cache, index_generation);
+
+    MinHashSketch sketch;
+    uint64_t generation;
+    minhash_compute(hashes, count, &sketch);
+    int found = result_cache_lookup(m->cache, &sketch, count, out, k, &generation);
+    if (found >= 0) {
+        m->stats.cache_hit = 1;
+        return found;
+    }
+
+    found = match_uncached(m, hashes, count, out, k);
+    if (found >= 0) result_cache_store(m->cache, &sketch, count, generation, out, found, k);
+    return found;
+}
+
+// Fingerprint a clip with the given fan-out. If `peaks_out` is not NULL the
+// query peaks are handed back too (caller frees).
+static int fingerprint_query(const float* samples, int num_samples, int sample_rate, int fan_value,
+                             Peak** peaks_out, int* num_peaks_out, FingerprintHash64** out, int* count) {
+    *out = NULL;
+    *count = 0;
+    if (peaks_out) {
+        *peaks_out = NULL;
+        *num_peaks_out = 0;
+    }
+
+    float** spectrogram = NULL;
+    int num_frames = 0, num_bins = 0;
+    if (build_spectrogram_from_samples(samples, num_samples, sample_rate,
+                                       &spectrogram, &num_frames, &num_bins) != 0) {
+        fprintf(stderr, "Spectrogram generation failed for query.\n");
+        return -1;
+    }
+
+    int rc = 0;
+    int num_peaks = 0;
+    Peak* peaks = detect_peaks(spectrogram, num_frames, num_bins, &num_peaks);
+    if (!peaks) {
+        fprintf(stderr, "Peak detection failed for query.\n");
+        rc = -1;
+    } else if (num_peaks > 0) {
+        *out = generate_fingerprint_hashes_fan(peaks, num_peaks, 0, fan_value, count);  // NULL: nothing to match
+        if (!*out) *count = 0;
+    }
+
+    if (peaks_out && rc == 0) {
+        *peaks_out = peaks;
+        *num_peaks_out = num_peaks;
+    } else {
+        free(peaks);
+    }
+    free(spectrogram[0]);  // Rows share one contiguous data block
+    free(spectrogram);
+    return rc;
+}
+
+int query_fingerprint_samples(const float* samples, int num_samples, int sample_rate,
+                              FingerprintHash64** out, int* count) {
+    return fingerprint_query(samples, num_samples, sample_rate, FAN_VALUE, NULL, NULL, out, count);
+}
+
+int query_fingerprint_file(const char* path, FingerprintHash64** out, int* count) {
+    float* samples = NULL;
+    int num_samples = 0, sample_rate = 0;
+    if (load_audio(path, &samples, &num_samples, &sample_rate) != 0) {
+        fprintf(stderr, "Failed to load query audio: %s\n", path);
+        return -1;
+    }
+
+    int rc = query_fingerprint_samples(samples, num_samples, sample_rate, out, count);
+    free(samples);
+    return rc;
+}
+
+// Two-stage match: a cheaper hash vote for the leading candidates, then peak verification.
+static int match_verified(Matcher* m, const float* samples, int num_samples, int sample_rate,
+                          MatchResult* out, int k) {
+    FingerprintHash64* hashes;
+    Peak* peaks;
+    int count, num_peaks;
+    if (fingerprint_query(samples, num_samples, sample_rate, VERIFY_FAN_VALUE,
+                          &peaks, &num_peaks, &hashes, &count) != 0)
+        return -1;
+
+    int num_candidates = k > VERIFY_CANDIDATES ? k : VERIFY_CANDIDATES;
+    MatchResult* candidates = (MatchResult*)malloc(num_candidates * sizeof(MatchResult));
+    int found = candidates ? matcher_match_hashes(m, hashes, count, candidates, num_candidates) : -1;
+    if (found > 0)
+        found = verifier_check(m->verifier, peaks, num_peaks, candidates, found, &m->stats.candidates_rejected);
+    if (found > k) found = k;
+    if (found > 0) memcpy(out, candidates, found * sizeof(MatchResult));
+
+    free(candidates);
+    free(hashes);
+    free(peaks);
+    return found;
+}
+
+int matcher_match_samples(Matcher* m, const float* samples, int num_samples, int sample_rate,
+                          MatchResult* out, int k) {
+    if (m->verifier)
+        return match_verified(m, samples, num_samples, sample_rate, out, k);
+
+    FingerprintHash64* hashes;
+    int count;
+    if (query_fingerprint_samples(samples, num_samples, sample_rate, &hashes, &count) != 0)
+        return -1;
+
+    int rc = matcher_match_hashes(m, hashes, count, out, k);
+    free(hashes);
+    return rc;
+}
+
+int matcher_match_file(Matcher* m, const char* path, MatchResult* out, int k) {
+    float* samples = NULL;
+    int num_samples = 0, sample_rate = 0;
+    if (load_audio(path, &samples, &num_samples, &sample_rate) != 0) {
+        fprintf(stderr, "Failed to load query audio: %s\n", path);
+        return -1;
+    }
+
+    int rc = matcher_match_samples(m, samples, num_samples, sample_rate, out, k);
+    free(samples);
+    return rc;
+}
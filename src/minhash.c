@@ -0,0 +1,112 @@
+// File: src/minhash.c
+// One-permutation MinHash sketches of fingerprint hash sets.
+
+#include "config.h"
+#include "hashing.h"
+#include "minhash.h"
+
+#if (MINHASH_BINS & (MINHASH_BINS - 1)) != 0 || MINHASH_BINS % MINHASH_BAND_ROWS != 0
+#error "MINHASH_BINS must be a power of two and a multiple of MINHASH_BAND_ROWS"
+#endif
+#if (SONG_SKETCH_BINS & (SONG_SKETCH_BINS - 1)) != 0 || SONG_SKETCH_BINS % SONG_SKETCH_BAND_ROWS != 0
+#error "SONG_SKETCH_BINS must be a power of two and a multiple of SONG_SKETCH_BAND_ROWS"
+#endif
+
+static int bin_bits(int bins) {
+    int bits = 0;
+    while ((1 << bits) < bins) bits++;
+    return bits;
+}
+
+// Fill `bins` minimums (and, if `times` is not NULL, the time of each).
+static void compute_bins(const FingerprintHash64* hashes, int count, int bins, uint64_t* mins, int32_t* times) {
+    const int shift = 64 - bin_bits(bins);
+    for (int b = 0; b < bins; b++) {
+        mins[b] = MINHASH_EMPTY;
+        if (times) times[b] = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        uint64_t v = mix_hash64(hashes[i].hash);
+        int b = (int)(v >> shift);
+        v &= (MINHASH_EMPTY >> bin_bits(bins));    // Never equals MINHASH_EMPTY
+        if (v < mins[b] || (times && v == mins[b] && hashes[i].time_offset < times[b])) {
+            mins[b] = v;
+            if (times) times[b] = hashes[i].time_offset;
+        }
+    }
+}
+
+void minhash_compute(const FingerprintHash64* hashes, int count, MinHashSketch* out) {
+    compute_bins(hashes, count, MINHASH_BINS, out->mins, out->times);
+}
+
+float minhash_similarity(const MinHashSketch* a, const MinHashSketch* b) {
+    int agree = 0, filled = 0;
+    for (int i = 0; i < MINHASH_BINS; i++) {
+        if (a->mins[i] == MINHASH_EMPTY && b->mins[i] == MINHASH_EMPTY) continue;
+        filled++;
+        agree += a->mins[i] == b->mins[i];
+    }
+    return filled > 0 ? (float)agree / filled : 0.0f;
+}
+
+uint64_t minhash_band_key(const MinHashSketch* sketch, int band) {
+    uint64_t key = (uint64_t)band;
+    for (int r = 0; r < MINHASH_BAND_ROWS; r++)
+        key = mix_hash64(key ^ sketch->mins[band * MINHASH_BAND_ROWS + r]);
+    return key;
+}
+
+int minhash_time_shift(const MinHashSketch* a, const MinHashSketch* b) {
+    int shifts[MINHASH_BINS];
+    int n = 0;
+    for (int i = 0; i < MINHASH_BINS; i++)
+        if (a->mins[i] != MINHASH_EMPTY && a->mins[i] == b->mins[i])
+            shifts[n++] = b->times[i] - a->times[i];
+
+    // Mode; ties go to the earliest bin
+    int best = 0, best_votes = 0;
+    for (int i = 0; i < n; i++) {
+        int votes = 0;
+        for (int j = 0; j < n; j++) votes += shifts[j] == shifts[i];
+        if (votes > best_votes) {
+            best = shifts[i];
+            best_votes = votes;
+        }
+    }
+    return best;
+}
+
+// ===========================
+// Song sketches
+// ===========================
+
+void song_sketch_compute(const FingerprintHash64* hashes, int count, SongSketch* out) {
+    uint64_t mins[SONG_SKETCH_BINS];
+    compute_bins(hashes, count, SONG_SKETCH_BINS, mins, NULL);
+
+    // The top bits of a minimum are enough to tell bins apart
+    const int shift = 32 - bin_bits(SONG_SKETCH_BINS);
+    for (int b = 0; b < SONG_SKETCH_BINS; b++) {
+        uint32_t v = (uint32_t)(mins[b] >> shift);
+        out->mins[b] = mins[b] == MINHASH_EMPTY ? SONG_SKETCH_EMPTY : v == SONG_SKETCH_EMPTY ? v - 1 : v;
+    }
+}
+
+float song_sketch_similarity(const SongSketch* a, const SongSketch* b) {
+    int agree = 0, filled = 0;
+    for (int i = 0; i < SONG_SKETCH_BINS; i++) {
+        if (a->mins[i] == SONG_SKETCH_EMPTY && b->mins[i] == SONG_SKETCH_EMPTY) continue;
+        filled++;
+        agree += a->mins[i] == b->mins[i];
+    }
+    return filled > 0 ? (float)agree / filled : 0.0f;
+}
+
+uint64_t song_sketch_band_key(const SongSketch* sketch, int band) {
+    uint64_t key = (uint64_t)band;
+    for (int r = 0; r < SONG_SKETCH_BAND_ROWS; r++)
+        key = mix_hash64(key ^ sketch->mins[band * SONG_SKETCH_BAND_ROWS + r]);
+    return key;
+}
@@ -0,0 +1,453 @@
+// File: src/mmap_index.c
+// Memory-mapped binary inverted index (hash -> postings) and its builder.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "mmap_index.h"
+#include "bloom.h"
+
+#define MMAP_INDEX_MAGIC    "AFPMIDX1"
+#define MMAP_INDEX_VERSION  2         // Version 1 files (no filter) are still readable
+#define DIRECTORY_BITS      16
+#define DIRECTORY_SIZE      ((1u << DIRECTORY_BITS) + 1)
+#define SECTION_ALIGN       64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_hashes;
+    uint64_t num_postings;
+    uint64_t postings_offset;
+    uint64_t hashes_offset;
+    uint64_t starts_offset;
+    uint64_t directory_offset;
+    uint64_t filter_offset;             // Version 2+
+    uint64_t filter_blocks;
+} MmapIndexHeader;
+
+struct MmapIndex {
+    const uint8_t* base;
+    size_t size;
+    const Posting* postings;
+    const uint64_t* hashes;
+    const uint64_t* starts;
+    const uint64_t* directory;
+    BloomFilter* filter;        // View into the mapping; NULL for version 1 files
+    uint64_t num_hashes;
+    uint64_t num_postings;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+struct MmapIndexWriter {
+    FILE* file;
+    char* path;              // Final location
+    char* tmp_path;          // Written here, renamed over `path` by finish
+    uint64_t pos;            // Bytes written so far
+    uint64_t num_postings;
+
+    uint64_t* hashes;        // Unique hashes seen so far
+    uint64_t* starts;        // Posting index where each hash begins
+    uint64_t num_hashes;
+    uint64_t capacity;
+
+    int has_last;
+    uint64_t last_hash;
+    int last_song_id;
+    int last_time_offset;
+};
+
+// ===========================
+// Reader
+// ===========================
+
+static void unmap_index(MmapIndex* index) {
+#ifdef _WIN32
+    if (index->base) UnmapViewOfFile(index->base);
+    if (index->mapping) CloseHandle(index->mapping);
+    if (index->file && index->file != INVALID_HANDLE_VALUE) CloseHandle(index->file);
+#else
+    if (index->base) munmap((void*)index->base, index->size);
+#endif
+}
+
+static int map_file(MmapIndex* index, const char* path) {
+#ifdef _WIN32
+    index->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (index->file == INVALID_HANDLE_VALUE) return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(index->file, &size)) return -1;
+    index->size = (size_t)size.QuadPart;
+
+    index->mapping = CreateFileMappingA(index->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!index->mapping) return -1;
+
+    index->base = (const uint8_t*)MapViewOfFile(index->mapping, FILE_MAP_READ, 0, 0, 0);
+    return index->base ? 0 : -1;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    index->size = (size_t)st.st_size;
+
+    void* base = mmap(NULL, index->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps its own reference
+    if (base == MAP_FAILED) return -1;
+
+    index->base = (const uint8_t*)base;
+    return 0;
+#endif
+}
+
+// True if [offset, offset + count * elem) lies inside the mapping.
+static int section_fits(const MmapIndex* index, uint64_t offset, uint64_t count, uint64_t elem) {
+    if (offset > index->size) return 0;
+    return count <= (index->size - offset) / elem;
+}
+
+MmapIndex* mmap_index_open(const char* path) {
+    MmapIndex* index = (MmapIndex*)calloc(1, sizeof(MmapIndex));
+    if (!index) return NULL;
+
+    if (map_file(index, path) != 0) {
+        fprintf(stderr, "Error mapping index file: %s\n", path);
+        unmap_index(index);
+        free(index);
+        return NULL;
+    }
+
+    const MmapIndexHeader* h = (const MmapIndexHeader*)index->base;
+    if (index->size < sizeof(*h) ||
+        memcmp(h->magic, MMAP_INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version < 1 || h->version > MMAP_INDEX_VERSION ||
+        !section_fits(index, h->postings_offset, h->num_postings, sizeof(Posting)) ||
+        !section_fits(index, h->hashes_offset, h->num_hashes, sizeof(uint64_t)) ||
+        !section_fits(index, h->starts_offset, h->num_hashes + 1, sizeof(uint64_t)) ||
+        !section_fits(index, h->directory_offset, DIRECTORY_SIZE, sizeof(uint64_t))) {
+        fprintf(stderr, "Invalid or truncated index file: %s\n", path);
+        unmap_index(index);
+        free(index);
+        return NULL;
+    }
+
+    index->num_hashes = h->num_hashes;
+    index->num_postings = h->num_postings;
+    index->postings = (const Posting*)(index->base + h->postings_offset);
+    index->hashes = (const uint64_t*)(index->base + h->hashes_offset);
+    index->starts = (const uint64_t*)(index->base + h->starts_offset);
+    index->directory = (const uint64_t*)(index->base + h->directory_offset);
+
+    if (h->version >= 2 && h->filter_blocks > 0) {
+        if (!section_fits(index, h->filter_offset, h->filter_blocks, 8 * sizeof(uint64_t)) ||
+            !(index->filter = bloom_wrap(index->base + h->filter_offset, h->filter_blocks))) {
+            fprintf(stderr, "Invalid filter section in index file: %s\n", path);
+            unmap_index(index);
+            free(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+void mmap_index_close(MmapIndex* index) {
+    if (!index) return;
+    bloom_free(index->filter);
+    unmap_index(index);
+    free(index);
+}
+
+size_t mmap_index_lookup(const MmapIndex* index, uint64_t hash, const Posting** out) {
+    *out = NULL;
+    if (index->filter && !bloom_may_contain(index->filter, hash))
+        return 0;
+
+    // The prefix directory narrows the binary search to one bucket
+    uint64_t prefix = hash >> (64 - DIRECTORY_BITS);
+    uint64_t lo = index->directory[prefix];
+    uint64_t hi = index->directory[prefix + 1];
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        uint64_t h = index->hashes[mid];
+        if (h < hash) {
+            lo = mid + 1;
+        } else if (h > hash) {
+            hi = mid;
+        } else {
+            return mmap_index_postings_at(index, mid, out);
+        }
+    }
+    return 0;
+}
+
+uint64_t mmap_index_num_hashes(const MmapIndex* index) {
+    return index->num_hashes;
+}
+
+uint64_t mmap_index_num_postings(const MmapIndex* index) {
+    return index->num_postings;
+}
+
+uint64_t mmap_index_hash_at(const MmapIndex* index, uint64_t i) {
+    return index->hashes[i];
+}
+
+size_t mmap_index_postings_at(const MmapIndex* index, uint64_t i, const Posting** out) {
+    uint64_t begin = index->starts[i];
+    *out = index->postings + begin;
+    return (size_t)(index->starts[i + 1] - begin);
+}
+
+// ===========================
+// Builder
+// ===========================
+
+static int write_bytes(MmapIndexWriter* w, const void* data, size_t size) {
+    if (size && fwrite(data, 1, size, w->file) != size) return -1;
+    w->pos += size;
+    return 0;
+}
+
+static int write_padding(MmapIndexWriter* w) {
+    static const uint8_t zeros[SECTION_ALIGN] = {0};
+    size_t pad = (size_t)((SECTION_ALIGN - (w->pos % SECTION_ALIGN)) % SECTION_ALIGN);
+    return write_bytes(w, zeros, pad);
+}
+
+// Push the file's contents to stable storage.
+static int sync_file(FILE* f) {
+    if (fflush(f) != 0) return -1;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0 ? 0 : -1;
+#else
+    return fsync(fileno(f)) == 0 ? 0 : -1;
+#endif
+}
+
+// Make a rename into the directory holding `path` durable. No-op on Windows.
+static int sync_parent_dir(const char* path) {
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) return -1;
+    int fd = open(dir, O_RDONLY);
+    free(dir);
+    if (fd < 0) return -1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+// Move the finished file over the target, which readers see change atomically.
+static int install_file(const char* tmp_path, const char* path) {
+#ifdef _WIN32
+    remove(path);  // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tmp_path, path) != 0) return -1;
+    return sync_parent_dir(path);
+}
+
+MmapIndexWriter* mmap_index_writer_open(const char* path) {
+    MmapIndexWriter* w = (MmapIndexWriter*)calloc(1, sizeof(MmapIndexWriter));
+    if (!w) return NULL;
+
+    // Readers may have the current file mapped: never truncate it in place
+    w->path = strdup(path);
+    w->tmp_path = (char*)malloc(strlen(path) + sizeof(".tmp"));
+    if (w->tmp_path) {
+        strcpy(w->tmp_path, path);
+        strcat(w->tmp_path, ".tmp");
+        w->file = fopen(w->tmp_path, "wb");
+    }
+    if (!w->path || !w->file) {
+        fprintf(stderr, "Error creating index file: %s\n", w->tmp_path ? w->tmp_path : path);
+        if (w->file) fclose(w->file);
+        free(w->tmp_path);
+        free(w->path);
+        free(w);
+        return NULL;
+    }
+
+    // Header is rewritten with final counts in mmap_index_writer_finish()
+    MmapIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    if (write_bytes(w, &header, sizeof(header)) != 0 || write_padding(w) != 0) {
+        mmap_index_writer_abort(w);
+        return NULL;
+    }
+    return w;
+}
+
+int mmap_index_writer_add(MmapIndexWriter* w, uint64_t hash, int song_id, int time_offset) {
+    if (w->has_last) {
+        if (hash == w->last_hash && song_id == w->last_song_id && time_offset == w->last_time_offset)
+            return 0;  // Exact duplicate
+        int ordered = hash > w->last_hash ||
+                      (hash == w->last_hash && (song_id > w->last_song_id ||
+                       (song_id == w->last_song_id && time_offset > w->last_time_offset)));
+        if (!ordered) {
+            fprintf(stderr, "Index builder: records out of order.\n");
+            return -1;
+        }
+    }
+
+    if (!w->has_last || hash != w->last_hash) {
+        if (w->num_hashes == w->capacity) {
+            uint64_t capacity = w->capacity ? w->capacity * 2 : 4096;
+            uint64_t* hashes = realloc(w->hashes, capacity * sizeof(uint64_t));
+            if (!hashes) return -1;
+            w->hashes = hashes;
+            uint64_t* starts = realloc(w->starts, capacity * sizeof(uint64_t));
+            if (!starts) return -1;
+            w->starts = starts;
+            w->capacity = capacity;
+        }
+        w->hashes[w->num_hashes] = hash;
+        w->starts[w->num_hashes] = w->num_postings;
+        w->num_hashes++;
+    }
+
+    Posting p = { song_id, time_offset };
+    if (write_bytes(w, &p, sizeof(p)) != 0) return -1;
+    w->num_postings++;
+
+    w->has_last = 1;
+    w->last_hash = hash;
+    w->last_song_id = song_id;
+    w->last_time_offset = time_offset;
+    return 0;
+}
+
+int mmap_index_writer_finish(MmapIndexWriter* w) {
+    MmapIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MMAP_INDEX_MAGIC, sizeof(header.magic));
+    header.version = MMAP_INDEX_VERSION;
+    header.num_hashes = w->num_hashes;
+    header.num_postings = w->num_postings;
+    header.postings_offset = (sizeof(header) + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN;
+
+    uint64_t* directory = (uint64_t*)malloc(DIRECTORY_SIZE * sizeof(uint64_t));
+    BloomFilter* filter = bloom_create(w->num_hashes);
+    if (!directory || !filter) {
+        free(directory);
+        bloom_free(filter);
+        mmap_index_writer_abort(w);
+        return -1;
+    }
+    for (uint64_t k = 0; k < w->num_hashes; k++)
+        bloom_add(filter, w->hashes[k]);
+
+    // directory[p] = first hash index whose 16-bit prefix is >= p
+    uint64_t i = 0;
+    for (uint64_t p = 0; p < DIRECTORY_SIZE; p++) {
+        while (i < w->num_hashes && (w->hashes[i] >> (64 - DIRECTORY_BITS)) < p) i++;
+        directory[p] = i;
+    }
+
+    uint64_t end = w->num_postings;
+    int rc = write_padding(w);
+    header.hashes_offset = w->pos;
+    rc |= write_bytes(w, w->hashes, w->num_hashes * sizeof(uint64_t));
+    rc |= write_padding(w);
+    header.starts_offset = w->pos;
+    rc |= write_bytes(w, w->starts, w->num_hashes * sizeof(uint64_t));
+    rc |= write_bytes(w, &end, sizeof(end));
+    rc |= write_padding(w);
+    header.directory_offset = w->pos;
+    rc |= write_bytes(w, directory, DIRECTORY_SIZE * sizeof(uint64_t));
+    rc |= write_padding(w);
+    header.filter_offset = w->pos;
+    header.filter_blocks = bloom_num_blocks(filter);
+    rc |= write_bytes(w, bloom_blocks(filter), bloom_size_bytes(filter));
+    free(directory);
+    bloom_free(filter);
+
+    if (rc == 0) {
+        rewind(w->file);
+        rc = fwrite(&header, sizeof(header), 1, w->file) == 1 ? 0 : -1;
+    }
+    if (rc == 0) rc = sync_file(w->file);
+
+    if (rc != 0) {
+        fprintf(stderr, "Error writing index file: %s\n", w->path);
+        mmap_index_writer_abort(w);
+        return -1;
+    }
+
+    rc = fclose(w->file) == 0 ? 0 : -1;
+    w->file = NULL;
+    if (rc == 0 && install_file(w->tmp_path, w->path) != 0) {
+        fprintf(stderr, "Error installing index file: %s\n", w->path);
+        rc = -1;
+    }
+    if (rc != 0) {
+        mmap_index_writer_abort(w);
+        return -1;
+    }
+    free(w->hashes);
+    free(w->starts);
+    free(w->tmp_path);
+    free(w->path);
+    free(w);
+    return 0;
+}
+
+// Leaves any existing file at the target path untouched.
+void mmap_index_writer_abort(MmapIndexWriter* w) {
+    if (!w) return;
+    if (w->file) fclose(w->file);
+    if (w->tmp_path) remove(w->tmp_path);
+    free(w->hashes);
+    free(w->starts);
+    free(w->tmp_path);
+    free(w->path);
+    free(w);
+}
+
+static int add_scanned(uint64_t hash, int song_id, int time_offset, void* user) {
+    return mmap_index_writer_add((MmapIndexWriter*)user, hash, song_id, time_offset);
+}
+
+int mmap_index_build_from_db(db_ctx* ctx, const char* path) {
+    MmapIndexWriter* w = mmap_index_writer_open(path);
+    if (!w) return -1;
+
+    if (db_scan_fingerprints(ctx, add_scanned, w) != 0) {
+        fprintf(stderr, "Failed to build index from database.\n");
+        mmap_index_writer_abort(w);
+        return -1;
+    }
+
+    uint64_t hashes = w->num_hashes, postings = w->num_postings;
+    if (mmap_index_writer_finish(w) != 0) return -1;
+
+    printf("Built index %s: %llu hashes, %llu postings.\n", path,
+           (unsigned long long)hashes, (unsigned long long)postings);
+    return 0;
+}
@@ -33,6 +33,22 @@ static int is_local_maximum(float** spectrogram, int t, int f, int num_frames, i
     return 1;
 }
 
+int detect_frame_peaks(float** spectrogram, int num_frames, int num_bins, int frame, int time_index, Peak* out) {
+    int count = 0;
+    for (int f = 1; f < num_bins - 1; f++) {
+        float db_mag = magnitude_to_db(spectrogram[frame][f]);
+
+        if (db_mag >= THRESHOLD_MAGNITUDE &&
+            is_local_maximum(spectrogram, frame, f, num_frames, num_bins)) {
+            out[count].time_index = time_index;
+            out[count].freq_bin = f;
+            out[count].magnitude = db_mag;
+            count++;
+        }
+    }
+    return count;
+}
+
 // Detect peaks in the spectrogram and return an array of Peak structs.
 // Returns dynamically allocated array (caller must free), and sets num_peaks_out.
 Peak* detect_peaks(float** spectrogram, int num_frames, int num_bins, int* num_peaks_out) {
@@ -51,29 +67,19 @@ Peak* detect_peaks(float** spectrogram, int num_frames, int num_bins, int* num_p
     int count = 0;
 
     for (int t = 0; t < num_frames; t++) {
-        for (int f = 1; f < num_bins - 1; f++) {
-            float db_mag = magnitude_to_db(spectrogram[t][f]);
-
-            if (db_mag >= THRESHOLD_MAGNITUDE &&
-                is_local_maximum(spectrogram, t, f, num_frames, num_bins)) {
-                
-                if (count >= capacity) {
-                    capacity *= 2;
-                    Peak* temp = realloc(peaks, capacity * sizeof(Peak));
-                    if (!temp) {
-                        fprintf(stderr, "Reallocation failed in detect_peaks()\n");
-                        free(peaks);
-                        return NULL;
-                    }
-                    peaks = temp;
-                }
-
-                peaks[count].time_index = t;
-                peaks[count].freq_bin = f;
-                peaks[count].magnitude = db_mag;
-                count++;
+        // A frame yields at most num_bins peaks
+        while (count + num_bins > capacity) {
+            capacity *= 2;
+            Peak* temp = realloc(peaks, capacity * sizeof(Peak));
+            if (!temp) {
+                fprintf(stderr, "Reallocation failed in detect_peaks()\n");
+                free(peaks);
+                return NULL;
             }
+            peaks = temp;
         }
+
+        count += detect_frame_peaks(spectrogram, num_frames, num_bins, t, t, peaks + count);
     }
 
     *num_peaks_out = count;
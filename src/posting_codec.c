@@ -0,0 +1,212 @@
+// File: src/posting_codec.c
+// Delta + bit-packed posting list codec with an SSE2 block decoder.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "posting_codec.h"
+
+#define LANES 4
+#define VALUES_PER_LANE (POSTING_BLOCK_SIZE / LANES)
+
+// ===========================
+// Varints
+// ===========================
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t get_varint(const uint8_t* in, uint64_t* v) {
+    uint64_t result = 0;
+    size_t n = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = in[n++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    *v = result;
+    return n;
+}
+
+// ===========================
+// Bit packing (4-lane vertical layout)
+// ===========================
+
+// Value i lives in lane i % 4 at position i / 4; each lane is a run of `bits`
+// 32-bit words, and word j of all four lanes is stored contiguously.
+
+static int bits_needed(const uint32_t* v, int n) {
+    uint32_t acc = 0;
+    for (int i = 0; i < n; i++) acc |= v[i];
+    int bits = 0;
+    while (acc) {
+        bits++;
+        acc >>= 1;
+    }
+    return bits;
+}
+
+static size_t pack_block(const uint32_t* in, int bits, uint8_t* out) {
+    size_t words = (size_t)LANES * bits;
+    uint32_t packed[LANES * 32];
+    memset(packed, 0, words * sizeof(uint32_t));
+
+    for (int lane = 0; lane < LANES; lane++) {
+        int bitpos = 0;
+        for (int k = 0; k < VALUES_PER_LANE; k++) {
+            uint32_t v = in[k * LANES + lane];
+            int word = bitpos / 32, offset = bitpos % 32;
+            packed[word * LANES + lane] |= v << offset;
+            if (offset + bits > 32)
+                packed[(word + 1) * LANES + lane] |= v >> (32 - offset);
+            bitpos += bits;
+        }
+    }
+
+    memcpy(out, packed, words * sizeof(uint32_t));
+    return words * sizeof(uint32_t);
+}
+
+static size_t unpack_block(const uint8_t* in, int bits, uint32_t* out) {
+    if (bits == 0) {
+        memset(out, 0, POSTING_BLOCK_SIZE * sizeof(uint32_t));
+        return 0;
+    }
+
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32(bits == 32 ? -1 : (int)((1u << bits) - 1));
+    const __m128i* src = (const __m128i*)in;
+    __m128i cur = _mm_loadu_si128(src++);
+    int shift = 0;
+
+    for (int k = 0; k < VALUES_PER_LANE; k++) {
+        __m128i v = _mm_srl_epi32(cur, _mm_cvtsi32_si128(shift));
+        shift += bits;
+        if (shift >= 32 && k + 1 < VALUES_PER_LANE) {
+            shift -= 32;
+            cur = _mm_loadu_si128(src++);
+            if (shift > 0)
+                v = _mm_or_si128(v, _mm_sll_epi32(cur, _mm_cvtsi32_si128(bits - shift)));
+        }
+        _mm_storeu_si128((__m128i*)(out + k * LANES), _mm_and_si128(v, mask));
+    }
+#else
+    const uint32_t mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    uint32_t words[LANES * 32];
+    memcpy(words, in, (size_t)LANES * bits * sizeof(uint32_t));
+
+    for (int lane = 0; lane < LANES; lane++) {
+        int bitpos = 0;
+        for (int k = 0; k < VALUES_PER_LANE; k++) {
+            int word = bitpos / 32, offset = bitpos % 32;
+            uint64_t v = words[word * LANES + lane] >> offset;
+            if (offset + bits > 32)
+                v |= (uint64_t)words[(word + 1) * LANES + lane] << (32 - offset);
+            out[k * LANES + lane] = (uint32_t)v & mask;
+            bitpos += bits;
+        }
+    }
+#endif
+
+    return (size_t)LANES * bits * sizeof(uint32_t);
+}
+
+// ===========================
+// Posting lists
+// ===========================
+
+size_t posting_codec_max_encoded_size(size_t n) {
+    // count varint + two 5-byte varints per tail entry, which also covers full blocks
+    return 10 + n * 10 + (n / POSTING_BLOCK_SIZE) * 2;
+}
+
+size_t posting_codec_encode(const Posting* in, size_t n, uint8_t* out) {
+    size_t pos = put_varint(out, n);
+    uint32_t song_gaps[POSTING_BLOCK_SIZE];
+    uint32_t times[POSTING_BLOCK_SIZE];
+    int prev_song = 0, prev_time = 0;
+    size_t i = 0;
+
+    for (; i + POSTING_BLOCK_SIZE <= n; i += POSTING_BLOCK_SIZE) {
+        for (int k = 0; k < POSTING_BLOCK_SIZE; k++) {
+            const Posting* p = &in[i + k];
+            song_gaps[k] = (uint32_t)(p->song_id - prev_song);
+            times[k] = song_gaps[k] ? (uint32_t)p->time_offset : (uint32_t)(p->time_offset - prev_time);
+            prev_song = p->song_id;
+            prev_time = p->time_offset;
+        }
+
+        int song_bits = bits_needed(song_gaps, POSTING_BLOCK_SIZE);
+        int time_bits = bits_needed(times, POSTING_BLOCK_SIZE);
+        out[pos++] = (uint8_t)song_bits;
+        out[pos++] = (uint8_t)time_bits;
+        pos += pack_block(song_gaps, song_bits, out + pos);
+        pos += pack_block(times, time_bits, out + pos);
+    }
+
+    for (; i < n; i++) {
+        const Posting* p = &in[i];
+        uint32_t gap = (uint32_t)(p->song_id - prev_song);
+        uint32_t t = gap ? (uint32_t)p->time_offset : (uint32_t)(p->time_offset - prev_time);
+        pos += put_varint(out + pos, gap);
+        pos += put_varint(out + pos, t);
+        prev_song = p->song_id;
+        prev_time = p->time_offset;
+    }
+
+    return pos;
+}
+
+size_t posting_codec_count(const uint8_t* in) {
+    uint64_t n;
+    get_varint(in, &n);
+    return (size_t)n;
+}
+
+size_t posting_codec_decode(const uint8_t* in, Posting* out, size_t* consumed) {
+    uint64_t n;
+    size_t pos = get_varint(in, &n);
+    uint32_t song_gaps[POSTING_BLOCK_SIZE];
+    uint32_t times[POSTING_BLOCK_SIZE];
+    int song = 0, time = 0;
+    size_t i = 0;
+
+    for (; i + POSTING_BLOCK_SIZE <= n; i += POSTING_BLOCK_SIZE) {
+        int song_bits = in[pos++];
+        int time_bits = in[pos++];
+        pos += unpack_block(in + pos, song_bits, song_gaps);
+        pos += unpack_block(in + pos, time_bits, times);
+
+        for (int k = 0; k < POSTING_BLOCK_SIZE; k++) {
+            song += (int)song_gaps[k];
+            time = song_gaps[k] ? (int)times[k] : time + (int)times[k];
+            out[i + k].song_id = song;
+            out[i + k].time_offset = time;
+        }
+    }
+
+    for (; i < n; i++) {
+        uint64_t gap, t;
+        pos += get_varint(in + pos, &gap);
+        pos += get_varint(in + pos, &t);
+        song += (int)gap;
+        time = gap ? (int)t : time + (int)t;
+        out[i].song_id = song;
+        out[i].time_offset = time;
+    }
+
+    if (consumed) *consumed = pos;
+    return (size_t)n;
+}
@@ -0,0 +1,412 @@
+// File: src/query_entry.c
+// Command-line front end: identify audio clips against the fingerprint catalog.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "db.h"
+#include "bloom.h"
+#include "fingerprint_index.h"
+#include "matcher.h"
+#include "batch_match.h"
+#include "thread_pool.h"
+#include "stream_recognizer.h"
+#include "audio_io.h"
+#include "segmenter.h"
+#include "result_cache.h"
+#include "verifier.h"
+
+#define MAX_PATH_LEN 1024
+#define MAX_NAME_LEN 256
+#define MAX_TOP_K    64
+#define STREAM_CHUNK 4096   // Samples per push when replaying a feed
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--index PATH | --memory | --compressed | --shards N | --lsm DIR]\n"
+            "          [--progressive | --batch | --threads N | --stream | --segment] [--cache N]\n"
+            "          [--verify] [--budget N [--sample]]\n"
+            "          [-k N] FILE...\n"
+            "  (default)      query the SQLite catalog at %s\n"
+            "  --index PATH   memory-mapped index file built with song_entry --index\n"
+            "  --memory       load the catalog into an in-memory hash index first\n"
+            "  --compressed   load the catalog into a compressed in-memory index first\n"
+            "  --shards N     query the N shard files next to the DB\n"
+            "  --lsm DIR      query the segmented index in DIR\n"
+            "  --progressive  scan rare hashes first and stop once the winner is certain\n"
+            "  --batch        fingerprint all files, then match them in one pass over the\n"
+            "                 sorted catalog (SQLite or --index only)\n"
+            "  --threads N    split each query's lookups and voting across N threads\n"
+            "                 (not with --shards)\n"
+            "  --stream       treat each FILE as a live feed and report songs as they\n"
+            "                 start and stop; '-' reads raw mono float32 PCM at %d Hz\n"
+            "                 from stdin\n"
+            "  --segment      split long recordings into overlapping windows and print\n"
+            "                 a timeline of the songs they contain\n"
+            "  --cache N      reuse answers for near-identical queries (repeated\n"
+            "                 jingles in --segment) from an N-entry cache\n"
+            "  --verify       check the leading candidates against the stored song\n"
+            "                 peaks and drop those that do not line up (not with\n"
+            "                 --batch or --stream)\n"
+            "  --budget N     cap each query at N postings, rarest hashes first, and\n"
+            "                 at most %d sampled hashes (not with --progressive,\n"
+            "                 --batch, --threads or --stream)\n"
+            "  --sample       with --budget: take the sampled hashes in query order\n"
+            "                 instead of counting their lists first\n",
+            prog, DB_PATH, SAMPLE_RATE, MATCH_BUDGET_HASHES);
+}
+
+// Warn when the catalog was fingerprinted with a different hash layout.
+static void check_hash_layout(db_ctx* db) {
+    int64_t layout = 0;
+    if (db_get_meta(db, "hash_layout", &layout) != 1 || layout != HASH_LAYOUT_VERSION)
+        fprintf(stderr, "Warning: catalog was not built with hash layout %d; "
+                        "re-ingest it or matches will be missed.\n", HASH_LAYOUT_VERSION);
+}
+
+static void print_results(db_ctx* db, const char* path, const MatchResult* results, int found,
+                          const MatchStats* stats, double elapsed_ms) {
+    printf("%s: %d hashes, %lld postings, %.1f ms%s%s\n",
+           path, stats->query_hashes, stats->postings, elapsed_ms,
+           stats->terminated_early ? " (stopped early)" : stats->cache_hit ? " (cached)" : "",
+           stats->budget_hit ? " (budget hit)" : "");
+    if (stats->candidates_rejected > 0)
+        printf("  %d candidate(s) rejected by verification\n", stats->candidates_rejected);
+    if (found == 0) {
+        printf("  No match.\n");
+        return;
+    }
+
+    for (int i = 0; i < found; i++) {
+        char name[MAX_NAME_LEN] = "?", artist[MAX_NAME_LEN] = "?";
+        db_get_song(db, results[i].song_id, name, sizeof(name), artist, sizeof(artist));
+        printf("  #%d  %s - %s (id=%d)  score=%d  offset=%.2fs\n", i + 1, artist, name,
+               results[i].song_id, results[i].score, results[i].offset_seconds);
+    }
+}
+
+static void print_stream_event(const StreamEvent* event, void* user) {
+    db_ctx* db = (db_ctx*)user;
+    char name[MAX_NAME_LEN] = "?", artist[MAX_NAME_LEN] = "?";
+    db_get_song(db, event->song_id, name, sizeof(name), artist, sizeof(artist));
+    printf("[%8.1fs] %s %s - %s (id=%d)  score=%.1f  at %.1fs\n", event->stream_seconds,
+           event->type == STREAM_EVENT_MATCH ? "MATCH" : "END  ", artist, name, event->song_id,
+           event->score, event->song_seconds);
+    fflush(stdout);
+}
+
+// Replay a file, or read stdin, through a streaming recognizer in small chunks.
+static int run_stream(db_ctx* db, FingerprintIndex index, const char* path) {
+    StreamRecognizer* rec = stream_recognizer_create(index, print_stream_event, db);
+    if (!rec) return 1;
+
+    int rc = 0;
+    if (strcmp(path, "-") == 0) {
+        float chunk[STREAM_CHUNK];
+        size_t n;
+        while (rc == 0 && (n = fread(chunk, sizeof(float), STREAM_CHUNK, stdin)) > 0)
+            rc = stream_recognizer_push(rec, chunk, (int)n) == 0 ? 0 : 1;
+    } else {
+        float* samples = NULL;
+        int num_samples = 0, sample_rate = 0;
+        if (load_audio(path, &samples, &num_samples, &sample_rate) != 0 || sample_rate != SAMPLE_RATE) {
+            fprintf(stderr, "Failed to load stream audio: %s\n", path);
+            rc = 1;
+        }
+        for (int i = 0; rc == 0 && i < num_samples; i += STREAM_CHUNK) {
+            int n = num_samples - i < STREAM_CHUNK ? num_samples - i : STREAM_CHUNK;
+            rc = stream_recognizer_push(rec, samples + i, n) == 0 ? 0 : 1;
+        }
+        free(samples);
+    }
+
+    stream_recognizer_free(rec);
+    return rc;
+}
+
+// hh:mm:ss; at most "1193046:28:15" (14 bytes) after clamping to 32 bits.
+static void format_time(double seconds, char* out, size_t size) {
+    unsigned s = seconds <= 0 ? 0 : seconds >= UINT_MAX ? UINT_MAX : (unsigned)seconds;
+    snprintf(out, size, "%02u:%02u:%02u", s / 3600, s / 60 % 60, s % 60);
+}
+
+// Match a long recording window by window and print the stitched timeline.
+static int run_segment(db_ctx* db, Matcher* matcher, const char* path) {
+    double start = now_ms();
+    TimelineEntry* timeline;
+    int count;
+    if (segment_file(matcher, path, &timeline, &count) != 0) return 1;
+
+    printf("%s: %d segments, %.1f s\n", path, count, (now_ms() - start) / 1000.0);
+    for (int i = 0; i < count; i++) {
+        char name[MAX_NAME_LEN] = "?", artist[MAX_NAME_LEN] = "?";
+        char from[16], to[16];
+        db_get_song(db, timeline[i].song_id, name, sizeof(name), artist, sizeof(artist));
+        format_time(timeline[i].start_seconds, from, sizeof(from));
+        format_time(timeline[i].end_seconds, to, sizeof(to));
+        printf("  %s - %s  %s - %s (id=%d)  score=%d  from %.1fs\n", from, to, artist, name,
+               timeline[i].song_id, timeline[i].score, timeline[i].song_start_seconds);
+    }
+    free(timeline);
+    return 0;
+}
+
+// Fingerprint every file, then merge-join all of them against the catalog at once.
+static int run_batch(db_ctx* db, MmapIndex* mmap_index, char** paths, int num_paths, int k) {
+    BatchQuery* queries = (BatchQuery*)calloc(num_paths, sizeof(BatchQuery));
+    MatchResult* results = (MatchResult*)malloc((size_t)num_paths * k * sizeof(MatchResult));
+    int* found = (int*)calloc(num_paths, sizeof(int));
+    int rc = queries && results && found ? 0 : 1;
+
+    double start = now_ms();
+    for (int i = 0; rc == 0 && i < num_paths; i++) {
+        FingerprintHash64* hashes;
+        if (query_fingerprint_file(paths[i], &hashes, &queries[i].count) != 0) {
+            fprintf(stderr, "Query failed: %s\n", paths[i]);
+            rc = 1;
+        }
+        queries[i].hashes = hashes;
+    }
+    double fingerprinted = now_ms();
+
+    if (rc == 0) {
+        rc = (mmap_index ? batch_match_mmap(mmap_index, queries, num_paths, results, k, found)
+                         : batch_match_db(db, queries, num_paths, results, k, found)) == 0 ? 0 : 1;
+    }
+    double matched = now_ms();
+
+    if (rc == 0) {
+        printf("Batch of %d clips: fingerprinting %.1f ms, matching %.1f ms\n",
+               num_paths, fingerprinted - start, matched - fingerprinted);
+        for (int i = 0; i < num_paths; i++) {
+            MatchStats stats;
+            memset(&stats, 0, sizeof(stats));
+            stats.query_hashes = queries[i].count;
+            print_results(db, paths[i], results + (size_t)i * k, found[i], &stats, 0.0);
+        }
+    }
+
+    for (int i = 0; queries && i < num_paths; i++)
+        free((void*)queries[i].hashes);
+    free(queries);
+    free(results);
+    free(found);
+    return rc;
+}
+
+int main(int argc, char** argv) {
+    const char* index_path = NULL;
+    const char* lsm_dir = NULL;
+    int use_memory = 0, use_compressed = 0, num_shards = 0;
+    int progressive = 0, batch = 0, stream = 0, segment = 0, num_threads = 0, cache_entries = 0;
+    int verify = 0, sample = 0;
+    long long budget = 0;
+    int k = MATCH_TOP_K;
+
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "--index") == 0 && argi + 1 < argc) {
+            index_path = argv[++argi];
+        } else if (strcmp(argv[argi], "--memory") == 0) {
+            use_memory = 1;
+        } else if (strcmp(argv[argi], "--compressed") == 0) {
+            use_compressed = 1;
+        } else if (strcmp(argv[argi], "--shards") == 0 && argi + 1 < argc) {
+            num_shards = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "--lsm") == 0 && argi + 1 < argc) {
+            lsm_dir = argv[++argi];
+        } else if (strcmp(argv[argi], "--progressive") == 0) {
+            progressive = 1;
+        } else if (strcmp(argv[argi], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[argi], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[argi], "--segment") == 0) {
+            segment = 1;
+        } else if (strcmp(argv[argi], "--threads") == 0 && argi + 1 < argc) {
+            num_threads = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "--cache") == 0 && argi + 1 < argc) {
+            cache_entries = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "--verify") == 0) {
+            verify = 1;
+        } else if (strcmp(argv[argi], "--budget") == 0 && argi + 1 < argc) {
+            budget = atoll(argv[++argi]);
+        } else if (strcmp(argv[argi], "--sample") == 0) {
+            sample = 1;
+        } else if (strcmp(argv[argi], "-k") == 0 && argi + 1 < argc) {
+            k = atoi(argv[++argi]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int backends = (index_path != NULL) + use_memory + use_compressed + (num_shards > 0) + (lsm_dir != NULL);
+    int batch_ok = !batch || (!progressive && (backends == 0 || index_path));
+    int threads_ok = num_threads == 0 || (num_threads > 0 && !progressive && !batch && num_shards == 0);
+    int stream_ok = !stream || (!progressive && !batch && !segment && num_threads == 0);
+    int segment_ok = !segment || !batch;
+    int verify_ok = !verify || (!batch && !stream);
+    int budget_ok = budget == 0 ? !sample : budget > 0 && !progressive && !batch && !stream && num_threads == 0;
+    if (argi == argc || backends > 1 || !batch_ok || !threads_ok || !stream_ok || !segment_ok || k <= 0 || k > MAX_TOP_K ||
+        cache_entries < 0 || !verify_ok || !budget_ok) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Song names always come from the main DB
+    db_ctx* db = db_open_ctx(DB_PATH, DB_CTX_READONLY);
+    if (!db) {
+        fprintf(stderr, "Failed to open catalog at %s\n", DB_PATH);
+        return 1;
+    }
+    check_hash_layout(db);
+
+    MmapIndex* mmap_index = NULL;
+    HashIndex* hash_index = NULL;
+    CompressedIndex* compressed = NULL;
+    ShardSet* shards = NULL;
+    LsmIndex* lsm = NULL;
+    LsmSnapshot* snapshot = NULL;
+    BloomFilter* filter = NULL;
+    db_pool* pool = NULL;
+    ThreadPool* workers = NULL;
+    ResultCache* cache = NULL;
+    Verifier* verifier = NULL;
+    FingerprintIndex index;
+    int ok = 1;
+
+    if (index_path) {
+        ok = (mmap_index = mmap_index_open(index_path)) != NULL;
+        if (ok) index = fingerprint_index_from_mmap(mmap_index);
+    } else if (use_memory) {
+        ok = (hash_index = hash_index_load_from_db(db)) != NULL;
+        if (ok) index = fingerprint_index_from_hash(hash_index);
+    } else if (use_compressed) {
+        ok = (compressed = compressed_index_load_from_db(db)) != NULL;
+        if (ok) index = fingerprint_index_from_compressed(compressed);
+    } else if (num_shards > 0) {
+        ok = (shards = shard_set_open(DB_PATH, num_shards, DB_CTX_READONLY)) != NULL;
+        if (ok) index = fingerprint_index_from_shards(shards);
+    } else if (lsm_dir) {
+        ok = (lsm = lsm_index_open(lsm_dir, LSM_OPEN_READONLY)) != NULL;
+        if (ok) {
+            snapshot = lsm_index_acquire(lsm);
+            index = fingerprint_index_from_lsm(snapshot);
+        }
+    } else {
+        char filter_path[MAX_PATH_LEN];
+        snprintf(filter_path, sizeof(filter_path), "%s%s", DB_PATH, BLOOM_FILE_SUFFIX);
+        struct stat filter_stat;
+        if (stat(filter_path, &filter_stat) == 0 && (filter = bloom_load_current(filter_path, db)))
+            db_set_filter(db, filter);
+
+        // Parallel lookups each need their own connection
+        if (num_threads > 0) {
+            ok = (pool = db_pool_open(DB_PATH, num_threads)) != NULL;
+            if (ok) {
+                db_pool_set_filter(pool, filter);
+                index = fingerprint_index_from_pool(pool);
+            }
+        } else {
+            index = fingerprint_index_from_db(db);
+        }
+    }
+
+    Matcher* matcher = ok ? matcher_create(index) : NULL;
+    int rc = matcher ? 0 : 1;
+    if (!matcher) fprintf(stderr, "Failed to open the fingerprint index.\n");
+    if (matcher && progressive) matcher_set_mode(matcher, MATCH_PROGRESSIVE);
+    if (matcher && budget > 0) {
+        matcher_set_mode(matcher, MATCH_BOUNDED);
+        matcher_set_budget(matcher, budget, MATCH_BUDGET_HASHES, sample ? MATCH_SELECT_SAMPLE : MATCH_SELECT_RAREST);
+    }
+    if (matcher && num_threads > 0) {
+        workers = thread_pool_create(num_threads);
+        if (!workers || matcher_set_thread_pool(matcher, workers) != 0) {
+            fprintf(stderr, "Failed to set up %d query threads.\n", num_threads);
+            matcher_free(matcher);
+            matcher = NULL;
+            rc = 1;
+        }
+    }
+
+    if (matcher && cache_entries > 0) {
+        if ((cache = result_cache_create(cache_entries))) {
+            matcher_set_result_cache(matcher, cache);
+        } else {
+            matcher_free(matcher);
+            matcher = NULL;
+            rc = 1;
+        }
+    }
+
+    // Song peaks live in the main DB whichever index serves the hashes
+    if (matcher && verify) {
+        if ((verifier = verifier_create(db))) {
+            matcher_set_verifier(matcher, verifier);
+        } else {
+            matcher_free(matcher);
+            matcher = NULL;
+            rc = 1;
+        }
+    }
+
+    if (matcher && batch) {
+        rc = run_batch(db, mmap_index, argv + argi, argc - argi, k);
+        argi = argc;
+    }
+
+    for (; matcher && segment && argi < argc; argi++) {
+        if (run_segment(db, matcher, argv[argi]) != 0) {
+            fprintf(stderr, "Segmentation failed: %s\n", argv[argi]);
+            rc = 1;
+        }
+    }
+
+    for (; matcher && stream && argi < argc; argi++) {
+        if (run_stream(db, index, argv[argi]) != 0) {
+            fprintf(stderr, "Stream failed: %s\n", argv[argi]);
+            rc = 1;
+        }
+    }
+
+    MatchResult results[MAX_TOP_K];
+    for (; matcher && argi < argc; argi++) {
+        double start = now_ms();
+        int found = matcher_match_file(matcher, argv[argi], results, k);
+        double elapsed = now_ms() - start;
+
+        if (found < 0) {
+            fprintf(stderr, "Query failed: %s\n", argv[argi]);
+            rc = 1;
+            continue;
+        }
+        print_results(db, argv[argi], results, found, matcher_last_stats(matcher), elapsed);
+    }
+
+    matcher_free(matcher);
+    result_cache_free(cache);
+    verifier_free(verifier);
+    thread_pool_destroy(workers);
+    db_pool_close(pool);
+    if (snapshot) lsm_index_release(lsm, snapshot);
+    lsm_index_close(lsm);
+    shard_set_close(shards);
+    compressed_index_free(compressed);
+    hash_index_free(hash_index);
+    mmap_index_close(mmap_index);
+    db_close_ctx(db);
+    bloom_free(filter);
+    return rc;
+}
@@ -0,0 +1,251 @@
+// File: src/result_cache.c
+// LRU match-result cache with MinHash LSH probing.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "config.h"
+#include "result_cache.h"
+
+typedef struct {
+    MinHashSketch sketch;
+    uint64_t band_keys[MINHASH_BANDS];
+    int band_next[MINHASH_BANDS];   // Next node in the band's bucket chain
+    int lru_prev, lru_next;         // Entry indices; -1 at either end
+    MatchResult* results;
+    int found;
+    int k;
+} CacheEntry;
+
+// Bucket chains link nodes: node = entry * MINHASH_BANDS + band
+struct ResultCache {
+    pthread_mutex_t lock;
+    CacheEntry* entries;
+    int capacity;
+    int used;
+    int lru_head, lru_tail;         // Most and least recently used
+    int* buckets;
+    uint64_t bucket_mask;
+    uint64_t generation;            // Bumped on every invalidation
+    int64_t index_generation;       // Last value passed to result_cache_sync
+    int synced;
+    ResultCacheStats stats;
+};
+
+ResultCache* result_cache_create(int capacity) {
+    if (capacity <= 0) {
+        fprintf(stderr, "Invalid result cache capacity: %d\n", capacity);
+        return NULL;
+    }
+
+    ResultCache* c = (ResultCache*)calloc(1, sizeof(ResultCache));
+    if (!c) return NULL;
+
+    size_t buckets = 1;
+    while (buckets < (size_t)capacity * MINHASH_BANDS * 2) buckets <<= 1;
+    c->entries = (CacheEntry*)calloc(capacity, sizeof(CacheEntry));
+    c->buckets = (int*)malloc(buckets * sizeof(int));
+    if (!c->entries || !c->buckets) {
+        fprintf(stderr, "Memory allocation failed for result cache.\n");
+        free(c->entries);
+        free(c->buckets);
+        free(c);
+        return NULL;
+    }
+
+    pthread_mutex_init(&c->lock, NULL);
+    c->capacity = capacity;
+    c->bucket_mask = buckets - 1;
+    c->lru_head = c->lru_tail = -1;
+    memset(c->buckets, 0xFF, buckets * sizeof(int));
+    return c;
+}
+
+void result_cache_free(ResultCache* c) {
+    if (!c) return;
+    for (int i = 0; i < c->used; i++) free(c->entries[i].results);
+    free(c->entries);
+    free(c->buckets);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+// ===========================
+// LRU list and band chains (caller holds the lock)
+// ===========================
+
+static void lru_unlink(ResultCache* c, int e) {
+    CacheEntry* entry = &c->entries[e];
+    if (entry->lru_prev >= 0) c->entries[entry->lru_prev].lru_next = entry->lru_next;
+    else c->lru_head = entry->lru_next;
+    if (entry->lru_next >= 0) c->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    else c->lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(ResultCache* c, int e) {
+    CacheEntry* entry = &c->entries[e];
+    entry->lru_prev = -1;
+    entry->lru_next = c->lru_head;
+    if (c->lru_head >= 0) c->entries[c->lru_head].lru_prev = e;
+    c->lru_head = e;
+    if (c->lru_tail < 0) c->lru_tail = e;
+}
+
+static void bands_link(ResultCache* c, int e) {
+    CacheEntry* entry = &c->entries[e];
+    for (int b = 0; b < MINHASH_BANDS; b++) {
+        int* head = &c->buckets[entry->band_keys[b] & c->bucket_mask];
+        entry->band_next[b] = *head;
+        *head = e * MINHASH_BANDS + b;
+    }
+}
+
+static void bands_unlink(ResultCache* c, int e) {
+    CacheEntry* entry = &c->entries[e];
+    for (int b = 0; b < MINHASH_BANDS; b++) {
+        int node = e * MINHASH_BANDS + b;
+        int* link = &c->buckets[entry->band_keys[b] & c->bucket_mask];
+        while (*link != node)
+            link = &c->entries[*link / MINHASH_BANDS].band_next[*link % MINHASH_BANDS];
+        *link = entry->band_next[b];
+    }
+}
+
+// Most similar entry sharing a band with the query, or -1 below the threshold.
+static int find_similar(ResultCache* c, const MinHashSketch* sketch, const uint64_t* keys) {
+    int best = -1;
+    float best_similarity = RESULT_CACHE_MIN_SIMILARITY;
+    for (int b = 0; b < MINHASH_BANDS; b++) {
+        for (int node = c->buckets[keys[b] & c->bucket_mask]; node >= 0;) {
+            int e = node / MINHASH_BANDS, eb = node % MINHASH_BANDS;
+            CacheEntry* entry = &c->entries[e];
+            if (eb == b && entry->band_keys[b] == keys[b] && e != best) {
+                float similarity = minhash_similarity(&entry->sketch, sketch);
+                if (similarity >= best_similarity) {
+                    best = e;
+                    best_similarity = similarity;
+                }
+            }
+            node = entry->band_next[eb];
+        }
+    }
+    return best;
+}
+
+// ===========================
+// Public API
+// ===========================
+
+int result_cache_lookup(ResultCache* c, const MinHashSketch* sketch, int num_hashes,
+                        MatchResult* out, int k, uint64_t* generation) {
+    uint64_t keys[MINHASH_BANDS];
+    for (int b = 0; b < MINHASH_BANDS; b++) keys[b] = minhash_band_key(sketch, b);
+
+    pthread_mutex_lock(&c->lock);
+    *generation = c->generation;
+    if (num_hashes < RESULT_CACHE_MIN_HASHES) {
+        pthread_mutex_unlock(&c->lock);
+        return -1;
+    }
+
+    int e = find_similar(c, sketch, keys);
+    // A top-k answer also covers smaller k, and any k once it came back short
+    if (e < 0 || (k > c->entries[e].k && c->entries[e].found == c->entries[e].k)) {
+        c->stats.misses++;
+        pthread_mutex_unlock(&c->lock);
+        return -1;
+    }
+
+    CacheEntry* entry = &c->entries[e];
+    int shift = minhash_time_shift(&entry->sketch, sketch);
+    int found = entry->found < k ? entry->found : k;
+    for (int i = 0; i < found; i++) {
+        out[i] = entry->results[i];
+        out[i].offset -= shift;
+        out[i].offset_seconds = (float)out[i].offset * HOP_SIZE / SAMPLE_RATE;
+    }
+
+    lru_unlink(c, e);
+    lru_push_front(c, e);
+    c->stats.hits++;
+    pthread_mutex_unlock(&c->lock);
+    return found;
+}
+
+void result_cache_store(ResultCache* c, const MinHashSketch* sketch, int num_hashes,
+                        uint64_t generation, const MatchResult* results, int found, int k) {
+    if (num_hashes < RESULT_CACHE_MIN_HASHES || found < 0) return;
+
+    MatchResult* copy = (MatchResult*)malloc((found > 0 ? found : 1) * sizeof(MatchResult));
+    if (!copy) return;  // Caching is best effort
+    memcpy(copy, results, found * sizeof(MatchResult));
+
+    uint64_t keys[MINHASH_BANDS];
+    for (int b = 0; b < MINHASH_BANDS; b++) keys[b] = minhash_band_key(sketch, b);
+
+    pthread_mutex_lock(&c->lock);
+    if (generation != c->generation) {
+        pthread_mutex_unlock(&c->lock);
+        free(copy);
+        return;
+    }
+
+    // Replace a near-identical entry rather than keeping both
+    int e = find_similar(c, sketch, keys);
+    if (e >= 0) {
+        bands_unlink(c, e);
+        lru_unlink(c, e);
+    } else if (c->used < c->capacity) {
+        e = c->used++;
+    } else {
+        e = c->lru_tail;
+        bands_unlink(c, e);
+        lru_unlink(c, e);
+        c->stats.evictions++;
+    }
+
+    CacheEntry* entry = &c->entries[e];
+    free(entry->results);
+    entry->sketch = *sketch;
+    memcpy(entry->band_keys, keys, sizeof(keys));
+    entry->results = copy;
+    entry->found = found;
+    entry->k = k;
+    bands_link(c, e);
+    lru_push_front(c, e);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Caller holds the lock.
+static void clear_entries(ResultCache* c) {
+    for (int i = 0; i < c->used; i++) {
+        free(c->entries[i].results);
+        c->entries[i].results = NULL;
+    }
+    c->used = 0;
+    c->lru_head = c->lru_tail = -1;
+    memset(c->buckets, 0xFF, (c->bucket_mask + 1) * sizeof(int));
+    c->generation++;
+}
+
+void result_cache_invalidate(ResultCache* c) {
+    pthread_mutex_lock(&c->lock);
+    clear_entries(c);
+    pthread_mutex_unlock(&c->lock);
+}
+
+void result_cache_sync(ResultCache* c, int64_t index_generation) {
+    pthread_mutex_lock(&c->lock);
+    if (c->synced && c->index_generation != index_generation) clear_entries(c);
+    c->index_generation = index_generation;
+    c->synced = 1;
+    pthread_mutex_unlock(&c->lock);
+}
+
+void result_cache_get_stats(ResultCache* c, ResultCacheStats* out) {
+    pthread_mutex_lock(&c->lock);
+    *out = c->stats;
+    out->entries = c->used;
+    pthread_mutex_unlock(&c->lock);
+}
@@ -0,0 +1,133 @@
+// File: src/segmenter.c
+// Windowed matching of long recordings, stitched into a song timeline.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "audio_io.h"
+#include "segmenter.h"
+
+typedef struct {
+    TimelineEntry* entries;
+    int count;
+    int capacity;
+} Timeline;
+
+// Merge one window's best match into the timeline.
+static int add_window(Timeline* t, double window_start, double window_end, const MatchResult* match) {
+    // Song position at window start; negative when the song began inside the window
+    float song_pos = match->offset_seconds;
+
+    if (t->count > 0) {
+        TimelineEntry* last = &t->entries[t->count - 1];
+        double expected = last->song_start_seconds + (window_start - last->start_seconds);
+        if (last->song_id == match->song_id && fabs(song_pos - expected) <= SEGMENT_ALIGN_SEC) {
+            last->end_seconds = window_end;
+            if (match->score > last->score) last->score = match->score;
+            return 0;
+        }
+    }
+
+    if (t->count == t->capacity) {
+        int capacity = t->capacity ? t->capacity * 2 : 64;
+        TimelineEntry* entries = realloc(t->entries, capacity * sizeof(TimelineEntry));
+        if (!entries) {
+            fprintf(stderr, "Memory allocation failed for segment timeline.\n");
+            return -1;
+        }
+        t->entries = entries;
+        t->capacity = capacity;
+    }
+
+    TimelineEntry* e = &t->entries[t->count];
+    e->start_seconds = song_pos < 0 ? window_start - song_pos : window_start;
+    e->end_seconds = window_end;
+    e->song_id = match->song_id;
+    e->score = match->score;
+    e->song_start_seconds = song_pos < 0 ? 0.0f : song_pos;
+
+    // Overlapping windows blur the boundary; split the overlap with the previous entry
+    if (t->count > 0) {
+        TimelineEntry* prev = &t->entries[t->count - 1];
+        if (e->start_seconds < prev->end_seconds) {
+            double mid = (e->start_seconds + prev->end_seconds) / 2;
+            if (mid > prev->start_seconds) {
+                e->song_start_seconds += (float)(mid - e->start_seconds);
+                e->start_seconds = mid;
+                prev->end_seconds = mid;
+            }
+        }
+    }
+    t->count++;
+    return 0;
+}
+
+int segment_file(Matcher* matcher, const char* path, TimelineEntry** out, int* count) {
+    *out = NULL;
+    *count = 0;
+
+    AudioReader* reader = audio_reader_open(path);
+    if (!reader) return -1;
+
+    const int window = SEGMENT_WINDOW_SEC * SAMPLE_RATE;
+    const int hop = SEGMENT_HOP_SEC * SAMPLE_RATE;
+    float* buffer = (float*)malloc(window * sizeof(float));    // Raw samples, kept across hops
+    float* work = (float*)malloc(window * sizeof(float));      // Normalized copy being matched
+    Timeline timeline = { NULL, 0, 0 };
+    int rc = 0;
+
+    if (!buffer || !work) {
+        fprintf(stderr, "Memory allocation failed for segmentation.\n");
+        rc = -1;
+    }
+
+    int64_t window_start = 0;   // In samples
+    int filled = 0;
+    while (rc == 0) {
+        int got = audio_reader_read(reader, buffer + filled, window - filled);
+        if (got < 0) {
+            rc = -1;
+            break;
+        }
+        filled += got;
+
+        // A short tail only counts if it holds new audio and enough for a few frames
+        int is_tail = filled < window;
+        if (filled >= FRAME_SIZE * 4 && (!is_tail || got > 0 || window_start == 0)) {
+            memcpy(work, buffer, filled * sizeof(float));
+            audio_normalize(work, filled);
+
+            MatchResult match;
+            int found = matcher_match_samples(matcher, work, filled, SAMPLE_RATE, &match, 1);
+            if (found < 0) {
+                rc = -1;
+                break;
+            }
+            if (found > 0 &&
+                add_window(&timeline, (double)window_start / SAMPLE_RATE,
+                           (double)(window_start + filled) / SAMPLE_RATE, &match) != 0) {
+                rc = -1;
+                break;
+            }
+        }
+        if (is_tail) break;
+
+        memmove(buffer, buffer + hop, (window - hop) * sizeof(float));
+        filled = window - hop;
+        window_start += hop;
+    }
+
+    audio_reader_close(reader);
+    free(buffer);
+    free(work);
+
+    if (rc != 0) {
+        free(timeline.entries);
+        return -1;
+    }
+    *out = timeline.entries;
+    *count = timeline.count;
+    return 0;
+}
@@ -0,0 +1,180 @@
+// File: src/server_entry.c
+// Command-line front end: keep the fingerprint index resident and serve match requests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "db.h"
+#include "fingerprint_index.h"
+#include "match_server.h"
+#include "result_cache.h"
+
+#define MAX_PATH_LEN 1024
+
+static MatchServer* running_server = NULL;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    if (running_server) match_server_stop(running_server);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--index PATH | --memory | --compressed | --lsm DIR] [--threads N]\n"
+            "          [--unix PATH] [--tcp PORT] [--batch-ms MS] [--cache N]\n"
+            "  (default)      serve the SQLite catalog at %s\n"
+            "  --index PATH   memory-mapped index file built with song_entry --index\n"
+            "  --memory       load the catalog into an in-memory hash index first\n"
+            "  --compressed   load the catalog into a compressed in-memory index first\n"
+            "  --lsm DIR      serve the segmented index in DIR\n"
+            "  --threads N    matching threads (default %d)\n"
+            "  --unix PATH    listen on a Unix socket (default %s if no --tcp)\n"
+            "  --tcp PORT     listen on 127.0.0.1:PORT\n"
+            "  --batch-ms MS  gather requests for up to MS ms and look up their hashes together\n"
+            "  --cache N      answer repeated near-identical queries from an N-entry cache\n"
+            "                 (e.g. %d)\n",
+            prog, DB_PATH, DB_READ_POOL_SIZE, SERVER_SOCKET_PATH, RESULT_CACHE_ENTRIES);
+}
+
+int main(int argc, char** argv) {
+    const char* index_path = NULL;
+    const char* lsm_dir = NULL;
+    const char* unix_path = NULL;
+    int use_memory = 0, use_compressed = 0;
+    int num_threads = DB_READ_POOL_SIZE, tcp_port = 0;
+    int cache_entries = 0;
+    double batch_ms = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (strcmp(argv[i], "--memory") == 0) {
+            use_memory = 1;
+        } else if (strcmp(argv[i], "--compressed") == 0) {
+            use_compressed = 1;
+        } else if (strcmp(argv[i], "--lsm") == 0 && i + 1 < argc) {
+            lsm_dir = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--unix") == 0 && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (strcmp(argv[i], "--tcp") == 0 && i + 1 < argc) {
+            tcp_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--batch-ms") == 0 && i + 1 < argc) {
+            batch_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_entries = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int backends = (index_path != NULL) + use_memory + use_compressed + (lsm_dir != NULL);
+    if (backends > 1 || num_threads <= 0 || tcp_port < 0 || tcp_port > 65535 || batch_ms < 0 || cache_entries < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!unix_path && tcp_port == 0) unix_path = SERVER_SOCKET_PATH;
+
+    MmapIndex* mmap_index = NULL;
+    HashIndex* hash_index = NULL;
+    CompressedIndex* compressed = NULL;
+    LsmIndex* lsm = NULL;
+    LsmSnapshot* snapshot = NULL;
+    db_pool* pool = NULL;
+    FingerprintIndex index;
+    int ok = 1;
+
+    if (index_path) {
+        ok = (mmap_index = mmap_index_open(index_path)) != NULL;
+        if (ok) index = fingerprint_index_from_mmap(mmap_index);
+    } else if (lsm_dir) {
+        ok = (lsm = lsm_index_open(lsm_dir, LSM_OPEN_READONLY)) != NULL;
+        if (ok) {
+            snapshot = lsm_index_acquire(lsm);
+            index = fingerprint_index_from_lsm(snapshot);
+        }
+    } else if (use_memory || use_compressed) {
+        db_ctx* db = db_open_ctx(DB_PATH, DB_CTX_READONLY);
+        ok = db != NULL;
+        if (ok && use_memory) {
+            ok = (hash_index = hash_index_load_from_db(db)) != NULL;
+            if (ok) index = fingerprint_index_from_hash(hash_index);
+        } else if (ok) {
+            ok = (compressed = compressed_index_load_from_db(db)) != NULL;
+            if (ok) index = fingerprint_index_from_compressed(compressed);
+        }
+        db_close_ctx(db);
+    } else {
+        // One connection per matching thread
+        ok = (pool = db_pool_open(DB_PATH, num_threads)) != NULL;
+        if (ok) {
+            char filter_path[MAX_PATH_LEN];
+            snprintf(filter_path, sizeof(filter_path), "%s%s", DB_PATH, BLOOM_FILE_SUFFIX);
+            // Reloaded per batch as the catalog grows (see db_pool_sync_filter)
+            struct stat filter_stat;
+            if (stat(filter_path, &filter_stat) == 0 && db_pool_load_filter(pool, filter_path) != 0)
+                fprintf(stderr, "Filter %s does not match the catalog yet; serving without it.\n",
+                        filter_path);
+            index = fingerprint_index_from_pool(pool);
+        }
+    }
+
+    MatchServer* server = ok ? match_server_create(index, num_threads) : NULL;
+    ResultCache* cache = server && cache_entries > 0 ? result_cache_create(cache_entries) : NULL;
+    int rc = server && (cache || cache_entries == 0) ? 0 : 1;
+    if (!ok) fprintf(stderr, "Failed to open the fingerprint index.\n");
+
+    if (server && unix_path && match_server_listen_unix(server, unix_path) != 0) rc = 1;
+    if (server && tcp_port > 0 && match_server_listen_tcp(server, tcp_port) != 0) rc = 1;
+
+    if (rc == 0) {
+        match_server_set_batch_window(server, batch_ms);
+        match_server_set_result_cache(server, cache);
+        running_server = server;
+        signal(SIGINT, handle_signal);
+        signal(SIGTERM, handle_signal);
+
+        printf("Serving with %d threads", num_threads);
+        if (batch_ms > 0) printf(", %.1f ms batches,", batch_ms);
+        printf(" on");
+        if (unix_path) printf(" %s", unix_path);
+        if (tcp_port > 0) printf(" 127.0.0.1:%d", tcp_port);
+        printf("\n");
+        fflush(stdout);
+
+        rc = match_server_run(server) == 0 ? 0 : 1;
+        running_server = NULL;
+
+        MatchServerStats stats;
+        match_server_get_stats(server, &stats);
+        printf("Served %lld requests (%lld errors) over %lld connections\n",
+               stats.requests, stats.errors, stats.connections);
+        printf("Latency: mean %.2f ms, p50 <= %.2f ms, p99 <= %.2f ms, max %.2f ms\n",
+               stats.mean_ms, stats.p50_ms, stats.p99_ms, stats.max_ms);
+        if (stats.batches > 0)
+            printf("Batches: %lld, %.1f requests each, %lld of %lld hashes looked up\n",
+                   stats.batches, (double)stats.requests / stats.batches,
+                   stats.hashes_looked_up, stats.hashes_requested);
+        if (cache) {
+            ResultCacheStats cache_stats;
+            result_cache_get_stats(cache, &cache_stats);
+            printf("Cache: %lld hits, %lld misses, %lld evictions, %d entries\n",
+                   cache_stats.hits, cache_stats.misses, cache_stats.evictions, cache_stats.entries);
+        }
+    }
+
+    match_server_free(server);
+    result_cache_free(cache);
+    if (snapshot) lsm_index_release(lsm, snapshot);
+    lsm_index_close(lsm);
+    compressed_index_free(compressed);
+    hash_index_free(hash_index);
+    mmap_index_close(mmap_index);
+    db_pool_close(pool);
+    return rc;
+}
@@ -0,0 +1,303 @@
+// File: src/shard_set.c
+// Hash-prefix sharded fingerprint store with parallel writes and lookups.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hashing.h"
+#include "thread_pool.h"
+#include "shard_set.h"
+
+#define MAX_SHARDS          64
+#define SHARD_META_KEY      "num_shards"
+
+typedef struct {
+    db_ctx* db;
+
+    // Insert job
+    FingerprintHash64* records;
+    int num_records;
+    int inserted;
+
+    // Lookup job: positions in the caller's hash array routed to this shard
+    size_t* positions;
+    size_t num_positions;
+    size_t positions_capacity;
+    Posting* postings;          // Results of this shard, appended per hash
+    size_t num_postings;
+    size_t postings_capacity;
+
+    const uint64_t* hashes;     // Caller's arrays for the current lookup
+    size_t* starts;
+    size_t* counts;
+
+    int failed;
+} Shard;
+
+struct ShardSet {
+    Shard shards[MAX_SHARDS];
+    int num_shards;
+    ThreadPool* pool;
+    FingerprintHash64* route_buf;
+    int route_capacity;
+    size_t* starts;             // Per-hash offset into its shard's postings
+    size_t* counts;
+    size_t lookup_capacity;
+};
+
+int shard_set_num_shards(const ShardSet* set) {
+    return set->num_shards;
+}
+
+int shard_set_generation(ShardSet* set, int64_t* generation) {
+    *generation = 0;
+    for (int s = 0; s < set->num_shards; s++) {
+        int64_t g;
+        if (db_get_generation(set->shards[s].db, &g) != 0) return -1;
+        *generation += g;
+    }
+    return 0;
+}
+
+int shard_set_count(ShardSet* set, uint64_t hash, int cap) {
+    return db_count_hash(set->shards[shard_set_shard_of(set, hash)].db, hash, cap);
+}
+
+int shard_set_shard_of(const ShardSet* set, uint64_t hash) {
+    // Multiply-shift range reduction of the mixed prefix, so N need not be a power of two
+    return (int)(((mix_hash64(hash) >> 32) * (uint64_t)set->num_shards) >> 32);
+}
+
+ShardSet* shard_set_open(const char* base_path, int num_shards, int flags) {
+    if (!base_path || num_shards <= 0 || num_shards > MAX_SHARDS) {
+        fprintf(stderr, "Invalid input to shard_set_open.\n");
+        return NULL;
+    }
+
+    ShardSet* set = (ShardSet*)calloc(1, sizeof(ShardSet));
+    if (!set) return NULL;
+
+    set->pool = thread_pool_create(num_shards);
+    if (!set->pool) {
+        free(set);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_shards; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s.shard%02d", base_path, i);
+
+        Shard* shard = &set->shards[i];
+        shard->db = db_open_ctx(path, flags);
+        if (!shard->db) {
+            shard_set_close(set);
+            return NULL;
+        }
+        set->num_shards++;
+
+        int64_t recorded = 0;
+        int found = db_get_meta(shard->db, SHARD_META_KEY, &recorded);
+        if (found == 1 && recorded != num_shards) {
+            fprintf(stderr, "Shard %s was built for %lld shards, not %d.\n",
+                    path, (long long)recorded, num_shards);
+            shard_set_close(set);
+            return NULL;
+        }
+        if (found == 0 && !(flags & DB_CTX_READONLY) &&
+            db_set_meta(shard->db, SHARD_META_KEY, num_shards) != 0) {
+            shard_set_close(set);
+            return NULL;
+        }
+    }
+
+    return set;
+}
+
+void shard_set_close(ShardSet* set) {
+    if (!set) return;
+    thread_pool_destroy(set->pool);
+    for (int i = 0; i < set->num_shards; i++) {
+        db_close_ctx(set->shards[i].db);
+        free(set->shards[i].positions);
+        free(set->shards[i].postings);
+    }
+    free(set->route_buf);
+    free(set->starts);
+    free(set->counts);
+    free(set);
+}
+
+// ===========================
+// Parallel insert
+// ===========================
+
+static void insert_task(void* arg, int worker_id) {
+    (void)worker_id;
+    Shard* shard = (Shard*)arg;
+    shard->inserted = 0;
+    shard->failed = 0;
+    if (shard->num_records == 0) return;
+    if (db_insert_fingerprints(shard->db, shard->records, shard->num_records, &shard->inserted) != 0)
+        shard->failed = 1;
+}
+
+int shard_set_insert_fingerprints(ShardSet* set, FingerprintHash64* hashes, int count, int* inserted) {
+    if (inserted) *inserted = 0;
+    if (count <= 0) return 0;
+
+    if (count > set->route_capacity) {
+        FingerprintHash64* buf = realloc(set->route_buf, count * sizeof(FingerprintHash64));
+        if (!buf) return -1;
+        set->route_buf = buf;
+        set->route_capacity = count;
+    }
+
+    // Counting sort by shard into route_buf, then copy back so each shard gets a contiguous slice
+    int counts[MAX_SHARDS] = {0};
+    for (int i = 0; i < count; i++)
+        counts[shard_set_shard_of(set, hashes[i].hash)]++;
+
+    int offsets[MAX_SHARDS];
+    int pos = 0;
+    for (int s = 0; s < set->num_shards; s++) {
+        offsets[s] = pos;
+        set->shards[s].records = hashes + pos;
+        set->shards[s].num_records = counts[s];
+        pos += counts[s];
+    }
+    for (int i = 0; i < count; i++)
+        set->route_buf[offsets[shard_set_shard_of(set, hashes[i].hash)]++] = hashes[i];
+    memcpy(hashes, set->route_buf, count * sizeof(FingerprintHash64));
+
+    TaskGroup group;
+    task_group_init(&group);
+    for (int s = 0; s < set->num_shards; s++) {
+        if (thread_pool_submit(set->pool, &group, insert_task, &set->shards[s]) != 0)
+            insert_task(&set->shards[s], 0);  // The queue refused the task: run it here
+    }
+    task_group_wait(&group);
+    task_group_destroy(&group);
+
+    int rc = 0, total = 0;
+    for (int s = 0; s < set->num_shards; s++) {
+        if (set->shards[s].failed) {
+            fprintf(stderr, "Insert into shard %d failed.\n", s);
+            rc = -1;
+        }
+        total += set->shards[s].inserted;
+    }
+
+    if (inserted) *inserted = total;
+    return rc;
+}
+
+// ===========================
+// Parallel lookup
+// ===========================
+
+static int reserve_postings(Shard* shard, size_t extra) {
+    size_t needed = shard->num_postings + extra;
+    if (needed <= shard->postings_capacity) return 0;
+    size_t capacity = shard->postings_capacity ? shard->postings_capacity : 4096;
+    while (capacity < needed) capacity *= 2;
+    Posting* postings = realloc(shard->postings, capacity * sizeof(Posting));
+    if (!postings) return -1;
+    shard->postings = postings;
+    shard->postings_capacity = capacity;
+    return 0;
+}
+
+static void lookup_task(void* arg, int worker_id) {
+    (void)worker_id;
+    Shard* shard = (Shard*)arg;
+    shard->num_postings = 0;
+    shard->failed = 0;
+
+    for (size_t k = 0; k < shard->num_positions; k++) {
+        size_t i = shard->positions[k];
+        if (reserve_postings(shard, 256) != 0) {
+            shard->failed = 1;
+            return;
+        }
+
+        int room = (int)(shard->postings_capacity - shard->num_postings);
+        int n = db_lookup_hash(shard->db, shard->hashes[i], shard->postings + shard->num_postings, room);
+        if (n > room) {
+            // Long list: grow to fit and fetch again
+            if (reserve_postings(shard, (size_t)n) != 0) {
+                shard->failed = 1;
+                return;
+            }
+            room = (int)(shard->postings_capacity - shard->num_postings);
+            n = db_lookup_hash(shard->db, shard->hashes[i], shard->postings + shard->num_postings, room);
+        }
+        if (n < 0) {
+            shard->failed = 1;
+            return;
+        }
+
+        shard->starts[i] = shard->num_postings;
+        shard->counts[i] = (size_t)n;
+        shard->num_postings += (size_t)n;
+    }
+}
+
+int shard_set_lookup_batch(ShardSet* set, const uint64_t* hashes, size_t n, PostingList* out) {
+    if (n == 0) return 0;
+
+    if (n > set->lookup_capacity) {
+        size_t* starts = realloc(set->starts, n * sizeof(size_t));
+        if (!starts) return -1;
+        set->starts = starts;
+        size_t* counts = realloc(set->counts, n * sizeof(size_t));
+        if (!counts) return -1;
+        set->counts = counts;
+        set->lookup_capacity = n;
+    }
+
+    for (int s = 0; s < set->num_shards; s++) {
+        Shard* shard = &set->shards[s];
+        shard->num_positions = 0;
+        shard->hashes = hashes;
+        shard->starts = set->starts;
+        shard->counts = set->counts;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        Shard* shard = &set->shards[shard_set_shard_of(set, hashes[i])];
+        if (shard->num_positions == shard->positions_capacity) {
+            size_t capacity = shard->positions_capacity ? shard->positions_capacity * 2 : 256;
+            size_t* positions = realloc(shard->positions, capacity * sizeof(size_t));
+            if (!positions) return -1;
+            shard->positions = positions;
+            shard->positions_capacity = capacity;
+        }
+        shard->positions[shard->num_positions++] = i;
+    }
+
+    TaskGroup group;
+    task_group_init(&group);
+    for (int s = 0; s < set->num_shards; s++) {
+        if (set->shards[s].num_positions > 0 &&
+            thread_pool_submit(set->pool, &group, lookup_task, &set->shards[s]) != 0)
+            lookup_task(&set->shards[s], 0);
+    }
+    task_group_wait(&group);
+    task_group_destroy(&group);
+
+    for (int s = 0; s < set->num_shards; s++) {
+        if (set->shards[s].num_positions > 0 && set->shards[s].failed) {
+            fprintf(stderr, "Lookup on shard %d failed.\n", s);
+            return -1;
+        }
+    }
+
+    // Buffers are final now; turn offsets into pointers
+    for (size_t i = 0; i < n; i++) {
+        const Shard* shard = &set->shards[shard_set_shard_of(set, hashes[i])];
+        out[i].count = set->counts[i];
+        out[i].postings = set->counts[i] ? shard->postings + set->starts[i] : NULL;
+    }
+    return 0;
+}
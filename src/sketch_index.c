@@ -0,0 +1,129 @@
+// File: src/sketch_index.c
+// LSH banding index over song sketches.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "sketch_index.h"
+
+typedef struct {
+    int song_id;
+    unsigned seen;              // Probe that last compared this entry
+    SongSketch sketch;
+} SketchEntry;
+
+// Bucket chains link nodes: node = entry * SONG_SKETCH_BANDS + band
+struct SketchIndex {
+    SketchEntry* entries;
+    int* node_next;
+    int count;
+    int capacity;
+    int* buckets;
+    uint64_t bucket_mask;
+    unsigned probe;
+};
+
+SketchIndex* sketch_index_create(void) {
+    return (SketchIndex*)calloc(1, sizeof(SketchIndex));
+}
+
+void sketch_index_free(SketchIndex* index) {
+    if (!index) return;
+    free(index->entries);
+    free(index->node_next);
+    free(index->buckets);
+    free(index);
+}
+
+int sketch_index_size(const SketchIndex* index) {
+    return index->count;
+}
+
+static void link_entry(SketchIndex* index, int e) {
+    for (int b = 0; b < SONG_SKETCH_BANDS; b++) {
+        int* head = &index->buckets[song_sketch_band_key(&index->entries[e].sketch, b) & index->bucket_mask];
+        int node = e * SONG_SKETCH_BANDS + b;
+        index->node_next[node] = *head;
+        *head = node;
+    }
+}
+
+// Double the entry arrays and rebuild the buckets at twice the node count.
+static int grow(SketchIndex* index) {
+    int capacity = index->capacity ? index->capacity * 2 : 1024;
+    size_t buckets = 1;
+    while (buckets < (size_t)capacity * SONG_SKETCH_BANDS * 2) buckets <<= 1;
+
+    SketchEntry* entries = realloc(index->entries, capacity * sizeof(SketchEntry));
+    if (entries) index->entries = entries;
+    int* node_next = realloc(index->node_next, (size_t)capacity * SONG_SKETCH_BANDS * sizeof(int));
+    if (node_next) index->node_next = node_next;
+    int* bucket_heads = (int*)malloc(buckets * sizeof(int));
+    if (!entries || !node_next || !bucket_heads) {
+        fprintf(stderr, "Memory allocation failed for sketch index.\n");
+        free(bucket_heads);
+        return -1;
+    }
+
+    free(index->buckets);
+    index->buckets = bucket_heads;
+    index->bucket_mask = buckets - 1;
+    index->capacity = capacity;
+    memset(index->buckets, 0xFF, buckets * sizeof(int));
+    for (int e = 0; e < index->count; e++) link_entry(index, e);
+    return 0;
+}
+
+int sketch_index_add(SketchIndex* index, int song_id, const SongSketch* sketch) {
+    if (index->count == index->capacity && grow(index) != 0) return -1;
+
+    int e = index->count++;
+    index->entries[e].song_id = song_id;
+    index->entries[e].seen = index->probe;
+    index->entries[e].sketch = *sketch;
+    link_entry(index, e);
+    return 0;
+}
+
+int sketch_index_find(SketchIndex* index, const SongSketch* sketch, float min_similarity,
+                      int* song_id, float* similarity) {
+    if (index->count == 0) return 0;
+
+    // Each entry is compared once per probe, however many bands it shares
+    unsigned probe = ++index->probe;
+    int best = -1;
+    float best_similarity = min_similarity;
+    for (int b = 0; b < SONG_SKETCH_BANDS; b++) {
+        int node = index->buckets[song_sketch_band_key(sketch, b) & index->bucket_mask];
+        for (; node >= 0; node = index->node_next[node]) {
+            SketchEntry* entry = &index->entries[node / SONG_SKETCH_BANDS];
+            if (entry->seen == probe) continue;
+            entry->seen = probe;
+
+            float s = song_sketch_similarity(&entry->sketch, sketch);
+            if (s >= best_similarity) {
+                best = node / SONG_SKETCH_BANDS;
+                best_similarity = s;
+            }
+        }
+    }
+    if (best < 0) return 0;
+
+    *song_id = index->entries[best].song_id;
+    *similarity = best_similarity;
+    return 1;
+}
+
+static int add_stored(int song_id, const SongSketch* sketch, void* user) {
+    return sketch_index_add((SketchIndex*)user, song_id, sketch) == 0 ? 0 : -1;
+}
+
+int sketch_index_load_from_db(SketchIndex* index, db_ctx* ctx) {
+    int before = index->count;
+    if (db_scan_song_sketches(ctx, add_stored, index) != 0) {
+        fprintf(stderr, "Failed to load song sketches.\n");
+        return -1;
+    }
+    return index->count - before;
+}
@@ -14,26 +14,32 @@
 #include "types.h"
 #include "config.h"
 #include "db.h"
+#include "db_writer.h"
+#include "mmap_index.h"
+#include "shard_set.h"
+#include "lsm_index.h"
+#include "bloom.h"
+#include "sketch_index.h"
 
 #define MAX_PATH_LEN 1024
+#define MAX_NAME_LEN 256
 
 int is_audio_file(const char* filename) {
     const char* ext = strrchr(filename, '.');
     return ext && (strcmp(ext, ".wav") == 0 || strcmp(ext, ".mp3") == 0);
 }
 
-void process_file(const char* filepath, const char* filename) {
+// Decode, fingerprint and hand the hashes to the writer thread.
+// `reader` is a read-only context used to skip known songs before any DSP work.
+// If `sketches` is not NULL, songs too similar to one already in it are skipped
+// before their fingerprints are queued, and the others are added to it.
+void process_file(const char* filepath, const char* filename, db_ctx* reader, DbWriter* writer,
+                  SketchIndex* sketches) {
     const char* song_name = filename;
     const char* artist_name = "Unknown";  // Default, can be improved later
 
     int song_id = -1;
-    if (db_insert_song(song_name, artist_name, &song_id) < 0) {
-        fprintf(stderr, "Failed to insert song into database.\n");
-        return;
-    }
-
-    // If duplicate, skip
-    if (song_id == -1) {
+    if (db_find_song(reader, song_name, artist_name, &song_id) == 1) {
         printf("Skipping duplicate song: %s\n", song_name);
         return;
     }
@@ -42,6 +48,8 @@ void process_file(const char* filepath, const char* filename) {
 
     float** spectrogram = NULL;
     int num_frames = 0, num_bins = 0;
+    Peak* peaks = NULL;
+    FingerprintHash64* hashes = NULL;
 
     if (build_spectrogram(filepath, &spectrogram, &num_frames, &num_bins) != 0 || !spectrogram) {
         fprintf(stderr, "Spectrogram generation failed for: %s\n", filepath);
@@ -49,7 +57,7 @@ void process_file(const char* filepath, const char* filename) {
     }
 
     int num_peaks = 0;
-    Peak* peaks = detect_peaks(spectrogram, num_frames, num_bins, &num_peaks);
+    peaks = detect_peaks(spectrogram, num_frames, num_bins, &num_peaks);
     if (!peaks) {
         fprintf(stderr, "Peak detection failed.\n");
         goto cleanup;
@@ -58,48 +66,203 @@ void process_file(const char* filepath, const char* filename) {
     printf("Detected %d peaks.\n", num_peaks);
 
     int hash_count = 0;
-    FingerprintHash64* hashes = generate_fingerprint_hashes(peaks, num_peaks, song_id, &hash_count);
+    hashes = generate_fingerprint_hashes(peaks, num_peaks, -1, &hash_count);  // ID assigned by writer
     if (!hashes || hash_count == 0) {
         fprintf(stderr, "Hash generation failed or returned zero hashes.\n");
         goto cleanup;
     }
 
-    printf("Generated %d hashes. Inserting into DB...\n", hash_count);
+    printf("Generated %d hashes.\n", hash_count);
+
+    // Re-encodes and edits of a known song share much of its hash set
+    if (sketches) {
+        SongSketch sketch;
+        song_sketch_compute(hashes, hash_count, &sketch);
 
-    int inserted = 0, skipped = 0;
-    for (int i = 0; i < hash_count; i++) {
-        char hex_hash[17];
-        snprintf(hex_hash, sizeof(hex_hash), "%016lX", hashes[i].hash);
-        int status = db_insert_fingerprint(hex_hash, hashes[i].time_offset, hashes[i].song_id);
-        if (status == 0)
-            inserted++;
-        else if (status == 1)
-            skipped++;
-        else
-            fprintf(stderr, "Failed to insert hash %d into DB.\n", i);
+        int match_id;
+        float similarity;
+        if (sketch_index_find(sketches, &sketch, SONG_SKETCH_MIN_SIMILARITY, &match_id, &similarity)) {
+            char name[MAX_NAME_LEN] = "a song queued earlier in this run", artist[MAX_NAME_LEN] = "";
+            if (match_id >= 0) db_get_song(reader, match_id, name, sizeof(name), artist, sizeof(artist));
+            printf("Skipping near-duplicate of %s%s%s (similarity %.2f): %s\n",
+                   artist, artist[0] ? " - " : "", name, similarity, song_name);
+            goto cleanup;
+        }
+        if (sketch_index_add(sketches, -1, &sketch) != 0)  // Id assigned by writer
+            fprintf(stderr, "Warning: %s will not be checked against later songs.\n", song_name);
     }
 
-    printf("Inserted %d/%d hashes (%d duplicates skipped).\n", inserted, hash_count, skipped);
+    printf("Queueing for DB writer...\n");
+
+    // Writer takes ownership of the hash and peak buffers
+    if (db_writer_submit(writer, song_name, artist_name, hashes, hash_count, peaks, num_peaks) != 0)
+        fprintf(stderr, "Failed to queue hashes for: %s\n", filepath);
+    hashes = NULL;
+    peaks = NULL;
 
 cleanup:
     if (peaks) free(peaks);
     if (hashes) free(hashes);
     if (spectrogram) {
-        for (int i = 0; i < num_frames; i++) free(spectrogram[i]);
+        free(spectrogram[0]);  // Rows share one contiguous data block
         free(spectrogram);
     }
 }
 
-int main() {
-    if (db_open(DB_PATH) != 0) {
+static int stop_at_first(uint64_t hash, int song_id, int time_offset, void* user) {
+    (void)hash;
+    (void)song_id;
+    (void)time_offset;
+    (void)user;
+    return 1;
+}
+
+// Stamp a new catalog with the current hash layout; refuse to mix layouts.
+static int check_hash_layout(db_ctx* db) {
+    int64_t layout = 0;
+    int found = db_get_meta(db, "hash_layout", &layout);
+    if (found < 0) return -1;
+
+    if (found == 0) {
+        int scan = db_scan_fingerprints(db, stop_at_first, NULL);
+        if (scan < 0) return -1;
+        if (scan == 1) {
+            fprintf(stderr, "Catalog uses an older hash layout; delete %s and re-ingest.\n", DB_PATH);
+            return -1;
+        }
+        return db_set_meta(db, "hash_layout", HASH_LAYOUT_VERSION);
+    }
+
+    if (layout != HASH_LAYOUT_VERSION) {
+        fprintf(stderr, "Catalog uses hash layout %lld, this build writes %d; re-ingest required.\n",
+                (long long)layout, HASH_LAYOUT_VERSION);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    // --bulk: initial catalog build, indexes are built once at the end
+    // --index PATH: after ingest, export the catalog as a memory-mapped index file
+    // --shards N: store fingerprints in N hash-partitioned files next to the DB
+    // --lsm DIR: append fingerprints to a segmented index in DIR instead of the DB
+    // --filter: build a membership filter next to the DB (kept fresh once it exists)
+    // --keep-near-duplicates: ingest songs even if they look like re-encodes of known ones
+    int bulk = 0;
+    int build_filter = 0;
+    int keep_near_duplicates = 0;
+    int num_shards = 0;
+    const char* index_path = NULL;
+    const char* lsm_dir = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bulk") == 0) {
+            bulk = 1;
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            num_shards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lsm") == 0 && i + 1 < argc) {
+            lsm_dir = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            build_filter = 1;
+        } else if (strcmp(argv[i], "--keep-near-duplicates") == 0) {
+            keep_near_duplicates = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--bulk] [--index PATH] [--filter] [--shards N | --lsm DIR]\n"
+                            "          [--keep-near-duplicates]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_shards > 0 && (bulk || index_path)) {
+        fprintf(stderr, "--bulk and --index operate on the main DB and cannot be combined with --shards.\n");
+        return 1;
+    }
+    if (lsm_dir && (bulk || index_path || num_shards > 0)) {
+        fprintf(stderr, "--lsm cannot be combined with --bulk, --index or --shards.\n");
+        return 1;
+    }
+
+    db_ctx* db = db_open_ctx(DB_PATH, 0);
+    if (!db) {
         fprintf(stderr, "Failed to open/create DB at %s\n", DB_PATH);
         return 1;
     }
 
+    if (check_hash_layout(db) != 0) {
+        db_close_ctx(db);
+        return 1;
+    }
+
+    if (bulk && db_begin_bulk_load(db) != 0) {
+        fprintf(stderr, "Failed to enter bulk-load mode.\n");
+        db_close_ctx(db);
+        return 1;
+    }
+
+    db_ctx* reader = db_open_ctx(DB_PATH, DB_CTX_READONLY);
+    if (!reader) {
+        fprintf(stderr, "Failed to open read-only DB context.\n");
+        db_close_ctx(db);
+        return 1;
+    }
+
+    // Sketches of the songs already in the catalog, probed before each new song is written
+    SketchIndex* sketches = NULL;
+    if (!keep_near_duplicates) {
+        sketches = sketch_index_create();
+        if (!sketches || sketch_index_load_from_db(sketches, reader) < 0) {
+            sketch_index_free(sketches);
+            db_close_ctx(reader);
+            db_close_ctx(db);
+            return 1;
+        }
+        printf("Loaded %d song sketches.\n", sketch_index_size(sketches));
+    }
+
     DIR* dir = opendir(SONGS_FOLDER);
     if (!dir) {
         perror("Failed to open songs folder");
-        db_close();
+        sketch_index_free(sketches);
+        db_close_ctx(reader);
+        db_close_ctx(db);
+        return 1;
+    }
+
+    ShardSet* shards = NULL;
+    if (num_shards > 0) {
+        shards = shard_set_open(DB_PATH, num_shards, 0);
+        if (!shards) {
+            closedir(dir);
+            sketch_index_free(sketches);
+            db_close_ctx(reader);
+            db_close_ctx(db);
+            return 1;
+        }
+    }
+
+    LsmIndex* lsm = NULL;
+    if (lsm_dir) {
+        lsm = lsm_index_open(lsm_dir, 0);
+        if (!lsm) {
+            fprintf(stderr, "Failed to open segmented index in %s\n", lsm_dir);
+            closedir(dir);
+            sketch_index_free(sketches);
+            db_close_ctx(reader);
+            db_close_ctx(db);
+            return 1;
+        }
+    }
+
+    // The writer thread owns `db` (and the shards / LSM index) until db_writer_stop()
+    DbWriter* writer = db_writer_start(db, shards, lsm, DB_WRITER_QUEUE_DEPTH, DB_WRITER_TXN_ROWS);
+    if (!writer) {
+        lsm_index_close(lsm);
+        shard_set_close(shards);
+        closedir(dir);
+        sketch_index_free(sketches);
+        db_close_ctx(reader);
+        db_close_ctx(db);
         return 1;
     }
 
@@ -110,11 +273,51 @@ int main() {
 
         struct stat path_stat;
         if (stat(filepath, &path_stat) == 0 && S_ISREG(path_stat.st_mode) && is_audio_file(entry->d_name)) {
-            process_file(filepath, entry->d_name);
+            process_file(filepath, entry->d_name, reader, writer, sketches);
         }
     }
 
     closedir(dir);
-    db_close();
-    return 0;
+    sketch_index_free(sketches);
+
+    int rc = 0;
+    if (db_writer_stop(writer) != 0) {
+        fprintf(stderr, "Some songs failed to write.\n");
+        rc = 1;
+    }
+
+    if (bulk && db_finalize_bulk_load(db) != 0) {
+        fprintf(stderr, "Bulk-load finalize failed.\n");
+        rc = 1;
+    }
+
+    shard_set_close(shards);
+    if (lsm_index_close(lsm) != 0) {
+        fprintf(stderr, "Failed to flush segmented index.\n");
+        rc = 1;
+    }
+
+    if (rc == 0 && index_path && mmap_index_build_from_db(db, index_path) != 0) {
+        fprintf(stderr, "Failed to export index to %s\n", index_path);
+        rc = 1;
+    }
+
+    // A filter that misses new rows would hide them from queries, so an existing
+    // one is rebuilt whenever the main DB was written.
+    char filter_path[MAX_PATH_LEN];
+    snprintf(filter_path, sizeof(filter_path), "%s%s", DB_PATH, BLOOM_FILE_SUFFIX);
+    struct stat filter_stat;
+    if (num_shards == 0 && !lsm_dir && (build_filter || stat(filter_path, &filter_stat) == 0)) {
+        BloomFilter* filter = bloom_build_from_db(db);
+        if (!filter || bloom_save(filter, filter_path) != 0) {
+            fprintf(stderr, "Failed to build filter; removing %s\n", filter_path);
+            remove(filter_path);
+            rc = 1;
+        }
+        bloom_free(filter);
+    }
+
+    db_close_ctx(reader);
+    db_close_ctx(db);
+    return rc;
 }
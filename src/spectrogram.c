@@ -8,12 +8,21 @@
 #include "fft.h"
 #include "spectrogram.h"
 
-static void apply_hanning_window(float* frame, int size) {
+// Hann window applied while copying the frame into the FFT buffer.
+static void apply_hanning_window(const float* frame, Complex* out, int size) {
     for (int i = 0; i < size; ++i) {
-        frame[i] *= 0.5f * (1.0f - cosf(2.0f * PI * i / (size - 1)));
+        out[i].real = frame[i] * (0.5f * (1.0f - cosf(2.0f * PI * i / (size - 1))));
+        out[i].imag = 0.0f;
     }
 }
 
+void spectrogram_frame(const float* frame, Complex* work, float* magnitude) {
+    apply_hanning_window(frame, work, FRAME_SIZE);
+
+    fft(work, FRAME_SIZE);
+    compute_magnitude_spectrum(work, magnitude, FRAME_SIZE);
+}
+
 int build_spectrogram_from_samples(
     const float* samples,
     int num_samples,
@@ -38,8 +47,6 @@ int build_spectrogram_from_samples(
     float** spectrogram = NULL;
     float* spectrogram_data = NULL;
     Complex* fft_buffer = NULL;
-    float* magnitude = NULL;
-    float* frame_buffer = NULL;
 
     // Allocate 2D spectrogram: pointers + contiguous data block
     spectrogram = (float**)malloc(sizeof(float*) * num_frames);
@@ -54,29 +61,14 @@ int build_spectrogram_from_samples(
     }
 
     fft_buffer = (Complex*)calloc(FRAME_SIZE, sizeof(Complex));
-    magnitude = (float*)calloc(num_bins, sizeof(float));
-    frame_buffer = (float*)malloc(sizeof(float) * FRAME_SIZE);
 
-    if (!fft_buffer || !magnitude || !frame_buffer) {
+    if (!fft_buffer) {
         fprintf(stderr, "Memory allocation failed during FFT setup.\n");
         goto cleanup;
     }
 
     for (int f = 0; f < num_frames; ++f) {
-        int offset = f * HOP_SIZE;
-        memcpy(frame_buffer, samples + offset, sizeof(float) * FRAME_SIZE);
-
-        apply_hanning_window(frame_buffer, FRAME_SIZE);
-
-        for (int i = 0; i < FRAME_SIZE; ++i) {
-            fft_buffer[i].real = frame_buffer[i];
-            fft_buffer[i].imag = 0.0f;
-        }
-
-        fft(fft_buffer, FRAME_SIZE);
-        compute_magnitude_spectrum(fft_buffer, magnitude, FRAME_SIZE);
-
-        memcpy(spectrogram[f], magnitude, sizeof(float) * num_bins);
+        spectrogram_frame(samples + f * HOP_SIZE, fft_buffer, spectrogram[f]);
     }
 
     *out_spectrogram = spectrogram;
@@ -84,14 +76,10 @@ int build_spectrogram_from_samples(
     *out_num_bins = num_bins;
 
     free(fft_buffer);
-    free(magnitude);
-    free(frame_buffer);
     return 0;
 
 cleanup:
     free(fft_buffer);
-    free(magnitude);
-    free(frame_buffer);
     free(spectrogram_data);
     free(spectrogram);
     return -1;
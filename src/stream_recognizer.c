@@ -0,0 +1,249 @@
+// File: src/stream_recognizer.c
+// Incremental STFT, peak picking, hashing and decaying votes over a live feed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "spectrogram.h"
+#include "peak_detection.h"
+#include "hashing.h"
+#include "vote_scoring.h"
+#include "stream_recognizer.h"
+
+#define NUM_BINS      (FRAME_SIZE / 2)
+#define WINDOW_FRAMES (2 * NEIGHBORHOOD_SIZE + 1)   // Frames a peak decision needs
+
+// One (song_id, delta) cell; its score is exact as of `frame` and decays from there
+typedef struct {
+    uint64_t key;               // vote_pack() key; 0 marks an empty slot
+    float score;
+    int frame;
+} StreamCell;
+
+struct StreamRecognizer {
+    FingerprintIndex index;
+    stream_event_cb on_event;
+    void* user;
+    float half_life_frames;
+
+    float samples[FRAME_SIZE];  // Next frame being filled
+    int filled;
+    Complex work[FRAME_SIZE];
+    float frames[WINDOW_FRAMES][NUM_BINS];  // Ring of the latest magnitude frames
+    float* window[WINDOW_FRAMES];
+    int num_frames;             // Frames computed so far
+
+    Peak frame_peaks[NUM_BINS];
+    Peak recent[FAN_VALUE];     // Ring of the latest peaks, anchors for new ones
+    int num_peaks;              // Peaks seen so far
+
+    Posting* scratch;           // MATCH_MAX_LIST_LEN entries for copying backends
+    StreamCell cells[STREAM_VOTE_SLOTS];
+
+    StreamCell leader;          // Strongest cell (copy)
+    StreamCell current;         // Reported cell, key 0 if none
+};
+
+StreamRecognizer* stream_recognizer_create(FingerprintIndex index, stream_event_cb on_event, void* user) {
+    StreamRecognizer* rec = (StreamRecognizer*)calloc(1, sizeof(StreamRecognizer));
+    if (!rec) {
+        fprintf(stderr, "Memory allocation failed for stream recognizer.\n");
+        return NULL;
+    }
+
+    rec->scratch = (Posting*)malloc(MATCH_MAX_LIST_LEN * sizeof(Posting));
+    if (!rec->scratch) {
+        fprintf(stderr, "Memory allocation failed for stream recognizer.\n");
+        free(rec);
+        return NULL;
+    }
+    rec->index = index;
+    rec->on_event = on_event;
+    rec->user = user;
+    rec->half_life_frames = STREAM_HALF_LIFE_SEC * SAMPLE_RATE / HOP_SIZE;
+    return rec;
+}
+
+void stream_recognizer_free(StreamRecognizer* rec) {
+    if (!rec) return;
+    free(rec->scratch);
+    free(rec);
+}
+
+void stream_recognizer_reset(StreamRecognizer* rec) {
+    rec->filled = 0;
+    rec->num_frames = 0;
+    rec->num_peaks = 0;
+    memset(rec->cells, 0, sizeof(rec->cells));
+    memset(&rec->leader, 0, sizeof(rec->leader));
+    memset(&rec->current, 0, sizeof(rec->current));
+}
+
+// ===========================
+// Decaying vote table
+// ===========================
+
+static float decayed(const StreamRecognizer* rec, const StreamCell* cell, int now) {
+    if (cell->key == 0) return 0.0f;
+    return cell->score * exp2f((float)(cell->frame - now) / rec->half_life_frames);
+}
+
+static const StreamCell* find_cell(const StreamRecognizer* rec, uint64_t key) {
+    size_t home = (size_t)mix_hash64(key);
+    for (int p = 0; p < STREAM_VOTE_PROBES; p++) {
+        const StreamCell* cell = &rec->cells[(home + p) & (STREAM_VOTE_SLOTS - 1)];
+        if (cell->key == key) return cell;
+    }
+    return NULL;
+}
+
+// Add one vote; a full probe window gives up its weakest cell.
+static void vote(StreamRecognizer* rec, uint64_t key, int now) {
+    size_t home = (size_t)mix_hash64(key);
+    StreamCell* victim = NULL;
+    float victim_score = 0.0f;
+
+    StreamCell* cell = NULL;
+    for (int p = 0; p < STREAM_VOTE_PROBES; p++) {
+        StreamCell* c = &rec->cells[(home + p) & (STREAM_VOTE_SLOTS - 1)];
+        if (c->key == key) {
+            cell = c;
+            break;
+        }
+        float s = decayed(rec, c, now);
+        if (!victim || s < victim_score) {
+            victim = c;
+            victim_score = s;
+        }
+    }
+    if (!cell) {
+        cell = victim;
+        cell->key = key;
+        cell->score = 0.0f;
+        cell->frame = now;
+    }
+
+    cell->score = decayed(rec, cell, now) + 1.0f;
+    cell->frame = now;
+
+    // Cells that were not bumped decay at the same rate, so only bumped ones can overtake
+    if (cell->key == rec->leader.key || cell->score > decayed(rec, &rec->leader, now))
+        rec->leader = *cell;
+}
+
+static void fill_event(const StreamRecognizer* rec, StreamEventType type, uint64_t key, float score,
+                       StreamEvent* out) {
+    int now = rec->num_frames - 1;
+    out->type = type;
+    out->song_id = vote_song(key);
+    out->score = score;
+    out->stream_seconds = (double)now * HOP_SIZE / SAMPLE_RATE;
+    out->song_seconds = (float)(vote_delta(key) + now) * HOP_SIZE / SAMPLE_RATE;
+}
+
+static void emit(StreamRecognizer* rec, StreamEventType type, uint64_t key, float score) {
+    if (!rec->on_event) return;
+    StreamEvent event;
+    fill_event(rec, type, key, score, &event);
+    rec->on_event(&event, rec->user);
+}
+
+// Report song starts and ends after each frame's votes are in.
+static void update_match(StreamRecognizer* rec) {
+    int now = rec->num_frames - 1;
+    float lead = decayed(rec, &rec->leader, now);
+
+    if (rec->current.key != 0) {
+        const StreamCell* cell = find_cell(rec, rec->current.key);
+        float score = cell ? decayed(rec, cell, now) : 0.0f;
+        int other_song = vote_song(rec->leader.key) != vote_song(rec->current.key);
+
+        if (score < STREAM_LOST_SCORE || (other_song && lead >= STREAM_MATCH_SCORE && lead > score)) {
+            emit(rec, STREAM_EVENT_END, rec->current.key, score);
+            memset(&rec->current, 0, sizeof(rec->current));
+        } else if (!other_song && lead > score) {
+            rec->current = rec->leader;  // Same song, new alignment (seek or repeat)
+        }
+    }
+
+    if (rec->current.key == 0 && lead >= STREAM_MATCH_SCORE) {
+        rec->current = rec->leader;
+        emit(rec, STREAM_EVENT_MATCH, rec->current.key, lead);
+    }
+}
+
+// ===========================
+// Peaks and hashes
+// ===========================
+
+static void lookup_pair(StreamRecognizer* rec, const Peak* anchor, const Peak* target, int now) {
+    uint64_t hash;
+    if (!hash_peak_pair(anchor, target, &hash)) return;
+
+    const Posting* p;
+    size_t count = rec->index.lookup(rec->index.impl, hash, rec->scratch, MATCH_MAX_LIST_LEN, &p);
+    if (count > MATCH_MAX_LIST_LEN || !p) return;
+
+    for (size_t i = 0; i < count; i++)
+        vote(rec, vote_pack(p[i].song_id, p[i].time_offset - anchor->time_index), now);
+}
+
+// Pick the peaks of the frame NEIGHBORHOOD_SIZE behind the newest one.
+static void process_peaks(StreamRecognizer* rec) {
+    int newest = rec->num_frames - 1;
+    int t = newest - NEIGHBORHOOD_SIZE;
+    if (t < 0) return;
+
+    // Window in time order; frames before the stream start are simply absent
+    int first = t - NEIGHBORHOOD_SIZE > 0 ? t - NEIGHBORHOOD_SIZE : 0;
+    int span = newest - first + 1;
+    for (int i = 0; i < span; i++)
+        rec->window[i] = rec->frames[(first + i) % WINDOW_FRAMES];
+
+    int found = detect_frame_peaks(rec->window, span, NUM_BINS, t - first, t, rec->frame_peaks);
+    for (int i = 0; i < found; i++) {
+        const Peak* peak = &rec->frame_peaks[i];
+        int anchors = rec->num_peaks < FAN_VALUE ? rec->num_peaks : FAN_VALUE;
+        for (int j = 1; j <= anchors; j++)
+            lookup_pair(rec, &rec->recent[(rec->num_peaks - j) % FAN_VALUE], peak, newest);
+
+        rec->recent[rec->num_peaks % FAN_VALUE] = *peak;
+        rec->num_peaks++;
+    }
+}
+
+int stream_recognizer_push(StreamRecognizer* rec, const float* samples, int num_samples) {
+    if (!rec || (!samples && num_samples > 0) || num_samples < 0) {
+        fprintf(stderr, "Invalid input to stream_recognizer_push.\n");
+        return -1;
+    }
+
+    while (num_samples > 0) {
+        int take = FRAME_SIZE - rec->filled;
+        if (take > num_samples) take = num_samples;
+        memcpy(rec->samples + rec->filled, samples, take * sizeof(float));
+        rec->filled += take;
+        samples += take;
+        num_samples -= take;
+        if (rec->filled < FRAME_SIZE) break;
+
+        spectrogram_frame(rec->samples, rec->work, rec->frames[rec->num_frames % WINDOW_FRAMES]);
+        rec->num_frames++;
+        process_peaks(rec);
+        update_match(rec);
+
+        // Keep the overlap for the next frame
+        memmove(rec->samples, rec->samples + HOP_SIZE, (FRAME_SIZE - HOP_SIZE) * sizeof(float));
+        rec->filled = FRAME_SIZE - HOP_SIZE;
+    }
+    return 0;
+}
+
+int stream_recognizer_current(const StreamRecognizer* rec, StreamEvent* out) {
+    if (rec->current.key == 0) return 0;
+    const StreamCell* cell = find_cell(rec, rec->current.key);
+    fill_event(rec, STREAM_EVENT_MATCH, rec->current.key, cell ? decayed(rec, cell, rec->num_frames - 1) : 0.0f, out);
+    return 1;
+}
@@ -0,0 +1,172 @@
+// File: src/thread_pool.c
+// Fixed-size pthread worker pool with task groups.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "thread_pool.h"
+
+typedef struct {
+    task_fn fn;
+    void* arg;
+    TaskGroup* group;
+} Task;
+
+typedef struct {
+    ThreadPool* pool;
+    int id;
+} WorkerArg;
+
+struct ThreadPool {
+    pthread_t* threads;
+    WorkerArg* args;
+    int num_threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    Task* queue;                // Circular buffer, grown on demand
+    int capacity;
+    int head;
+    int size;
+    int stopping;
+};
+
+static void* worker_main(void* p) {
+    WorkerArg* wa = (WorkerArg*)p;
+    ThreadPool* pool = wa->pool;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->size == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->has_work, &pool->lock);
+        if (pool->size == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        Task task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->size--;
+        pthread_mutex_unlock(&pool->lock);
+
+        task.fn(task.arg, wa->id);
+
+        if (task.group) {
+            pthread_mutex_lock(&task.group->lock);
+            if (--task.group->pending == 0)
+                pthread_cond_broadcast(&task.group->done);
+            pthread_mutex_unlock(&task.group->lock);
+        }
+    }
+    return NULL;
+}
+
+ThreadPool* thread_pool_create(int num_threads) {
+    if (num_threads <= 0) {
+        fprintf(stderr, "Invalid input to thread_pool_create.\n");
+        return NULL;
+    }
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    pool->threads = (pthread_t*)calloc(num_threads, sizeof(pthread_t));
+    pool->args = (WorkerArg*)calloc(num_threads, sizeof(WorkerArg));
+    pool->capacity = 64;
+    pool->queue = (Task*)malloc(pool->capacity * sizeof(Task));
+    if (!pool->threads || !pool->args || !pool->queue) {
+        free(pool->threads);
+        free(pool->args);
+        free(pool->queue);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        pool->args[i] = (WorkerArg){ pool, i };
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+            fprintf(stderr, "Failed to start worker thread %d.\n", i);
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads != num_threads) {
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void thread_pool_destroy(ThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    free(pool->threads);
+    free(pool->args);
+    free(pool->queue);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool* pool) {
+    return pool->num_threads;
+}
+
+void task_group_init(TaskGroup* group) {
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->done, NULL);
+    group->pending = 0;
+}
+
+void task_group_destroy(TaskGroup* group) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->done);
+}
+
+int thread_pool_submit(ThreadPool* pool, TaskGroup* group, task_fn fn, void* arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->size == pool->capacity) {
+        int capacity = pool->capacity * 2;
+        Task* queue = (Task*)malloc(capacity * sizeof(Task));
+        if (!queue) {
+            pthread_mutex_unlock(&pool->lock);
+            return -1;
+        }
+        for (int i = 0; i < pool->size; i++)
+            queue[i] = pool->queue[(pool->head + i) % pool->capacity];
+        free(pool->queue);
+        pool->queue = queue;
+        pool->capacity = capacity;
+        pool->head = 0;
+    }
+
+    if (group) {
+        pthread_mutex_lock(&group->lock);
+        group->pending++;
+        pthread_mutex_unlock(&group->lock);
+    }
+
+    pool->queue[(pool->head + pool->size) % pool->capacity] = (Task){ fn, arg, group };
+    pool->size++;
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void task_group_wait(TaskGroup* group) {
+    pthread_mutex_lock(&group->lock);
+    while (group->pending > 0)
+        pthread_cond_wait(&group->done, &group->lock);
+    pthread_mutex_unlock(&group->lock);
+}
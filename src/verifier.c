@@ -0,0 +1,114 @@
+// File: src/verifier.c
+// Peak-level verification of match candidates against stored song peaks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "verifier.h"
+
+struct Verifier {
+    db_ctx* db;                 // Exactly one of db and pool is set
+    db_pool* pool;
+};
+
+// The catalog must store peaks, in the block size this build reads.
+static int check_catalog(db_ctx* db) {
+    int64_t block_frames = 0;
+    int found = db_get_meta(db, "peak_block_frames", &block_frames);
+    if (found < 0) return -1;
+    if (found == 0) {
+        fprintf(stderr, "Catalog stores no song peaks; re-ingest it to verify matches.\n");
+        return -1;
+    }
+    if (block_frames != PEAK_BLOCK_FRAMES) {
+        fprintf(stderr, "Catalog stores peaks in %lld-frame blocks, this build reads %d.\n",
+                (long long)block_frames, PEAK_BLOCK_FRAMES);
+        return -1;
+    }
+    return 0;
+}
+
+static Verifier* create(db_ctx* db, db_pool* pool) {
+    db_ctx* ctx = db ? db : db_pool_acquire(pool);
+    int ok = check_catalog(ctx) == 0;
+    if (pool) db_pool_release(pool, ctx);
+    if (!ok) return NULL;
+
+    Verifier* v = (Verifier*)calloc(1, sizeof(Verifier));
+    if (!v) return NULL;
+    v->db = db;
+    v->pool = pool;
+    return v;
+}
+
+Verifier* verifier_create(db_ctx* db) {
+    return db ? create(db, NULL) : NULL;
+}
+
+Verifier* verifier_create_pool(db_pool* pool) {
+    return pool ? create(NULL, pool) : NULL;
+}
+
+void verifier_free(Verifier* v) {
+    free(v);
+}
+
+// 1 if the query peaks line up with the song's at `offset`, 0 if not, -1 on error.
+static int check_candidate(db_ctx* db, const Peak* query, int num_query, const MatchResult* candidate) {
+    const int offset = candidate->offset;
+    const int first = query[0].time_index + offset - VERIFY_TIME_TOLERANCE;
+    const int last = query[num_query - 1].time_index + offset + VERIFY_TIME_TOLERANCE;
+
+    Peak* song;
+    int num_song;
+    int stored = db_load_song_peaks(db, candidate->song_id, first, last, &song, &num_song);
+    if (stored < 0) return -1;
+    if (stored == 0) return 1;  // Ingested without peaks: nothing to check against
+    if (num_song == 0) return 0;
+
+    // Both lists are in time order: slide a window of song peaks along the query
+    const int song_end = song[num_song - 1].time_index;
+    int confirmed = 0, considered = 0, lo = 0;
+    for (int i = 0; i < num_query; i++) {
+        int t = query[i].time_index + offset;
+        if (t < 0 || t > song_end + VERIFY_TIME_TOLERANCE) continue;  // Outside the song
+        considered++;
+
+        while (lo < num_song && song[lo].time_index < t - VERIFY_TIME_TOLERANCE) lo++;
+        for (int j = lo; j < num_song && song[j].time_index <= t + VERIFY_TIME_TOLERANCE; j++) {
+            int df = song[j].freq_bin - query[i].freq_bin;
+            if (df >= -VERIFY_FREQ_TOLERANCE && df <= VERIFY_FREQ_TOLERANCE) {
+                confirmed++;
+                break;
+            }
+        }
+    }
+
+    free(song);
+    return confirmed >= VERIFY_MIN_PEAKS && confirmed >= VERIFY_MIN_RATIO * considered;
+}
+
+int verifier_check(Verifier* v, const Peak* query, int num_query,
+                   MatchResult* candidates, int count, int* rejected) {
+    if (!v || (!query && num_query > 0) || num_query < 0 || (!candidates && count > 0) || count < 0) {
+        fprintf(stderr, "Invalid input to verifier_check.\n");
+        return -1;
+    }
+    if (rejected) *rejected = 0;
+    if (count == 0) return 0;
+    if (num_query == 0) {
+        if (rejected) *rejected = count;
+        return 0;
+    }
+
+    db_ctx* db = v->db ? v->db : db_pool_acquire(v->pool);
+    int kept = 0;
+    for (int i = 0; i < count && kept >= 0; i++) {
+        int ok = check_candidate(db, query, num_query, &candidates[i]);
+        if (ok < 0) kept = -1;
+        else if (ok) candidates[kept++] = candidates[i];
+        else if (rejected) (*rejected)++;
+    }
+    if (v->pool) db_pool_release(v->pool, db);
+    return kept;
+}
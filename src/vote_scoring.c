@@ -0,0 +1,313 @@
+// File: src/vote_scoring.c
+// Radix-sort and dense-array scoring of packed (song_id, delta) votes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "vote_scoring.h"
+
+#define RADIX_BITS          11
+#define RADIX_BUCKETS       (1u << RADIX_BITS)
+#define DENSE_MAX_CELLS     (1u << 20)  // 4 MiB of counters at most
+#define DENSE_CELLS_PER_PASS 5          // Dense wins up to ~5 cells per vote per radix pass
+
+struct VoteScorer {
+    uint64_t* keys;             // Compacted keys
+    uint64_t* tmp;              // Radix ping-pong buffer
+    size_t capacity;
+    uint32_t* cells;            // Dense counters, all zero between calls
+    size_t cells_capacity;
+    uint64_t* run_keys;         // vote_scorer_runs() output
+    uint32_t* run_counts;
+    size_t runs_capacity;
+};
+
+// Range of songs and (biased) deltas present in one vote set.
+typedef struct {
+    uint32_t min_song, max_song;
+    uint32_t min_delta, max_delta;
+    int delta_bits;
+    int total_bits;
+} VoteRange;
+
+VoteScorer* vote_scorer_create(void) {
+    return (VoteScorer*)calloc(1, sizeof(VoteScorer));
+}
+
+void vote_scorer_free(VoteScorer* s) {
+    if (!s) return;
+    free(s->keys);
+    free(s->tmp);
+    free(s->cells);
+    free(s->run_keys);
+    free(s->run_counts);
+    free(s);
+}
+
+static int bits_for(uint64_t span) {
+    int bits = 0;
+    while (bits < 64 && (span >> bits) > 0) bits++;
+    return bits;
+}
+
+// Keep the k best results sorted by descending score.
+static void offer_result(MatchResult* out, int k, int* found, int song_id, int score, int delta) {
+    if (*found == k && out[k - 1].score >= score) return;
+
+    int i = *found < k ? (*found)++ : k - 1;
+    while (i > 0 && out[i - 1].score < score) {
+        out[i] = out[i - 1];
+        i--;
+    }
+    out[i].song_id = song_id;
+    out[i].score = score;
+    out[i].offset = delta;
+    out[i].offset_seconds = (float)delta * HOP_SIZE / SAMPLE_RATE;
+}
+
+static int reserve_keys(VoteScorer* s, size_t n) {
+    if (n <= s->capacity) return 0;
+    size_t capacity = s->capacity ? s->capacity : 1 << 16;
+    while (capacity < n) capacity *= 2;
+    uint64_t* keys = realloc(s->keys, capacity * sizeof(uint64_t));
+    if (keys) s->keys = keys;
+    uint64_t* tmp = realloc(s->tmp, capacity * sizeof(uint64_t));
+    if (tmp) s->tmp = tmp;
+    if (!keys || !tmp) return -1;
+    s->capacity = capacity;
+    return 0;
+}
+
+static int score_dense(VoteScorer* s, const uint64_t* votes, size_t n, int min_song, int song_span,
+                       uint32_t min_delta, uint32_t delta_span, int min_score, MatchResult* out, int k) {
+    size_t cells = (size_t)song_span * delta_span;
+    if (cells > s->cells_capacity) {
+        free(s->cells);
+        s->cells = (uint32_t*)calloc(cells, sizeof(uint32_t));
+        s->cells_capacity = s->cells ? cells : 0;
+        if (!s->cells) return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        size_t song = (size_t)(vote_song(votes[i]) - min_song);
+        s->cells[song * delta_span + ((uint32_t)votes[i] - min_delta)]++;
+    }
+
+    // Read each song's row and clear it for the next call
+    int found = 0;
+    for (int song = 0; song < song_span; song++) {
+        uint32_t* row = s->cells + (size_t)song * delta_span;
+        uint32_t best = 0, best_d = 0;
+        for (uint32_t d = 0; d < delta_span; d++) {
+            if (row[d] > best) {
+                best = row[d];
+                best_d = d;
+            }
+            row[d] = 0;
+        }
+        if (best >= (uint32_t)min_score)
+            offer_result(out, k, &found, min_song + song, (int)best,
+                         (int)((best_d + min_delta) ^ 0x80000000u));
+    }
+    return found;
+}
+
+static void measure_range(const uint64_t* votes, size_t n, VoteRange* r) {
+    r->min_song = UINT32_MAX;
+    r->max_song = 0;
+    r->min_delta = UINT32_MAX;
+    r->max_delta = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t song = (uint32_t)(votes[i] >> 32);
+        uint32_t delta = (uint32_t)votes[i];
+        if (song < r->min_song) r->min_song = song;
+        if (song > r->max_song) r->max_song = song;
+        if (delta < r->min_delta) r->min_delta = delta;
+        if (delta > r->max_delta) r->max_delta = delta;
+    }
+    r->delta_bits = bits_for((uint64_t)r->max_delta - r->min_delta);
+    r->total_bits = r->delta_bits + bits_for((uint64_t)r->max_song - r->min_song);
+}
+
+// Compact and radix-sort the votes; returns the sorted buffer (one of s->keys / s->tmp).
+static uint64_t* radix_sort_compact(VoteScorer* s, const uint64_t* votes, size_t n, const VoteRange* r) {
+    if (reserve_keys(s, n) != 0) return NULL;
+
+    uint64_t* src = s->keys;
+    uint64_t* dst = s->tmp;
+    for (size_t i = 0; i < n; i++)
+        src[i] = ((uint64_t)((uint32_t)(votes[i] >> 32) - r->min_song) << r->delta_bits) |
+                 ((uint32_t)votes[i] - r->min_delta);
+
+    // LSD passes over only the bits this query uses
+    size_t counts[RADIX_BUCKETS];
+    for (int shift = 0; shift < r->total_bits; shift += RADIX_BITS) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++)
+            counts[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+
+        size_t sum = 0;
+        for (unsigned b = 0; b < RADIX_BUCKETS; b++) {
+            size_t c = counts[b];
+            counts[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++)
+            dst[counts[(src[i] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+
+        uint64_t* t = src;
+        src = dst;
+        dst = t;
+    }
+    return src;
+}
+
+static int score_radix(VoteScorer* s, const uint64_t* votes, size_t n, const VoteRange* r,
+                       int min_score, MatchResult* out, int k) {
+    uint64_t* src = radix_sort_compact(s, votes, n, r);
+    if (!src) return -1;
+
+    int min_song = (int)r->min_song;
+    uint32_t min_delta = r->min_delta;
+    int delta_bits = r->delta_bits;
+    int found = 0;
+    size_t i = 0;
+    while (i < n) {
+        uint64_t song = src[i] >> delta_bits;
+        int best = 0;
+        uint64_t best_key = src[i];
+
+        while (i < n && (src[i] >> delta_bits) == song) {
+            size_t run = i + 1;
+            while (run < n && src[run] == src[i]) run++;
+            if ((int)(run - i) > best) {
+                best = (int)(run - i);
+                best_key = src[i];
+            }
+            i = run;
+        }
+
+        if (best >= min_score) {
+            uint32_t d = (uint32_t)(best_key & ((1ULL << delta_bits) - 1)) + min_delta;
+            offer_result(out, k, &found, min_song + (int)song, best, (int)(d ^ 0x80000000u));
+        }
+    }
+    return found;
+}
+
+int vote_scorer_score(VoteScorer* s, const uint64_t* votes, size_t n, VoteScoreMethod method,
+                      int min_score, MatchResult* out, int k) {
+    if (n == 0 || k <= 0) return 0;
+
+    // Actual song and (biased) delta ranges of this query
+    VoteRange r;
+    measure_range(votes, n, &r);
+
+    uint64_t song_span = (uint64_t)r.max_song - r.min_song + 1;
+    uint64_t delta_span = (uint64_t)r.max_delta - r.min_delta + 1;
+    uint64_t cells = song_span * delta_span;
+
+    // Dense touches every cell once plus one random increment per vote; radix
+    // streams the votes twice per 11-bit digit. Measured crossovers sit near
+    // 10 cells/vote for two passes and 15 for three, so scale by the passes.
+    uint64_t passes = (uint64_t)(r.total_bits + RADIX_BITS - 1) / RADIX_BITS;
+    int dense_fits = cells <= DENSE_MAX_CELLS;
+    int dense = method == VOTE_SCORE_DENSE ? dense_fits
+              : method == VOTE_SCORE_AUTO ? dense_fits && cells <= (uint64_t)n * passes * DENSE_CELLS_PER_PASS
+              : 0;
+    if (dense)
+        return score_dense(s, votes, n, (int)r.min_song, (int)song_span, r.min_delta, (uint32_t)delta_span,
+                           min_score, out, k);
+
+    return score_radix(s, votes, n, &r, min_score, out, k);
+}
+
+int vote_scorer_runs(VoteScorer* s, const uint64_t* votes, size_t n, VoteRuns* out) {
+    memset(out, 0, sizeof(*out));
+    if (n == 0) return 0;
+
+    VoteRange r;
+    measure_range(votes, n, &r);
+    uint64_t* sorted = radix_sort_compact(s, votes, n, &r);
+    if (!sorted) return -1;
+
+    if (n > s->runs_capacity) {
+        uint64_t* rk = realloc(s->run_keys, n * sizeof(uint64_t));
+        if (rk) s->run_keys = rk;
+        uint32_t* rc = realloc(s->run_counts, n * sizeof(uint32_t));
+        if (rc) s->run_counts = rc;
+        if (!rk || !rc) return -1;
+        s->runs_capacity = n;
+    }
+
+    // Expand compact keys back to vote_pack() keys so runs from different scorers merge
+    uint64_t delta_mask = (1ULL << r.delta_bits) - 1;
+    size_t runs = 0;
+    for (size_t i = 0; i < n;) {
+        size_t end = i + 1;
+        while (end < n && sorted[end] == sorted[i]) end++;
+        uint32_t song = r.min_song + (uint32_t)(sorted[i] >> r.delta_bits);
+        uint32_t delta = r.min_delta + (uint32_t)(sorted[i] & delta_mask);
+        s->run_keys[runs] = ((uint64_t)song << 32) | delta;
+        s->run_counts[runs] = (uint32_t)(end - i);
+        runs++;
+        i = end;
+    }
+
+    out->keys = s->run_keys;
+    out->counts = s->run_counts;
+    out->count = runs;
+    return 0;
+}
+
+int vote_runs_merge(VoteRuns* runs, int num_runs, int min_score, MatchResult* out, int k) {
+    if (k <= 0) return 0;
+    for (int r = 0; r < num_runs; r++) runs[r].next = 0;
+
+    int found = 0;
+    for (;;) {
+        // Lowest song not yet merged in any input
+        uint64_t song = UINT64_MAX;
+        for (int r = 0; r < num_runs; r++)
+            if (runs[r].next < runs[r].count && (runs[r].keys[runs[r].next] >> 32) < song)
+                song = runs[r].keys[runs[r].next] >> 32;
+        if (song == UINT64_MAX) break;
+
+        // A song with fewer votes in total than min_score cannot have a qualifying cell
+        uint64_t total = 0;
+        for (int r = 0; r < num_runs; r++) {
+            size_t end = runs[r].next;
+            while (end < runs[r].count && (runs[r].keys[end] >> 32) == song)
+                total += runs[r].counts[end++];
+            runs[r].song_end = end;
+        }
+
+        if (total >= (uint64_t)min_score) {
+            uint64_t best_key = 0;
+            uint64_t best = 0;
+            for (;;) {
+                uint64_t key = UINT64_MAX;
+                for (int r = 0; r < num_runs; r++)
+                    if (runs[r].next < runs[r].song_end && runs[r].keys[runs[r].next] < key)
+                        key = runs[r].keys[runs[r].next];
+                if (key == UINT64_MAX) break;
+
+                uint64_t votes = 0;
+                for (int r = 0; r < num_runs; r++)
+                    if (runs[r].next < runs[r].song_end && runs[r].keys[runs[r].next] == key)
+                        votes += runs[r].counts[runs[r].next++];
+                if (votes > best) {
+                    best = votes;
+                    best_key = key;
+                }
+            }
+            if (best >= (uint64_t)min_score)
+                offer_result(out, k, &found, vote_song(best_key), (int)best, vote_delta(best_key));
+        }
+
+        for (int r = 0; r < num_runs; r++) runs[r].next = runs[r].song_end;
+    }
+    return found;
+}
@@ -0,0 +1,249 @@
+// File: tests/test_fingerprint_blob.c
+// Round-trip and malformed-input checks for the fingerprint blob wire format.
+// Link with the library sources (src/ without the *_entry.c and bench_*.c mains);
+// exits non-zero if any check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "config.h"
+#include "fingerprint_blob.h"
+
+#define HASH_LOW_BITS 28        // Always zero in layout 2 (see fingerprint_blob.c)
+#define NUM_HASHES    2000
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(int ok, const char* what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL: %s\n", what);
+    }
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Header of a blob claiming `count` hashes; returns its size.
+static size_t put_header(uint8_t* out, uint64_t count) {
+    uint32_t magic = FINGERPRINT_BLOB_MAGIC;
+    for (int b = 0; b < 4; b++) out[b] = (uint8_t)(magic >> (8 * b));
+    out[4] = HASH_LAYOUT_VERSION;
+    size_t n = 5;
+    n += put_varint(out + n, SAMPLE_RATE);
+    n += put_varint(out + n, HOP_SIZE);
+    n += put_varint(out + n, count);
+    return n;
+}
+
+static int compare_hash_time(const void* a, const void* b) {
+    const FingerprintHash64* x = (const FingerprintHash64*)a;
+    const FingerprintHash64* y = (const FingerprintHash64*)b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return 0;
+}
+
+// Query-like hashes: low bits clear, some hashes repeated at several frames.
+static void make_hashes(FingerprintHash64* h, int n) {
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && rng_next() % 4 == 0) h[i].hash = h[i - 1].hash;
+        else h[i].hash = rng_next() & ~((1ULL << HASH_LOW_BITS) - 1);
+        h[i].time_offset = (int)(rng_next() % 5000);
+        h[i].anchor_time = 0;
+        h[i].song_id = 0;
+    }
+}
+
+static int same_hashes(const FingerprintHash64* a, const FingerprintHash64* b, int n) {
+    for (int i = 0; i < n; i++) {
+        if (a[i].hash != b[i].hash || a[i].time_offset != b[i].time_offset) return 0;
+    }
+    return 1;
+}
+
+static int decode_fails(const uint8_t* blob, size_t bytes) {
+    FingerprintHash64* out;
+    int count;
+    int rc = fingerprint_blob_decode(blob, bytes, &out, &count);
+    free(out);
+    return rc == -1 && count == 0;
+}
+
+static void test_round_trip(void) {
+    FingerprintHash64* in = (FingerprintHash64*)malloc(NUM_HASHES * sizeof(FingerprintHash64));
+    make_hashes(in, NUM_HASHES);
+
+    // Unsorted input comes back in (hash, time) order
+    FingerprintHash64* sorted = (FingerprintHash64*)malloc(NUM_HASHES * sizeof(FingerprintHash64));
+    memcpy(sorted, in, NUM_HASHES * sizeof(FingerprintHash64));
+    qsort(sorted, NUM_HASHES, sizeof(FingerprintHash64), compare_hash_time);
+
+    uint8_t* blob;
+    size_t bytes;
+    expect(fingerprint_blob_encode(in, NUM_HASHES, &blob, &bytes) == 0, "encode");
+    expect(bytes <= fingerprint_blob_max_size(NUM_HASHES), "encoded size within max_size");
+
+    FingerprintHash64* out;
+    int count;
+    expect(fingerprint_blob_decode(blob, bytes, &out, &count) == 0, "decode");
+    expect(count == NUM_HASHES && same_hashes(out, sorted, NUM_HASHES), "decode(encode(x)) == sort(x)");
+    free(out);
+
+    // Sorted input encodes to the same bytes
+    uint8_t* again;
+    size_t again_bytes;
+    expect(fingerprint_blob_encode(sorted, NUM_HASHES, &again, &again_bytes) == 0 &&
+           again_bytes == bytes && memcmp(again, blob, bytes) == 0, "encoding ignores input order");
+    free(again);
+
+    free(blob);
+    free(sorted);
+    free(in);
+}
+
+static void test_empty(void) {
+    uint8_t* blob;
+    size_t bytes;
+    expect(fingerprint_blob_encode(NULL, 0, &blob, &bytes) == 0, "encode empty");
+
+    FingerprintHash64* out = (FingerprintHash64*)1;
+    int count = -1;
+    expect(fingerprint_blob_decode(blob, bytes, &out, &count) == 0 && count == 0 && !out,
+           "decode empty");
+    free(blob);
+}
+
+static void test_truncated(void) {
+    FingerprintHash64 in[64];
+    make_hashes(in, 64);
+    uint8_t* blob;
+    size_t bytes;
+    if (fingerprint_blob_encode(in, 64, &blob, &bytes) != 0) {
+        expect(0, "encode for truncation");
+        return;
+    }
+
+    int all_rejected = 1;
+    for (size_t len = 0; len < bytes; len++)
+        all_rejected &= decode_fails(blob, len);
+    expect(all_rejected, "every truncated prefix is rejected");
+    free(blob);
+}
+
+static void test_trailing_bytes(void) {
+    FingerprintHash64 in[64];
+    make_hashes(in, 64);
+    uint8_t* blob;
+    size_t bytes;
+    if (fingerprint_blob_encode(in, 64, &blob, &bytes) != 0) {
+        expect(0, "encode for trailing bytes");
+        return;
+    }
+
+    uint8_t* padded = (uint8_t*)malloc(bytes + 2);
+    memcpy(padded, blob, bytes);
+    padded[bytes] = 0;
+    padded[bytes + 1] = 0;
+    expect(decode_fails(padded, bytes + 1), "one trailing byte is rejected");
+    expect(decode_fails(padded, bytes + 2), "two trailing bytes are rejected");
+    free(padded);
+
+    // An empty blob with a stray byte after the header
+    uint8_t empty[32];
+    size_t n = put_header(empty, 0);
+    empty[n] = 0;
+    expect(decode_fails(empty, n + 1), "trailing byte after an empty header is rejected");
+    free(blob);
+}
+
+static void test_oversized_count(void) {
+    uint8_t blob[64];
+    size_t n = put_header(blob, 1ULL << 40);
+    blob[n++] = 1;
+    blob[n++] = 0;
+    expect(decode_fails(blob, n), "count far beyond the payload is rejected");
+
+    n = put_header(blob, UINT64_MAX);
+    expect(decode_fails(blob, n), "count of UINT64_MAX is rejected");
+
+    // One entry more than the payload holds
+    n = put_header(blob, 3);
+    for (int i = 0; i < 2; i++) {
+        blob[n++] = 1;
+        blob[n++] = 7;
+    }
+    blob[n++] = 0;
+    blob[n++] = 0;
+    expect(!decode_fails(blob, n), "control: three entries decode");
+    n = put_header(blob, 4);
+    for (int i = 0; i < 3; i++) {
+        blob[n++] = 1;
+        blob[n++] = 7;
+    }
+    expect(decode_fails(blob, n), "count one past the entries is rejected");
+}
+
+static void test_incompatible_header(void) {
+    uint8_t blob[32];
+    size_t n = put_header(blob, 0);
+
+    blob[0] ^= 0xFF;
+    expect(decode_fails(blob, n), "wrong magic is rejected");
+    blob[0] ^= 0xFF;
+
+    blob[4] = HASH_LAYOUT_VERSION + 1;
+    expect(decode_fails(blob, n), "other hash layout is rejected");
+    blob[4] = HASH_LAYOUT_VERSION;
+
+    n = 5;
+    n += put_varint(blob + n, SAMPLE_RATE / 2);
+    n += put_varint(blob + n, HOP_SIZE);
+    n += put_varint(blob + n, 0);
+    expect(decode_fails(blob, n), "other sample rate is rejected");
+}
+
+static void test_encode_rejects(void) {
+    FingerprintHash64 h;
+    memset(&h, 0, sizeof(h));
+    h.hash = 1ULL << HASH_LOW_BITS | 1;
+    uint8_t* blob;
+    size_t bytes;
+    expect(fingerprint_blob_encode(&h, 1, &blob, &bytes) == -1, "low hash bits set are rejected");
+
+    h.hash = 1ULL << HASH_LOW_BITS;
+    h.time_offset = -1;
+    expect(fingerprint_blob_encode(&h, 1, &blob, &bytes) == -1, "negative time is rejected");
+}
+
+int main(void) {
+    test_round_trip();
+    test_empty();
+    test_truncated();
+    test_trailing_bytes();
+    test_oversized_count();
+    test_incompatible_header();
+    test_encode_rejects();
+
+    printf("fingerprint_blob: %d checks, %d failed\n", checks, failures);
+    return failures ? 1 : 0;
+}